@@ -0,0 +1,303 @@
+/*
+ * gmxconverter.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gmxconverter.h"
+
+#include "map.h"
+#include "mapformat.h"
+#include "mapreader.h"
+#include "mapwriter.h"
+#include "object.h"
+#include "objecttypes.h"
+#include "pluginmanager.h"
+#include "qtcompat_p.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QProcess>
+#include <QQueue>
+#include <QSettings>
+#include <QTemporaryFile>
+#include <QThread>
+
+#include <functional>
+#include <memory>
+
+using namespace Tiled;
+
+static QString sizeToString(QSize size)
+{
+    return QStringLiteral("%1x%2").arg(size.width()).arg(size.height());
+}
+
+GmxConverter::GmxConverter()
+    : mDirection(Auto)
+    , mTileSize(16, 16)
+    , mQuadSize(256, 224)
+    , mCombineTiles(false)
+    , mJobs(QThread::idealThreadCount())
+    , mRoomFormat(nullptr)
+{
+}
+
+/**
+ * Loads the plugins and the object types. Only done when something is
+ * converted in this process, the worker pool doesn't need them.
+ */
+bool GmxConverter::prepare()
+{
+    if (mRoomFormat)
+        return true;
+
+    PluginManager::instance()->loadPlugins();
+
+    const auto formats = PluginManager::objects<MapFormat>();
+    for (MapFormat *format : formats) {
+        if (format->shortName() == QLatin1String("roomgmx")) {
+            mRoomFormat = format;
+            break;
+        }
+    }
+
+    if (!mRoomFormat) {
+        qWarning("The GMX plugin could not be loaded");
+        return false;
+    }
+
+    if (!mObjectTypesFile.isEmpty()) {
+        ObjectTypes objectTypes;
+        ObjectTypesSerializer serializer;
+        if (!serializer.readObjectTypes(mObjectTypesFile, objectTypes)) {
+            qWarning("Error while reading \"%s\":\n%s",
+                     qUtf8Printable(mObjectTypesFile),
+                     qUtf8Printable(serializer.errorString()));
+            return false;
+        }
+        Object::setObjectTypes(objectTypes);
+    }
+
+    return true;
+}
+
+GmxConverter::Direction GmxConverter::directionFor(const QString &fileName) const
+{
+    if (mDirection != Auto)
+        return mDirection;
+    if (fileName.endsWith(QLatin1String(".room.gmx"), Qt::CaseInsensitive))
+        return RoomToTmx;
+    return TmxToRoom;
+}
+
+int GmxConverter::convertFile(const QString &inputFileName,
+                              const QString &outputFileName)
+{
+    if (!prepare())
+        return 1;
+
+    std::unique_ptr<Map> map;
+
+    if (directionFor(inputFileName) == RoomToTmx) {
+        // The GMX plugin reads its importer settings from these keys instead
+        // of showing the room importer dialog when GMSMEBatch/Headless is set
+        QTemporaryFile settingsFile;
+        if (!settingsFile.open()) {
+            qWarning("Could not create a temporary settings file");
+            return 1;
+        }
+        settingsFile.close();
+
+        QSettings settings(settingsFile.fileName(), QSettings::IniFormat);
+        settings.setValue(QLatin1String("GMSMEBatch/Headless"), true);
+        settings.setValue(QLatin1String("GMSMEBatch/ImagesPath"), mImagesPath);
+        settings.setValue(QLatin1String("GMSMEBatch/TemplatesPath"), mTemplatesPath);
+        settings.setValue(QLatin1String("GMSMESizes/lastUsedMapTilesize"), mTileSize);
+        settings.setValue(QLatin1String("GMSMESizes/LastUsedQuadSize"), mQuadSize);
+        settings.setValue(QLatin1String("Interface/DefaultCombineTiles"), mCombineTiles);
+
+        map.reset(mRoomFormat->read(inputFileName, &settings));
+        if (!map) {
+            qWarning("Error while reading \"%s\":\n%s",
+                     qUtf8Printable(inputFileName),
+                     qUtf8Printable(mRoomFormat->errorString()));
+            return 1;
+        }
+
+        // Non-fatal problems, like skipped tiles, are reported the same way
+        if (!mRoomFormat->errorString().isEmpty()) {
+            qWarning("\"%s\": %s",
+                     qUtf8Printable(inputFileName),
+                     qUtf8Printable(mRoomFormat->errorString()));
+        }
+
+        MapWriter writer;
+        if (!writer.writeMap(map.get(), outputFileName)) {
+            qWarning("Error while writing \"%s\":\n%s",
+                     qUtf8Printable(outputFileName),
+                     qUtf8Printable(writer.errorString()));
+            return 1;
+        }
+    } else {
+        MapReader reader;
+        map.reset(reader.readMap(inputFileName));
+        if (!map) {
+            qWarning("Error while reading \"%s\":\n%s",
+                     qUtf8Printable(inputFileName),
+                     qUtf8Printable(reader.errorString()));
+            return 1;
+        }
+
+        if (!mRoomFormat->write(map.get(), outputFileName)) {
+            qWarning("Error while writing \"%s\":\n%s",
+                     qUtf8Printable(outputFileName),
+                     qUtf8Printable(mRoomFormat->errorString()));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the options that are passed on to each worker process.
+ */
+QStringList GmxConverter::workerArguments() const
+{
+    QStringList arguments;
+    arguments << QLatin1String("--tilesize") << sizeToString(mTileSize)
+              << QLatin1String("--quadsize") << sizeToString(mQuadSize);
+
+    if (!mImagesPath.isEmpty())
+        arguments << QLatin1String("--images") << mImagesPath;
+    if (!mTemplatesPath.isEmpty())
+        arguments << QLatin1String("--templates") << mTemplatesPath;
+    if (!mObjectTypesFile.isEmpty())
+        arguments << QLatin1String("--types") << mObjectTypesFile;
+    if (mCombineTiles)
+        arguments << QLatin1String("--combine-tiles");
+
+    return arguments;
+}
+
+int GmxConverter::convertDirectory(const QString &inputDirPath,
+                                   const QString &outputDirPath)
+{
+    const bool toTmx = mDirection != TmxToRoom;
+
+    QDir inputDir(inputDirPath);
+    const QStringList nameFilters(toTmx ? QStringLiteral("*.room.gmx")
+                                        : QStringLiteral("*.tmx"));
+    const QFileInfoList inputFiles = inputDir.entryInfoList(nameFilters,
+                                                            QDir::Files,
+                                                            QDir::Name);
+
+    QDir outputDir(outputDirPath);
+    if (!outputDir.exists() && !QDir().mkpath(outputDirPath)) {
+        qWarning("Could not create output directory \"%s\"",
+                 qUtf8Printable(outputDirPath));
+        return 1;
+    }
+
+    struct Job {
+        QString input;
+        QString output;
+    };
+
+    const QString roomSuffix = QStringLiteral(".room.gmx");
+
+    QQueue<Job> pending;
+    for (const QFileInfo &info : inputFiles) {
+        // Room names may contain dots, so only the suffix is removed
+        const QString outputName = toTmx
+                ? info.fileName().left(info.fileName().size() - roomSuffix.size()) + QLatin1String(".tmx")
+                : info.completeBaseName() + roomSuffix;
+        pending.enqueue({ info.absoluteFilePath(), outputDir.absoluteFilePath(outputName) });
+    }
+
+    const int total = pending.size();
+    if (total == 0) {
+        qWarning("No files to convert in \"%s\"", qUtf8Printable(inputDirPath));
+        return 0;
+    }
+
+    const QString program = QCoreApplication::applicationFilePath();
+    const QStringList baseArguments = workerArguments();
+    const int jobs = qBound(1, mJobs, total);
+
+    QEventLoop loop;
+    int running = 0;
+    int done = 0;
+    QStringList failed;
+
+    std::function<void()> startNext = [&]() {
+        while (running < jobs && !pending.isEmpty()) {
+            const Job job = pending.dequeue();
+
+            auto process = new QProcess;
+            process->setProcessChannelMode(QProcess::ForwardedChannels);
+
+            auto finish = [&, process, job](bool succeeded) {
+                if (!succeeded)
+                    failed.append(job.input);
+
+                ++done;
+                --running;
+                qInfo("[%d/%d] %s", done, total, qUtf8Printable(QFileInfo(job.input).fileName()));
+
+                process->deleteLater();
+                startNext();
+
+                if (running == 0)
+                    loop.quit();
+            };
+
+            QObject::connect(process, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+                             [finish](int exitCode, QProcess::ExitStatus exitStatus) {
+                finish(exitStatus == QProcess::NormalExit && exitCode == 0);
+            });
+            QObject::connect(process, &QProcess::errorOccurred,
+                             [finish](QProcess::ProcessError error) {
+                // No finished() signal follows when the worker can't start
+                if (error == QProcess::FailedToStart)
+                    finish(false);
+            });
+
+            ++running;
+            process->start(program, QStringList(baseArguments) << job.input << job.output);
+        }
+    };
+
+    startNext();
+
+    // Workers that fail to start may report it right away, in which case
+    // all of them could be done already
+    if (running > 0)
+        loop.exec();
+
+    if (!failed.isEmpty()) {
+        qWarning("%d of %d files failed to convert:", failed.size(), total);
+        for (const QString &fileName : qAsConst(failed))
+            qWarning("  %s", qUtf8Printable(fileName));
+        return 1;
+    }
+
+    return 0;
+}
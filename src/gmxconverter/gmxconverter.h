@@ -0,0 +1,77 @@
+/*
+ * gmxconverter.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+namespace Tiled {
+class MapFormat;
+}
+
+/**
+ * Converts GameMaker Studio 1.4 rooms (.room.gmx) to TMX maps and back
+ * without any user interaction.
+ *
+ * Single files are converted in-process. Directories are converted by a pool
+ * of worker processes, each one running this tool on a single room. Worker
+ * processes are used instead of threads because tilesets are loaded into
+ * QPixmaps, which may only be used from the GUI thread.
+ */
+class GmxConverter
+{
+public:
+    enum Direction {
+        Auto,
+        RoomToTmx,
+        TmxToRoom
+    };
+
+    GmxConverter();
+
+    void setDirection(Direction direction) { mDirection = direction; }
+    void setTileSize(QSize tileSize) { mTileSize = tileSize; }
+    void setQuadSize(QSize quadSize) { mQuadSize = quadSize; }
+    void setImagesPath(const QString &path) { mImagesPath = path; }
+    void setTemplatesPath(const QString &path) { mTemplatesPath = path; }
+    void setObjectTypesFile(const QString &fileName) { mObjectTypesFile = fileName; }
+    void setCombineTiles(bool combineTiles) { mCombineTiles = combineTiles; }
+    void setJobs(int jobs) { mJobs = jobs; }
+
+    int convertFile(const QString &inputFileName, const QString &outputFileName);
+    int convertDirectory(const QString &inputDirPath, const QString &outputDirPath);
+
+private:
+    bool prepare();
+    Direction directionFor(const QString &fileName) const;
+    QStringList workerArguments() const;
+
+    Direction mDirection;
+    QSize mTileSize;
+    QSize mQuadSize;
+    QString mImagesPath;
+    QString mTemplatesPath;
+    QString mObjectTypesFile;
+    bool mCombineTiles;
+    int mJobs;
+
+    Tiled::MapFormat *mRoomFormat;
+};
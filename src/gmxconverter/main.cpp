@@ -0,0 +1,164 @@
+/*
+ * main.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gmxconverter.h"
+
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QStringList>
+
+/**
+ * Parses either "N" or "WxH".
+ */
+static QSize parseSize(const QString &value, bool *ok)
+{
+    const QStringList parts = value.split(QLatin1Char('x'));
+    *ok = false;
+
+    if (parts.size() == 1) {
+        const int size = parts.at(0).toInt(ok);
+        return QSize(size, size);
+    }
+
+    if (parts.size() == 2) {
+        bool okHeight;
+        const int width = parts.at(0).toInt(ok);
+        const int height = parts.at(1).toInt(&okHeight);
+        *ok = *ok && okHeight;
+        return QSize(width, height);
+    }
+
+    return QSize();
+}
+
+int main(int argc, char *argv[])
+{
+    // Tilesets still need a QGuiApplication, but no display
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QGuiApplication app(argc, argv);
+
+    app.setOrganizationDomain(QLatin1String("mapeditor.org"));
+    app.setApplicationName(QLatin1String("GmxConverter"));
+    app.setApplicationVersion(QLatin1String("1.0"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QCoreApplication::translate("main", "Converts GameMaker Studio 1.4 rooms (.room.gmx) to TMX maps and back. When the input is a directory, all rooms in it are converted in parallel."));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+                          { { "t", "tilesize" },
+                            QCoreApplication::translate("main", "The tile size used when importing rooms, as N or WxH (default: 16)."),
+                            QCoreApplication::translate("main", "size") },
+                          { { "q", "quadsize" },
+                            QCoreApplication::translate("main", "The quad size stored in imported maps, as N or WxH (default: 256x224)."),
+                            QCoreApplication::translate("main", "size") },
+                          { "images",
+                            QCoreApplication::translate("main", "The directory containing the background images used by the rooms."),
+                            QCoreApplication::translate("main", "dir") },
+                          { "templates",
+                            QCoreApplication::translate("main", "The directory containing the generated object templates."),
+                            QCoreApplication::translate("main", "dir") },
+                          { "types",
+                            QCoreApplication::translate("main", "The object types file generated with the templates, needed for exporting instances correctly."),
+                            QCoreApplication::translate("main", "file") },
+                          { "combine-tiles",
+                            QCoreApplication::translate("main", "Enable the combineTilesOnExport property on imported maps.") },
+                          { "to-tmx",
+                            QCoreApplication::translate("main", "Convert rooms to TMX maps (default for directories and .room.gmx files).") },
+                          { "to-gmx",
+                            QCoreApplication::translate("main", "Convert TMX maps to rooms (default for other files).") },
+                          { { "j", "jobs" },
+                            QCoreApplication::translate("main", "The number of rooms converted at the same time (default: number of cores)."),
+                            QCoreApplication::translate("main", "count") },
+                      });
+    parser.addPositionalArgument("input", QCoreApplication::translate("main", "Room or map file, or a directory containing them."));
+    parser.addPositionalArgument("output", QCoreApplication::translate("main", "Output file, or output directory when converting a directory."));
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 2)
+        parser.showHelp(1);
+
+    const QString &input = args.at(0);
+    const QString &output = args.at(1);
+
+    if (input.isEmpty() || output.isEmpty())
+        parser.showHelp(1);
+
+    if (parser.isSet(QLatin1String("to-tmx")) && parser.isSet(QLatin1String("to-gmx"))) {
+        qWarning().noquote() << QCoreApplication::translate("main", "Only one of --to-tmx and --to-gmx can be used");
+        exit(1);
+    }
+
+    GmxConverter converter;
+
+    if (parser.isSet(QLatin1String("to-tmx")))
+        converter.setDirection(GmxConverter::RoomToTmx);
+    else if (parser.isSet(QLatin1String("to-gmx")))
+        converter.setDirection(GmxConverter::TmxToRoom);
+
+    if (parser.isSet(QLatin1String("tilesize"))) {
+        bool ok;
+        const QSize size = parseSize(parser.value(QLatin1String("tilesize")), &ok);
+        if (!ok || size.width() <= 0 || size.height() <= 0) {
+            qWarning().noquote() << QCoreApplication::translate("main", "Invalid tile size specified: \"%1\"").arg(parser.value(QLatin1String("tilesize")));
+            exit(1);
+        }
+        converter.setTileSize(size);
+    }
+
+    if (parser.isSet(QLatin1String("quadsize"))) {
+        bool ok;
+        const QSize size = parseSize(parser.value(QLatin1String("quadsize")), &ok);
+        if (!ok || size.width() <= 0 || size.height() <= 0) {
+            qWarning().noquote() << QCoreApplication::translate("main", "Invalid quad size specified: \"%1\"").arg(parser.value(QLatin1String("quadsize")));
+            exit(1);
+        }
+        converter.setQuadSize(size);
+    }
+
+    if (parser.isSet(QLatin1String("jobs"))) {
+        bool ok;
+        const int jobs = parser.value(QLatin1String("jobs")).toInt(&ok);
+        if (!ok || jobs <= 0) {
+            qWarning().noquote() << QCoreApplication::translate("main", "Invalid job count specified: \"%1\"").arg(parser.value(QLatin1String("jobs")));
+            exit(1);
+        }
+        converter.setJobs(jobs);
+    }
+
+    // Paths are passed on to worker processes, so make them absolute
+    if (parser.isSet(QLatin1String("images")))
+        converter.setImagesPath(QFileInfo(parser.value(QLatin1String("images"))).absoluteFilePath());
+    if (parser.isSet(QLatin1String("templates")))
+        converter.setTemplatesPath(QFileInfo(parser.value(QLatin1String("templates"))).absoluteFilePath());
+    if (parser.isSet(QLatin1String("types")))
+        converter.setObjectTypesFile(QFileInfo(parser.value(QLatin1String("types"))).absoluteFilePath());
+
+    converter.setCombineTiles(parser.isSet(QLatin1String("combine-tiles")));
+
+    if (QFileInfo(input).isDir())
+        return converter.convertDirectory(input, output);
+
+    return converter.convertFile(input, output);
+}
@@ -34,11 +34,18 @@
 #include <zlib.h>
 #endif
 
+#ifdef TILED_ZSTD_SUPPORT
+#include <zstd.h>
+#endif
+
 #include <QByteArray>
 #include <QDebug>
+#include <QtGlobal>
 
 #include "qtcompat_p.h"
 
+#include <climits>
+
 #ifdef Z_PREFIX
 #undef compress
 #endif
@@ -65,11 +72,124 @@ static void logZlibError(int error)
     }
 }
 
-QByteArray Tiled::decompress(const QByteArray &data, int expectedSize)
+#ifdef TILED_ZSTD_SUPPORT
+static QByteArray decompressZstd(const QByteArray &data, int expectedSize)
+{
+    QByteArray out;
+
+    // Use the size stored in the frame header when available
+    const unsigned long long contentSize = ZSTD_getFrameContentSize(data.constData(),
+                                                                    data.size());
+    if (contentSize == ZSTD_CONTENTSIZE_ERROR) {
+        qDebug() << "Incorrect zstd compressed data!";
+        return QByteArray();
+    }
+    if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN && contentSize <= INT_MAX) {
+        out.resize(int(contentSize));
+        const size_t ret = ZSTD_decompress(out.data(), out.size(),
+                                           data.constData(), data.size());
+        if (ZSTD_isError(ret) || ret != contentSize) {
+            qDebug() << "Error while decompressing data:" << ZSTD_getErrorName(ret);
+            return QByteArray();
+        }
+        return out;
+    }
+
+    // Otherwise decompress as a stream
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    ZSTD_initDStream(stream);
+
+    out.resize(qMax(expectedSize, 1024));
+    ZSTD_inBuffer input = { data.constData(), size_t(data.size()), 0 };
+    ZSTD_outBuffer output = { out.data(), size_t(out.size()), 0 };
+
+    size_t ret;
+    do {
+        if (output.pos == output.size) {
+            out.resize(out.size() * 2);
+            output.dst = out.data();
+            output.size = out.size();
+        }
+
+        ret = ZSTD_decompressStream(stream, &output, &input);
+        if (ZSTD_isError(ret)) {
+            qDebug() << "Error while decompressing data:" << ZSTD_getErrorName(ret);
+            ZSTD_freeDStream(stream);
+            return QByteArray();
+        }
+    } while (ret != 0 && (input.pos < input.size || output.pos == output.size));
+
+    ZSTD_freeDStream(stream);
+
+    if (ret != 0) {
+        qDebug() << "Incorrect zstd compressed data!";
+        return QByteArray();
+    }
+
+    out.resize(int(output.pos));
+    return out;
+}
+
+static QByteArray compressZstd(const QByteArray &data, int level)
+{
+    // Level 0 selects the default level of zstd
+    if (level == -1)
+        level = 0;
+    else
+        level = qMin(level, ZSTD_maxCLevel());
+
+    QByteArray out;
+    out.resize(int(ZSTD_compressBound(data.size())));
+
+    const size_t size = ZSTD_compress(out.data(), out.size(),
+                                      data.constData(), data.size(),
+                                      level);
+    if (ZSTD_isError(size)) {
+        qDebug() << "Error while compressing data:" << ZSTD_getErrorName(size);
+        return QByteArray();
+    }
+
+    out.resize(int(size));
+    return out;
+}
+#endif
+
+bool Tiled::compressionSupported(CompressionMethod method)
+{
+#ifdef TILED_ZSTD_SUPPORT
+    Q_UNUSED(method)
+    return true;
+#else
+    return method != Zstandard;
+#endif
+}
+
+int Tiled::maximumCompressionLevel(CompressionMethod method)
+{
+#ifdef TILED_ZSTD_SUPPORT
+    if (method == Zstandard)
+        return ZSTD_maxCLevel();
+#else
+    Q_UNUSED(method)
+#endif
+    return 9;
+}
+
+QByteArray Tiled::decompress(const QByteArray &data, int expectedSize,
+                             CompressionMethod method)
 {
     if (data.isEmpty())
         return QByteArray();
 
+    if (method == Zstandard) {
+#ifdef TILED_ZSTD_SUPPORT
+        return decompressZstd(data, expectedSize);
+#else
+        qDebug() << "Zstandard compression is not supported!";
+        return QByteArray();
+#endif
+    }
+
     QByteArray out;
     out.resize(expectedSize);
     z_stream strm;
@@ -126,11 +246,26 @@ QByteArray Tiled::decompress(const QByteArray &data, int expectedSize)
     return out;
 }
 
-QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
+QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method,
+                           int level)
 {
     if (data.isEmpty())
         return QByteArray();
 
+    if (method == Zstandard) {
+#ifdef TILED_ZSTD_SUPPORT
+        return compressZstd(data, level);
+#else
+        qDebug() << "Zstandard compression is not supported!";
+        return QByteArray();
+#endif
+    }
+
+    if (level == -1)
+        level = Z_DEFAULT_COMPRESSION;
+    else
+        level = qBound(0, level, 9);
+
     QByteArray out;
     out.resize(1024);
     int err;
@@ -145,7 +280,7 @@ QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
 
     const int windowBits = (method == Gzip) ? 15 + 16 : 15;
 
-    err = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits,
+    err = deflateInit2(&strm, level, Z_DEFLATED, windowBits,
                        8, Z_DEFAULT_STRATEGY);
     if (err != Z_OK) {
         logZlibError(err);
@@ -36,12 +36,28 @@ namespace Tiled {
 
 enum CompressionMethod {
     Gzip,
-    Zlib
+    Zlib,
+    Zstandard
 };
 
 /**
- * Decompresses either zlib or gzip compressed memory. Returns a null
- * QByteArray if decompressing failed.
+ * Returns whether the given compression \a method is supported. Zstandard
+ * support is optional, depending on whether libzstd was available at build
+ * time.
+ */
+bool TILEDSHARED_EXPORT compressionSupported(CompressionMethod method);
+
+/**
+ * Returns the highest compression level of the given \a method. Higher
+ * levels passed to compress() are clamped to this level. When Zstandard is
+ * not supported, this returns the level of zlib, which is used instead.
+ */
+int TILEDSHARED_EXPORT maximumCompressionLevel(CompressionMethod method);
+
+/**
+ * Decompresses either zlib or gzip compressed memory, or Zstandard compressed
+ * memory when \a method is Zstandard. Returns a null QByteArray if
+ * decompressing failed.
  *
  * Needed because qUncompress does not support gzip compressed data. Also,
  * this method does not need the expected size to be prepended to the data,
@@ -49,21 +65,28 @@ enum CompressionMethod {
  *
  * @param data         the compressed data
  * @param expectedSize the expected size of the uncompressed data in bytes
+ * @param method       the compression method, zlib and gzip are detected
+ *                     automatically
  * @return the uncompressed data, or a null QByteArray if decompressing failed
  */
 QByteArray TILEDSHARED_EXPORT decompress(const QByteArray &data,
-                                         int expectedSize = 1024);
+                                         int expectedSize = 1024,
+                                         CompressionMethod method = Zlib);
 
 /**
- * Compresses the give data in either gzip or zlib format. Returns a null
- * QByteArray if compression failed.
+ * Compresses the give data in either gzip, zlib or Zstandard format. Returns
+ * a null QByteArray if compression failed.
  *
  * Needed because qCompress does not support gzip compression.
  *
- * @param data the uncompressed data
+ * @param data   the uncompressed data
+ * @param method the compression method
+ * @param level  the compression level, or -1 for the default level of the
+ *               compression method
  * @return the compressed data, or a null QByteArray if compression failed
  */
 QByteArray TILEDSHARED_EXPORT compress(const QByteArray &data,
-                                       CompressionMethod method = Zlib);
+                                       CompressionMethod method = Zlib,
+                                       int level = -1);
 
 } // namespace Tiled
@@ -33,6 +33,12 @@
 #include "tiled.h"
 #include "tileset.h"
 
+#include <QHash>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
 using namespace Tiled;
 
 // Bits on the far end of the 32-bit global tile ID are used for tile flags
@@ -42,6 +48,114 @@ const unsigned FlippedAntiDiagonallyFlag = 0x20000000;
 
 const unsigned RotatedHexagonal120Flag   = 0x10000000;
 
+const unsigned FlagsMask = FlippedHorizontallyFlag |
+                           FlippedVerticallyFlag |
+                           FlippedAntiDiagonallyFlag |
+                           RotatedHexagonal120Flag;
+
+static unsigned gidFlags(const Cell &cell)
+{
+    unsigned flags = 0;
+    if (cell.flippedHorizontally())
+        flags |= FlippedHorizontallyFlag;
+    if (cell.flippedVertically())
+        flags |= FlippedVerticallyFlag;
+    if (cell.flippedAntiDiagonally())
+        flags |= FlippedAntiDiagonallyFlag;
+    if (cell.rotatedHexagonal120())
+        flags |= RotatedHexagonal120Flag;
+    return flags;
+}
+
+static void setGidFlags(Cell &cell, unsigned gid)
+{
+    cell.setFlippedHorizontally(gid & FlippedHorizontallyFlag);
+    cell.setFlippedVertically(gid & FlippedVerticallyFlag);
+    cell.setFlippedAntiDiagonally(gid & FlippedAntiDiagonallyFlag);
+    cell.setRotatedHexagonal120(gid & RotatedHexagonal120Flag);
+}
+
+namespace {
+
+/**
+ * Looks up the tilesets of many gids in a row. The first gids are kept in a
+ * flat array, and since neighboring tiles tend to come from the same
+ * tileset, the range of the last match is checked before searching.
+ */
+class GidLookup
+{
+public:
+    explicit GidLookup(const QMap<unsigned, SharedTileset> &firstGidToTileset)
+        : mLast(-1)
+    {
+        mFirstGids.reserve(firstGidToTileset.size());
+        mTilesets.reserve(firstGidToTileset.size());
+        for (auto it = firstGidToTileset.begin(); it != firstGidToTileset.end(); ++it) {
+            mFirstGids.append(it.key());
+            mTilesets.append(it.value().data());
+        }
+    }
+
+    /**
+     * Sets the tile of \a cell for the given \a gid, which should not have
+     * any flags set. Returns false when there is no tileset for the gid.
+     */
+    bool setTile(Cell &cell, unsigned gid)
+    {
+        if (mLast == -1 || gid < mFirstGids.at(mLast) ||
+                (mLast + 1 < mFirstGids.size() && gid >= mFirstGids.at(mLast + 1))) {
+            const auto it = std::upper_bound(mFirstGids.cbegin(), mFirstGids.cend(), gid);
+            if (it == mFirstGids.cbegin())
+                return false;
+
+            mLast = int(it - mFirstGids.cbegin()) - 1;
+        }
+
+        cell.setTile(mTilesets.at(mLast), int(gid - mFirstGids.at(mLast)));
+        return true;
+    }
+
+private:
+    QVector<unsigned> mFirstGids;
+    QVector<Tileset*> mTilesets;
+    int mLast;
+};
+
+/**
+ * Sets the cells of \a tileLayer within \a bounds to the gids returned by
+ * \a nextGid, writing a row at a time. Returns false and sets \a invalidGid
+ * when a gid doesn't refer to any tileset.
+ */
+template<typename NextGid>
+bool setCellsFromGids(TileLayer &tileLayer, QRect bounds, GidLookup &lookup,
+                      NextGid nextGid, unsigned &invalidGid)
+{
+    QVector<Cell> row(bounds.width());
+
+    for (int y = bounds.top(); y <= bounds.bottom(); ++y) {
+        for (Cell &cell : row) {
+            const unsigned gid = nextGid();
+
+            cell = Cell();
+            setGidFlags(cell, gid);
+
+            if ((gid & ~FlagsMask) == 0)
+                continue;
+
+            if (!lookup.setTile(cell, gid & ~FlagsMask)) {
+                invalidGid = gid;
+                return false;
+            }
+        }
+
+        tileLayer.setCellRow(bounds.x(), y, row.constData(), row.size());
+    }
+
+    return true;
+}
+
+} // anonymous namespace
+
 /**
  * Default constructor. Use \l insert to initialize the gid mapper
  * incrementally.
@@ -73,17 +187,10 @@ Cell GidMapper::gidToCell(unsigned gid, bool &ok) const
     Cell result;
 
     // Read out the flags
-    result.setFlippedHorizontally(gid & FlippedHorizontallyFlag);
-    result.setFlippedVertically(gid & FlippedVerticallyFlag);
-    result.setFlippedAntiDiagonally(gid & FlippedAntiDiagonallyFlag);
-
-    result.setRotatedHexagonal120(gid & RotatedHexagonal120Flag);
+    setGidFlags(result, gid);
 
     // Clear the flags
-    gid &= ~(FlippedHorizontallyFlag |
-             FlippedVerticallyFlag |
-             FlippedAntiDiagonallyFlag |
-             RotatedHexagonal120Flag);
+    gid &= ~FlagsMask;
 
     if (gid == 0) {
         ok = true;
@@ -129,27 +236,18 @@ unsigned GidMapper::cellToGid(const Cell &cell) const
     if (i == i_end) // tileset not found
         return 0;
 
-    unsigned gid = i.key() + cell.tileId();
-    if (cell.flippedHorizontally())
-        gid |= FlippedHorizontallyFlag;
-    if (cell.flippedVertically())
-        gid |= FlippedVerticallyFlag;
-    if (cell.flippedAntiDiagonally())
-        gid |= FlippedAntiDiagonallyFlag;
-    if (cell.rotatedHexagonal120())
-        gid |= RotatedHexagonal120Flag;
-
-    return gid;
+    return (i.key() + cell.tileId()) | gidFlags(cell);
 }
 
 /**
  * Encodes the tile layer data of the given \a tileLayer in the given
  * \a format. This function should only be used for base64 encoding, with or
- * without compression.
+ * without compression. The \a compressionLevel is passed on to compress().
  */
 QByteArray GidMapper::encodeLayerData(const TileLayer &tileLayer,
                                       Map::LayerDataFormat format,
-                                      QRect bounds) const
+                                      QRect bounds,
+                                      int compressionLevel) const
 {
     Q_ASSERT(format != Map::XML);
     Q_ASSERT(format != Map::CSV);
@@ -157,23 +255,61 @@ QByteArray GidMapper::encodeLayerData(const TileLayer &tileLayer,
     if (bounds.isEmpty())
         bounds = QRect(0, 0, tileLayer.width(), tileLayer.height());
 
-    QByteArray tileData;
-    tileData.reserve(bounds.width() * bounds.height() * 4);
+    QByteArray tileData(bounds.width() * bounds.height() * 4, Qt::Uninitialized);
+    uchar *out = reinterpret_cast<uchar*>(tileData.data());
+
+    // Look up the first gid of each tileset only once
+    QHash<const Tileset*, unsigned> firstGids;
+    for (auto it = mFirstGidToTileset.begin(); it != mFirstGidToTileset.end(); ++it)
+        firstGids.insert(it.value().data(), it.key());
 
+    const Tileset *lastTileset = nullptr;
+    unsigned lastFirstGid = 0;
+
+    auto toGid = [&] (const Cell &cell) -> unsigned {
+        const Tileset *tileset = cell.tileset();
+        if (!tileset)
+            return 0;
+
+        if (tileset != lastTileset) {
+            const auto it = firstGids.constFind(tileset);
+            if (it == firstGids.constEnd()) // tileset not found
+                return 0;
+
+            lastTileset = tileset;
+            lastFirstGid = it.value();
+        }
+
+        return (lastFirstGid + cell.tileId()) | gidFlags(cell);
+    };
+
+    // Go through the layer a chunk row at a time, so that each chunk is only
+    // looked up once per row
     for (int y = bounds.top(); y <= bounds.bottom(); ++y) {
-        for (int x = bounds.left(); x <= bounds.right(); ++x) {
-            const unsigned gid = cellToGid(tileLayer.cellAt(x, y));
-            tileData.append(static_cast<char>(gid));
-            tileData.append(static_cast<char>(gid >> 8));
-            tileData.append(static_cast<char>(gid >> 16));
-            tileData.append(static_cast<char>(gid >> 24));
+        int x = bounds.left();
+        while (x <= bounds.right()) {
+            const int span = qMin(bounds.right() - x + 1, CHUNK_SIZE - (x & CHUNK_MASK));
+
+            if (const Chunk *chunk = tileLayer.findChunk(x, y)) {
+                const int chunkX = x & CHUNK_MASK;
+                const int chunkY = y & CHUNK_MASK;
+                for (int i = 0; i < span; ++i, out += 4)
+                    qToLittleEndian<quint32>(toGid(chunk->cellAt(chunkX + i, chunkY)), out);
+            } else {
+                memset(out, 0, span * 4);
+                out += span * 4;
+            }
+
+            x += span;
         }
     }
 
     if (format == Map::Base64Gzip)
-        tileData = compress(tileData, Gzip);
+        tileData = compress(tileData, Gzip, compressionLevel);
     else if (format == Map::Base64Zlib)
-        tileData = compress(tileData, Zlib);
+        tileData = compress(tileData, Zlib, compressionLevel);
+    else if (format == Map::Base64Zstandard)
+        tileData = compress(tileData, Zstandard, compressionLevel);
 
     return tileData.toBase64();
 }
@@ -191,35 +327,46 @@ GidMapper::DecodeError GidMapper::decodeLayerData(TileLayer &tileLayer,
 
     if (format == Map::Base64Gzip || format == Map::Base64Zlib)
         decodedData = decompress(decodedData, size);
+    else if (format == Map::Base64Zstandard)
+        decodedData = decompress(decodedData, size, Zstandard);
 
     if (size != decodedData.length())
         return CorruptLayerData;
 
-    const unsigned char *data = reinterpret_cast<const unsigned char*>(decodedData.constData());
-    int x = bounds.x();
-    int y = bounds.y();
-    bool ok;
-
-    for (int i = 0; i < size - 3; i += 4) {
-        const unsigned gid = data[i] |
-                             data[i + 1] << 8 |
-                             data[i + 2] << 16 |
-                             data[i + 3] << 24;
-
-        const Cell result = gidToCell(gid, ok);
-        if (!ok) {
-            mInvalidTile = gid;
-            return isEmpty() ? TileButNoTilesets : InvalidTile;
-        }
+    const uchar *data = reinterpret_cast<const uchar*>(decodedData.constData());
+    GidLookup lookup(mFirstGidToTileset);
 
-        tileLayer.setCell(x, y, result);
+    auto nextGid = [&] {
+        const unsigned gid = qFromLittleEndian<quint32>(data);
+        data += 4;
+        return gid;
+    };
 
-        x++;
-        if (x > bounds.right()) {
-            x = bounds.x();
-            y++;
-        }
-    }
+    if (!setCellsFromGids(tileLayer, bounds, lookup, nextGid, mInvalidTile))
+        return isEmpty() ? TileButNoTilesets : InvalidTile;
+
+    return NoError;
+}
+
+/**
+ * Sets the cells of \a tileLayer within \a bounds to the given \a gids,
+ * which are stored row by row. There need to be as many gids as there are
+ * cells in \a bounds.
+ */
+GidMapper::DecodeError GidMapper::decodeGids(TileLayer &tileLayer,
+                                             const QVector<unsigned> &gids,
+                                             QRect bounds) const
+{
+    if (gids.size() != bounds.width() * bounds.height())
+        return CorruptLayerData;
+
+    const unsigned *data = gids.constData();
+    GidLookup lookup(mFirstGidToTileset);
+
+    auto nextGid = [&] { return *data++; };
+
+    if (!setCellsFromGids(tileLayer, bounds, lookup, nextGid, mInvalidTile))
+        return isEmpty() ? TileButNoTilesets : InvalidTile;
 
     return NoError;
 }
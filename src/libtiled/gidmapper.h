@@ -53,7 +53,8 @@ public:
 
     QByteArray encodeLayerData(const TileLayer &tileLayer,
                                Map::LayerDataFormat format,
-                               QRect bounds = QRect()) const;
+                               QRect bounds = QRect(),
+                               int compressionLevel = -1) const;
 
     enum DecodeError {
         NoError = 0,
@@ -67,6 +68,10 @@ public:
                                 Map::LayerDataFormat format,
                                 QRect bounds) const;
 
+    DecodeError decodeGids(TileLayer &tileLayer,
+                           const QVector<unsigned> &gids,
+                           QRect bounds) const;
+
     unsigned invalidTile() const;
 
 private:
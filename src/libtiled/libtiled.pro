@@ -18,6 +18,13 @@ win32 {
 } else {
     # On other platforms it is necessary to link to zlib explicitly
     LIBS += -lz
+
+    # Zstandard compression is supported when libzstd is available
+    packagesExist(libzstd) {
+        DEFINES += TILED_ZSTD_SUPPORT
+        CONFIG += link_pkgconfig
+        PKGCONFIG += libzstd
+    }
 }
 
 DEFINES += QT_NO_CAST_FROM_ASCII \
@@ -58,6 +58,7 @@ Map::Map(Orientation orientation,
     mStaggerIndex(StaggerOdd),
     mDrawMarginsDirty(true),
     mLayerDataFormat(Base64Zlib),
+    mCompressionLevel(-1),
     mNextLayerId(1),
     mNextObjectId(1)
 {
@@ -89,6 +90,7 @@ Map::Map(const Map &map):
     mDrawMarginsDirty(map.mDrawMarginsDirty),
     mTilesets(map.mTilesets),
     mLayerDataFormat(map.mLayerDataFormat),
+    mCompressionLevel(map.mCompressionLevel),
     mNextObjectId(1)
 {
     for (const Layer *layer : map.mLayers) {
@@ -445,3 +447,30 @@ Map::RenderOrder Tiled::renderOrderFromString(const QString &string)
     }
     return renderOrder;
 }
+
+bool Tiled::isCompressed(Map::LayerDataFormat format)
+{
+    switch (format) {
+    case Map::Base64Gzip:
+    case Map::Base64Zlib:
+    case Map::Base64Zstandard:
+        return true;
+    case Map::XML:
+    case Map::Base64:
+    case Map::CSV:
+        break;
+    }
+    return false;
+}
+
+CompressionMethod Tiled::compressionMethod(Map::LayerDataFormat format)
+{
+    switch (format) {
+    case Map::Base64Gzip:
+        return Gzip;
+    case Map::Base64Zstandard:
+        return Zstandard;
+    default:
+        return Zlib;
+    }
+}
@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include "compression.h"
 #include "layer.h"
 #include "object.h"
 #include "tileset.h"
@@ -93,7 +94,8 @@ public:
         Base64     = 1,
         Base64Gzip = 2,
         Base64Zlib = 3,
-        CSV        = 4
+        CSV        = 4,
+        Base64Zstandard = 5
     };
 
     /**
@@ -437,6 +439,15 @@ public:
     void setLayerDataFormat(LayerDataFormat format)
     { mLayerDataFormat = format; }
 
+    /**
+     * The level used when compressing the layer data. -1 means the default
+     * level of the compression method.
+     */
+    int compressionLevel() const
+    { return mCompressionLevel; }
+    void setCompressionLevel(int level)
+    { mCompressionLevel = level; }
+
     void setNextLayerId(int nextId);
     int nextLayerId() const;
     int takeNextLayerId();
@@ -473,6 +484,7 @@ private:
     QList<Layer*> mLayers;
     QVector<SharedTileset> mTilesets;
     LayerDataFormat mLayerDataFormat;
+    int mCompressionLevel;
     int mNextLayerId;
     int mNextObjectId;
 };
@@ -645,6 +657,13 @@ TILEDSHARED_EXPORT Map::Orientation orientationFromString(const QString &);
 TILEDSHARED_EXPORT QString renderOrderToString(Map::RenderOrder renderOrder);
 TILEDSHARED_EXPORT Map::RenderOrder renderOrderFromString(const QString &);
 
+/**
+ * Returns whether tile layer data stored in the given \a format is
+ * compressed. The method used is returned by compressionMethod().
+ */
+TILEDSHARED_EXPORT bool isCompressed(Map::LayerDataFormat format);
+TILEDSHARED_EXPORT CompressionMethod compressionMethod(Map::LayerDataFormat format);
+
 typedef QSharedPointer<Map> SharedMap;
 
 } // namespace Tiled
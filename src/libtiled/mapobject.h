@@ -159,6 +159,7 @@ public:
     void setPosition(const QPointF &pos)
     {
         mPos=pos;
+        geometryChanged();
     }
 
     const QPointF position() const
@@ -243,6 +244,8 @@ public:
 
 
 private:
+    void geometryChanged();
+
     void flipRectObject(const QTransform &flipTransform);
     void flipPolygonObject(const QTransform &flipTransform);
     void flipTileObject(const QTransform &flipTransform);
@@ -331,7 +334,7 @@ inline qreal MapObject::x() const
  * Sets the x position of this object.
  */
 inline void MapObject::setX(qreal x)
-{ mPos.setX(x); }
+{ mPos.setX(x); geometryChanged(); }
 
 /**
  * Returns the y position of this object.
@@ -343,7 +346,7 @@ inline qreal MapObject::y() const
  * Sets the x position of this object.
  */
 inline void MapObject::setY(qreal y)
-{ mPos.setY(y); }
+{ mPos.setY(y); geometryChanged(); }
 
 /**
  * Returns the size of this object.
@@ -355,7 +358,7 @@ inline const QSizeF &MapObject::size() const
  * Sets the size of this object.
  */
 inline void MapObject::setSize(const QSizeF &size)
-{ mSize = size; }
+{ mSize = size; geometryChanged(); }
 
 inline void MapObject::setSize(qreal width, qreal height)
 { setSize(QSizeF(width, height)); }
@@ -370,7 +373,7 @@ inline qreal MapObject::width() const
  * Sets the width of this object.
  */
 inline void MapObject::setWidth(qreal width)
-{ mSize.setWidth(width); }
+{ mSize.setWidth(width); geometryChanged(); }
 
 /**
  * Returns the height of this object.
@@ -382,7 +385,7 @@ inline qreal MapObject::height() const
  * Sets the height of this object.
  */
 inline void MapObject::setHeight(qreal height)
-{ mSize.setHeight(height); }
+{ mSize.setHeight(height); geometryChanged(); }
 
 /**
  * Sets the position and size of this object.
@@ -391,6 +394,7 @@ inline void MapObject::setBounds(const QRectF &bounds)
 {
     mPos = bounds.topLeft();
     mSize = bounds.size();
+    geometryChanged();
 }
 
 /**
@@ -413,7 +417,7 @@ inline const QPolygonF &MapObject::polygon() const
  * \sa setShape()
  */
 inline void MapObject::setPolygon(const QPolygonF &polygon)
-{ mPolygon = polygon; }
+{ mPolygon = polygon; geometryChanged(); }
 
 /**
  * Returns the shape of the object.
@@ -425,7 +429,7 @@ inline MapObject::Shape MapObject::shape() const
  * Sets the shape of the object.
  */
 inline void MapObject::setShape(MapObject::Shape shape)
-{ mShape = shape; }
+{ mShape = shape; geometryChanged(); }
 
 /**
  * Returns true if this object has a width and height.
@@ -470,7 +474,7 @@ inline const Cell &MapObject::cell() const
  * \warning The object shape is ignored for tile objects!
  */
 inline void MapObject::setCell(const Cell &cell)
-{ mCell = cell; }
+{ mCell = cell; geometryChanged(); }
 
 inline const ObjectTemplate *MapObject::objectTemplate() const
 { return mObjectTemplate; }
@@ -501,7 +505,7 @@ inline qreal MapObject::rotation() const
  * Sets the rotation of the object in degrees clockwise.
  */
 inline void MapObject::setRotation(qreal rotation)
-{ mRotation = rotation; }
+{ mRotation = rotation; geometryChanged(); }
 
 inline bool MapObject::isVisible() const
 { return mVisible; }
@@ -110,6 +110,8 @@ private:
     void decodeCSVLayerData(TileLayer &tileLayer,
                             QStringRef text,
                             QRect bounds);
+    void raiseDecodeError(GidMapper::DecodeError error,
+                          const TileLayer &tileLayer);
 
     /**
      * Returns the cell for the given global tile ID. Errors are raised with
@@ -277,6 +279,9 @@ Map *MapReaderPrivate::readMap()
     const int nextLayerId = atts.value(QLatin1String("nextlayerid")).toInt();
     const int nextObjectId = atts.value(QLatin1String("nextobjectid")).toInt();
 
+    bool compressionLevelOk;
+    const int compressionLevel = atts.value(QLatin1String("compressionlevel")).toInt(&compressionLevelOk);
+
     mMap.reset(new Map(orientation, mapWidth, mapHeight, tileWidth, tileHeight, infinite));
     mMap->setHexSideLength(hexSideLength);
     mMap->setStaggerAxis(staggerAxis);
@@ -286,6 +291,8 @@ Map *MapReaderPrivate::readMap()
         mMap->setNextLayerId(nextLayerId);
     if (nextObjectId)
         mMap->setNextObjectId(nextObjectId);
+    if (compressionLevelOk)
+        mMap->setCompressionLevel(compressionLevel);
 
     QStringRef bgColorString = atts.value(QLatin1String("backgroundcolor"));
     if (!bgColorString.isEmpty())
@@ -783,6 +790,8 @@ void MapReaderPrivate::readTileLayerData(TileLayer &tileLayer)
             layerDataFormat = Map::Base64Gzip;
         } else if (compression == QLatin1String("zlib")) {
             layerDataFormat = Map::Base64Zlib;
+        } else if (compression == QLatin1String("zstd") && compressionSupported(Zstandard)) {
+            layerDataFormat = Map::Base64Zstandard;
         } else {
             xml.raiseError(tr("Compression method '%1' not supported")
                            .arg(compression.toString()));
@@ -866,10 +875,13 @@ void MapReaderPrivate::decodeBinaryLayerData(TileLayer &tileLayer,
                                              Map::LayerDataFormat format,
                                              QRect bounds)
 {
-    GidMapper::DecodeError error;
-
-    error = mGidMapper.decodeLayerData(tileLayer, data, format, bounds);
+    raiseDecodeError(mGidMapper.decodeLayerData(tileLayer, data, format, bounds),
+                     tileLayer);
+}
 
+void MapReaderPrivate::raiseDecodeError(GidMapper::DecodeError error,
+                                        const TileLayer &tileLayer)
+{
     switch (error) {
     case GidMapper::CorruptLayerData:
         xml.raiseError(tr("Corrupt layer data for layer '%1'").arg(tileLayer.name()));
@@ -885,38 +897,75 @@ void MapReaderPrivate::decodeBinaryLayerData(TileLayer &tileLayer,
     }
 }
 
+static bool isCSVWhitespace(QChar c)
+{
+    const ushort u = c.unicode();
+    return u == ' ' || u == '\n' || u == '\r' || u == '\t';
+}
+
 void MapReaderPrivate::decodeCSVLayerData(TileLayer &tileLayer,
                                           QStringRef text,
                                           QRect bounds)
 {
-    QString trimText = text.trimmed().toString();
-    QStringList tiles = trimText.split(QLatin1Char(','));
+    const int size = bounds.width() * bounds.height();
 
-    int lengthCheck = bounds.width() * bounds.height();
+    QVector<unsigned> gids;
+    gids.reserve(size);
 
-    if (tiles.length() != lengthCheck) {
-        xml.raiseError(tr("Corrupt layer data for layer '%1'")
-                       .arg(tileLayer.name()));
-        return;
-    }
+    // Parse the gids straight out of the text, allowing whitespace around
+    // each of them
+    const QChar *it = text.unicode();
+    const QChar *end = it + text.size();
 
-    int currentTile = 0;
+    while (true) {
+        while (it != end && isCSVWhitespace(*it))
+            ++it;
 
-    for (int y = bounds.top(); y <= bounds.bottom(); y++) {
-        for (int x = bounds.left(); x <= bounds.right(); x++) {
-            bool conversionOk;
-            const unsigned gid = tiles.at(currentTile++).toUInt(&conversionOk);
+        quint64 gid = 0;
+        bool conversionOk = false;
 
-            if (!conversionOk) {
-                xml.raiseError(
-                        tr("Unable to parse tile at (%1,%2) on layer '%3'")
-                               .arg(x + 1).arg(y + 1).arg(tileLayer.name()));
-                return;
-            }
+        while (it != end && it->unicode() >= '0' && it->unicode() <= '9') {
+            if (gid <= 0xFFFFFFFFu)
+                gid = gid * 10 + (it->unicode() - '0');
+            conversionOk = true;
+            ++it;
+        }
+
+        while (it != end && isCSVWhitespace(*it))
+            ++it;
 
-            tileLayer.setCell(x, y, cellForGid(gid));
+        const int index = gids.size();
+        if (index == size) {
+            xml.raiseError(tr("Corrupt layer data for layer '%1'")
+                           .arg(tileLayer.name()));
+            return;
+        }
+
+        if (!conversionOk || gid > 0xFFFFFFFFu ||
+                (it != end && *it != QLatin1Char(','))) {
+            const int x = bounds.left() + index % bounds.width();
+            const int y = bounds.top() + index / bounds.width();
+            xml.raiseError(
+                    tr("Unable to parse tile at (%1,%2) on layer '%3'")
+                           .arg(x + 1).arg(y + 1).arg(tileLayer.name()));
+            return;
         }
+
+        gids.append(unsigned(gid));
+
+        if (it == end)
+            break;
+
+        ++it;   // skip the comma
     }
+
+    if (gids.size() != size) {
+        xml.raiseError(tr("Corrupt layer data for layer '%1'")
+                       .arg(tileLayer.name()));
+        return;
+    }
+
+    raiseDecodeError(mGidMapper.decodeGids(tileLayer, gids, bounds), tileLayer);
 }
 
 Cell MapReaderPrivate::cellForGid(unsigned gid)
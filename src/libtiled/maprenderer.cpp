@@ -200,6 +200,20 @@ CellRenderer::CellRenderer(QPainter *painter, const CellType cellType)
 {
 }
 
+/**
+ * Tells the renderer that cells are laid out on a grid of the given \a size,
+ * one cell per grid position.
+ *
+ * Cells that exactly fill their grid position can't overlap each other, so
+ * their drawing order doesn't matter. Those cells are collected per tile
+ * image over all render calls, and each image is drawn in one go on flush.
+ * Cells that extend beyond their grid position are still drawn in order.
+ */
+void CellRenderer::setGridCellSize(const QSizeF &size)
+{
+    mGridCellSize = size;
+}
+
 /**
  * Renders a \a cell with the given \a origin at \a pos, taking into account
  * the flipping and tile offset.
@@ -208,6 +222,8 @@ CellRenderer::CellRenderer(QPainter *painter, const CellType cellType)
  * kind of tile has to be drawn. For this reason it is necessary to call
  * flush when finished doing drawCell calls. This function is also called by
  * the destructor so usually an explicit call is not needed.
+ *
+ * \sa setGridCellSize()
  */
 void CellRenderer::render(const Cell &cell, const QPointF &pos, const QSizeF &size, Origin origin)
 {
@@ -224,11 +240,6 @@ void CellRenderer::render(const Cell &cell, const QPointF &pos, const QSizeF &si
         return;
     }
 
-    // The USHRT_MAX limit is rather arbitrary but avoids a crash in
-    // drawPixmapFragments for a large number of fragments.
-    if (mTile != tile || mFragments.size() == USHRT_MAX)
-        flush();
-
     const QPixmap &image = tile->image();
     const QSizeF imageSize = image.size();
     if (imageSize.isEmpty())
@@ -281,16 +292,50 @@ void CellRenderer::render(const Cell &cell, const QPointF &pos, const QSizeF &si
     fragment.scaleX = scale.width() * (flippedHorizontally ? -1 : 1);
     fragment.scaleY = scale.height() * (flippedVertically ? -1 : 1);
 
-    if (mIsOpenGL || (fragment.scaleX > 0 && fragment.scaleY > 0)) {
-        mTile = tile;
-        mFragments.append(fragment);
-        return;
-    }
-
     // The Raster paint engine as of Qt 4.8.4 / 5.0.2 does not support
     // drawing fragments with a negative scaling factor.
-
-    flush(); // make sure we drew all tiles so far
+    const bool canUseFragment = mIsOpenGL || (fragment.scaleX > 0 && fragment.scaleY > 0);
+
+    const bool fillsGridCell = mCellType == OrthogonalCells &&
+            origin == BottomLeft &&
+            size == mGridCellSize &&
+            offset.isNull() &&
+            (fragment.rotation == 0 || size.width() == size.height());
+
+    if (fillsGridCell) {
+        // Anything drawn in order so far needs to end up below this cell
+        flushInOrder();
+
+        if (canUseFragment) {
+            auto &fragments = mGridBatches[tile];
+            if (fragments.isEmpty())
+                mGridBatchOrder.append(tile);
+
+            fragments.append(fragment);
+
+            // The USHRT_MAX limit is rather arbitrary but avoids a crash in
+            // drawPixmapFragments for a large number of fragments.
+            if (fragments.size() == USHRT_MAX) {
+                drawFragments(fragments, tile);
+                fragments.resize(0);
+            }
+            return;
+        }
+    } else {
+        // This cell may overlap others, so draw the collected cells first
+        flushGridBatches();
+
+        if (canUseFragment) {
+            if (mTile != tile || mFragments.size() == USHRT_MAX)
+                flushInOrder();
+
+            mTile = tile;
+            mFragments.append(fragment);
+            return;
+        }
+
+        flushInOrder(); // make sure we drew all tiles so far
+    }
 
     const QTransform oldTransform = mPainter->transform();
     QTransform transform = oldTransform;
@@ -311,14 +356,48 @@ void CellRenderer::render(const Cell &cell, const QPointF &pos, const QSizeF &si
  * Renders any remaining cells.
  */
 void CellRenderer::flush()
+{
+    flushGridBatches();
+    flushInOrder();
+}
+
+/**
+ * Draws the cells of the current tile that are rendered in order.
+ */
+void CellRenderer::flushInOrder()
 {
     if (!mTile)
         return;
 
-    mPainter->drawPixmapFragments(mFragments.constData(),
-                                  mFragments.size(),
-                                  mTile->image());
+    drawFragments(mFragments, mTile);
 
     mTile = nullptr;
     mFragments.resize(0);
 }
+
+/**
+ * Draws the cells collected per tile image, in the order in which their
+ * images were first used.
+ */
+void CellRenderer::flushGridBatches()
+{
+    if (mGridBatchOrder.isEmpty())
+        return;
+
+    for (const Tile *tile : qAsConst(mGridBatchOrder)) {
+        const auto &fragments = mGridBatches[tile];
+        if (!fragments.isEmpty())
+            drawFragments(fragments, tile);
+    }
+
+    mGridBatches.clear();
+    mGridBatchOrder.resize(0);
+}
+
+void CellRenderer::drawFragments(const QVector<QPainter::PixmapFragment> &fragments,
+                                 const Tile *tile)
+{
+    mPainter->drawPixmapFragments(fragments.constData(),
+                                  fragments.size(),
+                                  tile->image());
+}
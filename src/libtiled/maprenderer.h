@@ -30,7 +30,9 @@
 
 #include "tiled_global.h"
 
+#include <QHash>
 #include <QPainter>
+#include <QVector>
 
 namespace Tiled {
 
@@ -292,13 +294,23 @@ public:
 
     ~CellRenderer() { flush(); }
 
+    void setGridCellSize(const QSizeF &size);
+
     void render(const Cell &cell, const QPointF &pos, const QSizeF &size, Origin origin);
     void flush();
 
 private:
+    void flushInOrder();
+    void flushGridBatches();
+    void drawFragments(const QVector<QPainter::PixmapFragment> &fragments,
+                       const Tile *tile);
+
     QPainter * const mPainter;
     const Tile *mTile;
     QVector<QPainter::PixmapFragment> mFragments;
+    QSizeF mGridCellSize;
+    QHash<const Tile*, QVector<QPainter::PixmapFragment>> mGridBatches;
+    QVector<const Tile*> mGridBatchOrder;
     const bool mIsOpenGL;
     const CellType mCellType;
 };
@@ -21,6 +21,7 @@
 
 #include "maptovariantconverter.h"
 
+#include "compression.h"
 #include "grouplayer.h"
 #include "imagelayer.h"
 #include "map.h"
@@ -90,8 +91,24 @@ QVariant MapToVariantConverter::toVariant(const Map &map, const QDir &mapDir)
     }
     mapVariant[QLatin1String("tilesets")] = tilesetVariants;
 
-    mapVariant[QLatin1String("layers")] = toVariant(map.layers(),
-                                                    map.layerDataFormat());
+    Map::LayerDataFormat format = map.layerDataFormat();
+    mCompressionLevel = map.compressionLevel();
+
+    if (mOverrideLayerDataFormat) {
+        format = mLayerDataFormat;
+        mCompressionLevel = -1;
+    }
+
+    // Fall back to zlib when built without Zstandard support
+    if (format == Map::Base64Zstandard && !compressionSupported(Zstandard)) {
+        format = Map::Base64Zlib;
+        mCompressionLevel = -1;
+    }
+
+    if (mCompressionLevel != -1 && isCompressed(format))
+        mapVariant[QLatin1String("compressionlevel")] = mCompressionLevel;
+
+    mapVariant[QLatin1String("layers")] = toVariant(map.layers(), format);
 
     return mapVariant;
 }
@@ -378,12 +395,15 @@ QVariant MapToVariantConverter::toVariant(const TileLayer &tileLayer,
     case Map::Base64:
     case Map::Base64Zlib:
     case Map::Base64Gzip:
+    case Map::Base64Zstandard:
         tileLayerVariant[QLatin1String("encoding")] = QLatin1String("base64");
 
         if (format == Map::Base64Zlib)
             tileLayerVariant[QLatin1String("compression")] = QLatin1String("zlib");
         else if (format == Map::Base64Gzip)
             tileLayerVariant[QLatin1String("compression")] = QLatin1String("gzip");
+        else if (format == Map::Base64Zstandard)
+            tileLayerVariant[QLatin1String("compression")] = QLatin1String("zstd");
 
         break;
     }
@@ -620,8 +640,10 @@ void MapToVariantConverter::addTileLayerData(QVariantMap &variant,
     }
     case Map::Base64:
     case Map::Base64Zlib:
-    case Map::Base64Gzip: {
-        QByteArray layerData = mGidMapper.encodeLayerData(tileLayer, format, bounds);
+    case Map::Base64Gzip:
+    case Map::Base64Zstandard: {
+        QByteArray layerData = mGidMapper.encodeLayerData(tileLayer, format, bounds,
+                                                          mCompressionLevel);
         variant[QLatin1String("data")] = layerData;
         break;
     }
@@ -41,7 +41,21 @@ struct TextData;
 class TILEDSHARED_EXPORT MapToVariantConverter
 {
 public:
-    MapToVariantConverter() {}
+    MapToVariantConverter()
+        : mCompressionLevel(-1)
+        , mLayerDataFormat(Map::XML)
+        , mOverrideLayerDataFormat(false)
+    {}
+
+    /**
+     * Makes the converter store tile layer data in the given \a format,
+     * instead of using the layer data format of the converted map.
+     */
+    void setLayerDataFormat(Map::LayerDataFormat format)
+    {
+        mLayerDataFormat = format;
+        mOverrideLayerDataFormat = true;
+    }
 
     /**
      * Converts the given \a map to a QVariant. The \a mapDir is used to
@@ -81,6 +95,9 @@ private:
 
     QDir mMapDir;
     GidMapper mGidMapper;
+    int mCompressionLevel;
+    Map::LayerDataFormat mLayerDataFormat;
+    bool mOverrideLayerDataFormat;
 };
 
 } // namespace Tiled
@@ -84,6 +84,7 @@ public:
 
     QString mError;
     Map::LayerDataFormat mLayerDataFormat;
+    int mCompressionLevel;
     bool mDtdEnabled;
 
 private:
@@ -113,6 +114,7 @@ private:
 
 MapWriterPrivate::MapWriterPrivate()
     : mLayerDataFormat(Map::Base64Zlib)
+    , mCompressionLevel(-1)
     , mDtdEnabled(false)
     , mUseAbsolutePaths(false)
 {
@@ -148,6 +150,13 @@ void MapWriterPrivate::writeMap(const Map *map, QIODevice *device,
 {
    mUseAbsolutePaths = path.isEmpty();
    mLayerDataFormat = map->layerDataFormat();
+   mCompressionLevel = map->compressionLevel();
+
+   // Fall back to zlib when built without Zstandard support
+   if (mLayerDataFormat == Map::Base64Zstandard && !compressionSupported(Zstandard)) {
+       mLayerDataFormat = Map::Base64Zlib;
+       mCompressionLevel = -1;
+   }
 
    QXmlStreamWriter writer(device);
    writer.setAutoFormatting(false);
@@ -218,6 +227,8 @@ void MapWriterPrivate::writeMap(QXmlStreamWriter &w, const Map &map)
     w.writeAttribute(QLatin1String("tiledversion"), QCoreApplication::applicationVersion());
     w.writeAttribute(QLatin1String("orientation"), orientation);
     w.writeAttribute(QLatin1String("renderorder"), renderOrder);
+    if (mCompressionLevel != -1 && isCompressed(mLayerDataFormat))
+        w.writeAttribute(QLatin1String("compressionlevel"), QString::number(mCompressionLevel));
     w.writeAttribute(QLatin1String("width"), QString::number(map.width()));
     w.writeAttribute(QLatin1String("height"), QString::number(map.height()));
     w.writeAttribute(QLatin1String("tilewidth"),
@@ -568,7 +579,8 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
 
     if (mLayerDataFormat == Map::Base64
             || mLayerDataFormat == Map::Base64Gzip
-            || mLayerDataFormat == Map::Base64Zlib) {
+            || mLayerDataFormat == Map::Base64Zlib
+            || mLayerDataFormat == Map::Base64Zstandard) {
 
         encoding = QLatin1String("base64");
 
@@ -576,6 +588,8 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
             compression = QLatin1String("gzip");
         else if (mLayerDataFormat == Map::Base64Zlib)
             compression = QLatin1String("zlib");
+        else if (mLayerDataFormat == Map::Base64Zstandard)
+            compression = QLatin1String("zstd");
 
     } else if (mLayerDataFormat == Map::CSV)
         encoding = QLatin1String("csv");
@@ -639,7 +653,8 @@ void MapWriterPrivate::writeTileLayerData(QXmlStreamWriter &w,
     } else {
         QByteArray chunkData = mGidMapper.encodeLayerData(tileLayer,
                                                           mLayerDataFormat,
-                                                          bounds);
+                                                          bounds,
+                                                          mCompressionLevel);
 
         w.writeCharacters(QLatin1String("\n   "));
         w.writeCharacters(QString::fromLatin1(chunkData));
@@ -34,10 +34,27 @@
 namespace Tiled {
 
 ObjectTypes Object::mObjectTypes;
+QHash<QString, int> Object::mObjectTypeIndex;
 
 Object::~Object()
 {}
 
+/**
+ * Looks up the property \a name in \a properties, storing its value in
+ * \a value when found.
+ */
+static bool findProperty(const Properties &properties,
+                         const QString &name,
+                         QVariant &value)
+{
+    const auto it = properties.constFind(name);
+    if (it == properties.constEnd())
+        return false;
+
+    value = it.value();
+    return true;
+}
+
 /**
  * Returns the value of the property \a name, taking into account that it may
  * be inherited from another object or from the type.
@@ -50,8 +67,10 @@ Object::~Object()
  */
 QVariant Object::inheritedProperty(const QString &name) const
 {
-    if (hasProperty(name))
-        return property(name);
+    QVariant value;
+
+    if (findProperty(mProperties, name, value))
+        return value;
 
     QString objectType;
 
@@ -61,12 +80,12 @@ QVariant Object::inheritedProperty(const QString &name) const
         objectType = mapObject->type();
 
         if (const MapObject *templateObject = mapObject->templateObject())
-            if (templateObject->hasProperty(name))
-                return templateObject->property(name);
+            if (findProperty(templateObject->properties(), name, value))
+                return value;
 
         if (Tile *tile = mapObject->cell().tile()) {
-            if (tile->hasProperty(name))
-                return tile->property(name);
+            if (findProperty(tile->properties(), name, value))
+                return value;
 
             if (objectType.isEmpty())
                 objectType = tile->type();
@@ -82,19 +101,26 @@ QVariant Object::inheritedProperty(const QString &name) const
     }
 
     if (!objectType.isEmpty()) {
-        for (const ObjectType &type : mObjectTypes) {
-            if (type.name == objectType)
-                if (type.defaultProperties.contains(name))
-                    return type.defaultProperties.value(name);
-        }
+        const int index = mObjectTypeIndex.value(objectType, -1);
+        if (index != -1)
+            findProperty(mObjectTypes.at(index).defaultProperties, name, value);
     }
 
-    return QVariant();
+    return value;
 }
 
 void Object::setObjectTypes(const ObjectTypes &objectTypes)
 {
     mObjectTypes = objectTypes;
+    mObjectTypeIndex.clear();
+
+    // Index the types by name, since inheritedProperty is called often.
+    // When several types share a name, the first one is used.
+    for (int i = 0; i < mObjectTypes.size(); ++i) {
+        const ObjectType &type = mObjectTypes.at(i);
+        if (!mObjectTypeIndex.contains(type.name))
+            mObjectTypeIndex.insert(type.name, i);
+    }
 }
 
 } // namespace Tiled
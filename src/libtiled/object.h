@@ -31,6 +31,8 @@
 #include "properties.h"
 #include "objecttypes.h"
 
+#include <QHash>
+
 namespace Tiled {
 
 /**
@@ -135,6 +137,7 @@ private:
     Properties mProperties;
 
     static ObjectTypes mObjectTypes;
+    static QHash<QString, int> mObjectTypeIndex;
 };
 
 
@@ -35,10 +35,276 @@
 #include "mapobject.h"
 #include "tile.h"
 
+#include <QHash>
+#include <QRegion>
+#include <QTransform>
+#include <QVector>
+#include <qmath.h>
+
+#include <algorithm>
 #include <cmath>
 
 using namespace Tiled;
 
+namespace {
+
+/*
+ * The size of the cells of the spatial index in pixels. Most objects are
+ * much smaller, so they end up in a single cell.
+ */
+const qreal IndexCellSize = 256;
+
+/*
+ * Objects that would be spread over more cells than this are kept aside and
+ * checked by every query instead.
+ */
+const int MaxCellsPerObject = 1024;
+
+quint64 cellKey(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
+}
+
+/*
+ * Returns the range of index cells covered by \a rect, or a null rect when
+ * the rect is too far out to be mapped to cells.
+ */
+QRect cellRange(const QRectF &rect)
+{
+    static const QRectF limits(-1e9, -1e9, 2e9, 2e9);
+    if (!limits.contains(rect))
+        return QRect();
+
+    return QRect(QPoint(qFloor(rect.left() / IndexCellSize),
+                        qFloor(rect.top() / IndexCellSize)),
+                 QPoint(qFloor(rect.right() / IndexCellSize),
+                        qFloor(rect.bottom() / IndexCellSize)));
+}
+
+/*
+ * Unlike QRectF::united, this also takes into account empty rects, which
+ * is what point objects have.
+ */
+void unite(QRectF &rect, const QRectF &other)
+{
+    rect = QRectF(QPointF(std::min(rect.left(), other.left()),
+                          std::min(rect.top(), other.top())),
+                  QPointF(std::max(rect.right(), other.right()),
+                          std::max(rect.bottom(), other.bottom())));
+}
+
+/*
+ * Like QRectF::intersects, but also true for touching and empty rects.
+ */
+bool touches(const QRectF &a, const QRectF &b)
+{
+    return a.left() <= b.right() && b.left() <= a.right() &&
+            a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+
+/*
+ * Returns the rect by which an object is indexed. It covers the object's
+ * bounds with and without its alignment applied, its tile image and its
+ * polygon, both with and without its rotation around its position.
+ */
+QRectF indexedBounds(const MapObject *object)
+{
+    QRectF bounds = object->bounds().normalized();
+
+    QRectF aligned = bounds;
+    aligned.translate(-alignmentOffset(aligned, object->alignment()));
+    unite(bounds, aligned);
+    unite(bounds, object->boundsUseTile().normalized());
+
+    switch (object->shape()) {
+    case MapObject::Polygon:
+    case MapObject::Polyline:
+        unite(bounds, object->polygon().boundingRect().translated(object->position()));
+        break;
+    default:
+        break;
+    }
+
+    if (object->rotation() != 0) {
+        const QPointF pos = object->position();
+
+        QTransform transform;
+        transform.translate(pos.x(), pos.y());
+        transform.rotate(object->rotation());
+        transform.translate(-pos.x(), -pos.y());
+
+        unite(bounds, transform.mapRect(bounds));
+    }
+
+    return bounds;
+}
+
+} // anonymous namespace
+
+/**
+ * A uniform grid over the bounds of the objects in an object group. It is
+ * used to find the objects at a position or within an area without checking
+ * every object in the group.
+ *
+ * Each object also gets a sequence number, which reflects its position in
+ * the group. This allows queries to return objects in their stacking order.
+ */
+class ObjectGroup::SpatialIndex
+{
+public:
+    explicit SpatialIndex(const QList<MapObject*> &objects)
+        : mNextSequence(0)
+    {
+        mEntries.reserve(objects.size());
+        for (MapObject *object : objects)
+            insert(object);
+    }
+
+    /**
+     * Adds an object, which is expected to be stacked on top of the objects
+     * already in the index.
+     */
+    void insert(MapObject *object)
+    {
+        Entry &entry = mEntries[object];
+        entry.sequence = mNextSequence++;
+        entry.bounds = indexedBounds(object);
+        entry.cells = cellRange(entry.bounds);
+        place(object, entry.cells);
+    }
+
+    void remove(MapObject *object)
+    {
+        auto it = mEntries.find(object);
+        if (it == mEntries.end())
+            return;
+
+        unplace(object, it->cells);
+        mEntries.erase(it);
+    }
+
+    void update(MapObject *object)
+    {
+        auto it = mEntries.find(object);
+        if (it == mEntries.end())
+            return;
+
+        it->bounds = indexedBounds(object);
+
+        const QRect cells = cellRange(it->bounds);
+        if (cells != it->cells) {
+            unplace(object, it->cells);
+            it->cells = cells;
+            place(object, cells);
+        }
+    }
+
+    /**
+     * Returns the objects whose bounds are within \a area and match the
+     * given predicate, in stacking order.
+     */
+    template<typename Matches>
+    QList<MapObject*> query(const QRectF &area, Matches matches) const
+    {
+        QVector<QPair<int, MapObject*>> found;
+
+        auto check = [&] (MapObject *object, const Entry &entry) {
+            if (matches(entry.bounds))
+                found.append(qMakePair(entry.sequence, object));
+        };
+
+        const QRect cells = cellRange(area);
+        const qint64 cellCount = qint64(cells.width()) * cells.height();
+
+        if (cells.isNull() || cellCount > mEntries.size()) {
+            // Checking every object is cheaper than visiting every cell
+            for (auto it = mEntries.constBegin(); it != mEntries.constEnd(); ++it)
+                check(it.key(), it.value());
+        } else {
+            for (MapObject *object : mOversized)
+                check(object, mEntries.value(object));
+
+            for (int y = cells.top(); y <= cells.bottom(); ++y) {
+                for (int x = cells.left(); x <= cells.right(); ++x) {
+                    const auto cell = mCells.constFind(cellKey(x, y));
+                    if (cell == mCells.constEnd())
+                        continue;
+
+                    for (MapObject *object : *cell) {
+                        const Entry &entry = *mEntries.constFind(object);
+
+                        // Objects spanning several cells are only checked
+                        // in the first of their cells covered by the area
+                        const int firstX = std::max(entry.cells.left(), cells.left());
+                        const int firstY = std::max(entry.cells.top(), cells.top());
+                        if (x == firstX && y == firstY)
+                            check(object, entry);
+                    }
+                }
+            }
+        }
+
+        std::sort(found.begin(), found.end());
+
+        QList<MapObject*> objects;
+        objects.reserve(found.size());
+        for (const auto &pair : found)
+            objects.append(pair.second);
+        return objects;
+    }
+
+private:
+    struct Entry
+    {
+        Entry() : sequence(0) {}
+
+        QRectF bounds;
+        QRect cells;
+        int sequence;
+    };
+
+    static bool isOversized(const QRect &cells)
+    {
+        return cells.isNull() ||
+                qint64(cells.width()) * cells.height() > MaxCellsPerObject;
+    }
+
+    void place(MapObject *object, const QRect &cells)
+    {
+        if (isOversized(cells)) {
+            mOversized.append(object);
+            return;
+        }
+
+        for (int y = cells.top(); y <= cells.bottom(); ++y)
+            for (int x = cells.left(); x <= cells.right(); ++x)
+                mCells[cellKey(x, y)].append(object);
+    }
+
+    void unplace(MapObject *object, const QRect &cells)
+    {
+        if (isOversized(cells)) {
+            mOversized.removeOne(object);
+            return;
+        }
+
+        for (int y = cells.top(); y <= cells.bottom(); ++y) {
+            for (int x = cells.left(); x <= cells.right(); ++x) {
+                auto cell = mCells.find(cellKey(x, y));
+                cell->removeOne(object);
+                if (cell->isEmpty())
+                    mCells.erase(cell);
+            }
+        }
+    }
+
+    QHash<MapObject*, Entry> mEntries;
+    QHash<quint64, QVector<MapObject*>> mCells;
+    QVector<MapObject*> mOversized;
+    int mNextSequence;
+};
+
+
 ObjectGroup::ObjectGroup()
     : ObjectGroup(QString(), 0, 0)
 {
@@ -59,6 +325,8 @@ void ObjectGroup::addObject(MapObject *object)
 {
     mObjects.append(object);
     object->setObjectGroup(this);
+    if (mSpatialIndex)
+        mSpatialIndex->insert(object);
     if (mMap && object->id() == 0)
         object->setId(mMap->takeNextObjectId());
 }
@@ -67,6 +335,7 @@ void ObjectGroup::insertObject(int index, MapObject *object)
 {
     mObjects.insert(index, object);
     object->setObjectGroup(this);
+    invalidateSpatialIndex();   // sequence numbers no longer match
     if (mMap && object->id() == 0)
         object->setId(mMap->takeNextObjectId());
 }
@@ -78,6 +347,8 @@ int ObjectGroup::removeObject(MapObject *object)
 
     mObjects.removeAt(index);
     object->setObjectGroup(nullptr);
+    if (mSpatialIndex)
+        mSpatialIndex->remove(object);
     return index;
 }
 
@@ -85,6 +356,8 @@ void ObjectGroup::removeObjectAt(int index)
 {
     MapObject *object = mObjects.takeAt(index);
     object->setObjectGroup(nullptr);
+    if (mSpatialIndex)
+        mSpatialIndex->remove(object);
 }
 
 void ObjectGroup::moveObjects(int from, int to, int count)
@@ -107,6 +380,8 @@ void ObjectGroup::moveObjects(int from, int to, int count)
 
     for (int i = 0; i < count; ++i)
         mObjects.insert(to + i, movingObjects.at(i));
+
+    invalidateSpatialIndex();
 }
 
 QRectF ObjectGroup::objectsBoundingRect() const
@@ -122,6 +397,92 @@ QRectF ObjectGroup::objectsBoundingRect() const
     return boundingRect;
 }
 
+/**
+ * Returns the objects whose bounds contain \a pos, in stacking order.
+ *
+ * The bounds used here include the object's rotation, alignment, tile image
+ * and polygon, so they may cover more than the shape of the object. Callers
+ * needing an exact hit test should check the returned objects further.
+ *
+ * The first query builds a spatial index, which is kept up to date while
+ * objects are added, removed or change their geometry.
+ */
+QList<MapObject*> ObjectGroup::objectsAt(const QPointF &pos) const
+{
+    const QRectF point(pos, QSizeF(0, 0));
+    return spatialIndex().query(point, [&] (const QRectF &bounds) {
+        return touches(bounds, point);
+    });
+}
+
+/**
+ * Returns the objects whose bounds touch \a rect, in stacking order.
+ *
+ * \sa objectsAt()
+ */
+QList<MapObject*> ObjectGroup::objectsIntersecting(const QRectF &rect) const
+{
+    const QRectF area = rect.normalized();
+    return spatialIndex().query(area, [&] (const QRectF &bounds) {
+        return touches(bounds, area);
+    });
+}
+
+/**
+ * Returns the objects whose bounds touch \a region, in stacking order. The
+ * region is given in pixels.
+ *
+ * \sa objectsAt()
+ */
+QList<MapObject*> ObjectGroup::objectsIntersecting(const QRegion &region) const
+{
+    if (region.isEmpty())
+        return QList<MapObject*>();
+
+#if QT_VERSION < 0x050800
+    const auto rects = region.rects();
+#else
+    const QRegion &rects = region;
+#endif
+
+    return spatialIndex().query(region.boundingRect(), [&] (const QRectF &bounds) {
+        for (const QRect &rect : rects)
+            if (touches(bounds, rect))
+                return true;
+        return false;
+    });
+}
+
+/**
+ * Updates the spatial index for the changed geometry of \a object. Called
+ * by MapObject.
+ */
+void ObjectGroup::objectGeometryChanged(MapObject *object)
+{
+    if (mSpatialIndex)
+        mSpatialIndex->update(object);
+}
+
+ObjectGroup::SpatialIndex &ObjectGroup::spatialIndex() const
+{
+    if (!mSpatialIndex)
+        mSpatialIndex.reset(new SpatialIndex(mObjects));
+    return *mSpatialIndex;
+}
+
+/**
+ * Drops the spatial index, so that it gets rebuilt by the next query.
+ *
+ * The indexed bounds also depend on the object alignment and tile sizes of
+ * tilesets, on templates and on the map orientation, none of which notify
+ * the object group when they change. Callers that keep querying a live
+ * layer should drop its index before each batch of queries.
+ */
+void ObjectGroup::invalidateSpatialIndex()
+{
+    mSpatialIndex.reset();
+}
+
 bool ObjectGroup::isEmpty() const
 {
     return mObjects.isEmpty();
@@ -36,6 +36,10 @@
 #include <QList>
 #include <QMetaType>
 
+#include <memory>
+
+class QRegion;
+
 namespace Tiled {
 
 class MapObject;
@@ -125,6 +129,13 @@ public:
      */
     QRectF objectsBoundingRect() const;
 
+    QList<MapObject*> objectsAt(const QPointF &pos) const;
+    QList<MapObject*> objectsIntersecting(const QRectF &rect) const;
+    QList<MapObject*> objectsIntersecting(const QRegion &region) const;
+
+    void objectGeometryChanged(MapObject *object);
+    void invalidateSpatialIndex();
+
     /**
      * Returns whether this object group contains any objects.
      */
@@ -183,9 +194,15 @@ protected:
     ObjectGroup *initializeClone(ObjectGroup *clone) const;
 
 private:
+    class SpatialIndex;
+
+    SpatialIndex &spatialIndex() const;
+
     QList<MapObject*> mObjects;
     QColor mColor;
     DrawOrder mDrawOrder;
+
+    mutable std::unique_ptr<SpatialIndex> mSpatialIndex;
 };
 
 
@@ -294,10 +294,14 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
     if (startX > endX || startY > endY)
         return;
 
+    const int left = startX;
+    const int right = endX;
+
     const QTransform savedTransform = painter->transform();
     painter->translate(layerPos);
 
     CellRenderer renderer(painter);
+    renderer.setGridCellSize(map()->tileSize());
 
     Map::RenderOrder renderOrder = map()->renderOrder();
 
@@ -324,9 +328,41 @@ void OrthogonalRenderer::drawTileLayer(QPainter *painter,
     endX += incX;
     endY += incY;
 
+    // Returns the last position within the chunk of \a pos when moving in
+    // the direction of \a inc, without going past \a end
+    auto lastInChunk = [] (int pos, int inc, int end) {
+        return inc > 0 ? qMin(pos | CHUNK_MASK, end - 1)
+                       : qMax(pos & ~CHUNK_MASK, end + 1);
+    };
+
+    // Checks whether the exposed part of the chunk row at \a y has any chunks
+    auto rowHasChunks = [&] (int y) {
+        for (int x = left; x <= right; x = (x | CHUNK_MASK) + 1)
+            if (layer->findChunk(x, y))
+                return true;
+        return false;
+    };
+
+    // Walk the cells chunk by chunk, skipping the parts of the layer without
+    // any chunks, while keeping the order in which cells are rendered
+    CellLookup cells(*layer);
+
     for (int y = startY; y != endY; y += incY) {
+        if (y == startY || (y & CHUNK_MASK) == (incY > 0 ? 0 : CHUNK_MASK)) {
+            if (!rowHasChunks(y)) {
+                y = lastInChunk(y, incY, endY);
+                continue;
+            }
+        }
+
         for (int x = startX; x != endX; x += incX) {
-            const Cell &cell = layer->cellAt(x, y);
+            const Chunk *chunk = cells.chunkAt(x, y);
+            if (!chunk) {
+                x = lastInChunk(x, incX, endX);
+                continue;
+            }
+
+            const Cell cell = chunk->cellAt(x & CHUNK_MASK, y & CHUNK_MASK);
             if (cell.isEmpty())
                 continue;
 
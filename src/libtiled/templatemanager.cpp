@@ -21,8 +21,14 @@
 
 #include "templatemanager.h"
 
+#include "filesystemwatcher.h"
 #include "objecttemplate.h"
 #include "objecttemplateformat.h"
+#include "qtcompat_p.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
 
 using namespace Tiled;
 
@@ -44,7 +50,10 @@ void TemplateManager::deleteInstance()
 
 TemplateManager::TemplateManager(QObject *parent)
     : QObject(parent)
+    , mWatcher(new FileSystemWatcher(this))
 {
+    connect(mWatcher, &FileSystemWatcher::directoryChanged,
+            this, &TemplateManager::directoryChanged);
 }
 
 TemplateManager::~TemplateManager()
@@ -72,4 +81,75 @@ ObjectTemplate *TemplateManager::loadObjectTemplate(const QString &fileName, QSt
 void TemplateManager::allTemplatesChanged()
 {
 	mObjectTemplates.clear();
+
+    for (TemplateIndex &index : mTemplateIndexes)
+        index.upToDate = false;
+}
+
+/**
+ * Returns the file name of the template called \a name (the file name
+ * without its .tx suffix) within \a templatesDir or any of its
+ * subdirectories, or an empty string when there is no such template.
+ *
+ * The directories are only searched the first time and after one of them
+ * changed on disk, or on each call while \a templatesDir doesn't exist.
+ * \a templatesDir is expected to be an absolute path.
+ */
+QString TemplateManager::templateFileName(const QString &templatesDir, const QString &name)
+{
+    TemplateIndex &index = mTemplateIndexes[templatesDir];
+    if (!index.upToDate)
+        updateIndex(templatesDir, index);
+
+    return index.fileNames.value(name);
+}
+
+void TemplateManager::updateIndex(const QString &templatesDir, TemplateIndex &index)
+{
+    for (const QString &directory : qAsConst(index.directories)) {
+        mWatcher->removePath(directory);
+        mIndexedDirectories.remove(directory);
+    }
+
+    index.fileNames.clear();
+    index.directories.clear();
+
+    // A missing directory can't be watched, so look again on the next lookup
+    // in case it got created since
+    if (!QFileInfo(templatesDir).isDir()) {
+        index.upToDate = false;
+        return;
+    }
+
+    index.directories.append(templatesDir);
+
+    QDirIterator it(templatesDir, QStringList(QStringLiteral("*.tx")),
+                    QDir::Files | QDir::AllDirs | QDir::NoDotAndDotDot,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+
+        if (info.isDir()) {
+            index.directories.append(info.absoluteFilePath());
+        } else if (!index.fileNames.contains(info.baseName())) {
+            // When names clash the first template found wins
+            index.fileNames.insert(info.baseName(), info.absoluteFilePath());
+        }
+    }
+
+    // Templates being added, removed or renamed changes their directory
+    for (const QString &directory : qAsConst(index.directories)) {
+        mWatcher->addPath(directory);
+        mIndexedDirectories.insert(directory, templatesDir);
+    }
+
+    index.upToDate = true;
+}
+
+void TemplateManager::directoryChanged(const QString &path)
+{
+    auto it = mTemplateIndexes.find(mIndexedDirectories.value(path));
+    if (it != mTemplateIndexes.end())
+        it->upToDate = false;
 }
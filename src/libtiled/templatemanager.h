@@ -25,9 +25,11 @@
 
 #include <QHash>
 #include <QObject>
+#include <QStringList>
 
 namespace Tiled {
 
+class FileSystemWatcher;
 class ObjectTemplate;
 
 class TILEDSHARED_EXPORT TemplateManager : public QObject
@@ -44,6 +46,8 @@ public:
 
 	void allTemplatesChanged();
 
+    QString templateFileName(const QString &templatesDir, const QString &name);
+
 signals:
     /**
      * Template has changed and instances need an update.
@@ -55,13 +59,31 @@ signals:
      */
     void objectTemplateChanged(ObjectTemplate *objectTemplate);
 
+private slots:
+    void directoryChanged(const QString &path);
+
 private:
     Q_DISABLE_COPY(TemplateManager)
 
     TemplateManager(QObject *parent = nullptr);
     ~TemplateManager();
 
+    /**
+     * The templates found in a directory and its subdirectories, by name.
+     */
+    struct TemplateIndex
+    {
+        QHash<QString, QString> fileNames;
+        QStringList directories;
+        bool upToDate = false;
+    };
+
+    void updateIndex(const QString &templatesDir, TemplateIndex &index);
+
     QHash<QString, ObjectTemplate*> mObjectTemplates;
+    QHash<QString, TemplateIndex> mTemplateIndexes;
+    QHash<QString, QString> mIndexedDirectories;
+    FileSystemWatcher *mWatcher;
 
     static TemplateManager *mInstance;
 };
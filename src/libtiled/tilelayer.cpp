@@ -31,6 +31,7 @@
 
 #include "tile.h"
 #include "hex.h"
+#include "qtcompat_p.h"
 
 #include <algorithm>
 #include <memory>
@@ -63,25 +64,40 @@ void Chunk::setCell(int x, int y, const Cell &cell)
 {
     int index = x + y * CHUNK_SIZE;
 
-    mGrid[index] = cell;
+    if (mCells.isEmpty()) {
+        quint32 packed;
+        if (pack(cell, packed)) {
+            mPacked[index] = packed;
+            return;
+        }
+
+        unpackAll();
+    }
+
+    mCells[index] = cell;
 }
 
 bool Chunk::isEmpty() const
 {
-    for (int y = 0; y < CHUNK_SIZE; ++y) {
-        for (int x = 0; x < CHUNK_SIZE; ++x) {
-            if (!cellAt(x, y).isEmpty())
+    if (mCells.isEmpty()) {
+        for (quint32 packed : mPacked)
+            if (paletteIndex(packed) != 0)
                 return false;
-        }
+
+        return true;
     }
 
+    for (const Cell &cell : mCells)
+        if (!cell.isEmpty())
+            return false;
+
     return true;
 }
 
 bool Chunk::hasCell(std::function<bool (const Cell &)> condition) const
 {
-    for (const Cell &cell : mGrid)
-        if (condition(cell))
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; ++i)
+        if (condition(cellAtIndex(i)))
             return true;
 
     return false;
@@ -89,20 +105,136 @@ bool Chunk::hasCell(std::function<bool (const Cell &)> condition) const
 
 void Chunk::removeReferencesToTileset(Tileset *tileset)
 {
-    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
-        if (mGrid.at(i).tileset() == tileset)
-            mGrid.replace(i, Cell());
+    if (mCells.isEmpty()) {
+        const int index = mPalette.indexOf(tileset);
+        if (index == -1)
+            return;
+
+        for (quint32 &packed : mPacked)
+            if (paletteIndex(packed) == index + 1)
+                packed = 0;
+
+        mPalette[index] = nullptr;
+        return;
+    }
+
+    for (int i = 0, i_end = mCells.size(); i < i_end; ++i) {
+        if (mCells.at(i).tileset() == tileset)
+            mCells.replace(i, Cell());
     }
 }
 
 void Chunk::replaceReferencesToTileset(Tileset *oldTileset, Tileset *newTileset)
 {
-    for (Cell &cell : mGrid) {
+    if (mCells.isEmpty()) {
+        const int oldIndex = mPalette.indexOf(oldTileset);
+        if (oldIndex == -1)
+            return;
+
+        const int newIndex = mPalette.indexOf(newTileset);
+        if (newIndex == -1) {
+            mPalette[oldIndex] = newTileset;
+            return;
+        }
+
+        // Both are in the palette, point the cells at the existing entry
+        for (quint32 &packed : mPacked) {
+            if (paletteIndex(packed) == oldIndex + 1) {
+                packed &= ~(quint32(PaletteMask) << FlagBits);
+                packed |= quint32(newIndex + 1) << FlagBits;
+            }
+        }
+        mPalette[oldIndex] = nullptr;
+        return;
+    }
+
+    for (Cell &cell : mCells) {
         if (cell.tileset() == oldTileset)
             cell.setTile(newTileset, cell.tileId());
     }
 }
 
+/**
+ * Packs \a cell, adding its tileset to the palette when needed. Returns
+ * false when the cell can't be packed.
+ */
+bool Chunk::pack(const Cell &cell, quint32 &packed)
+{
+    if (cell._flags & ~FlagMask)
+        return false;
+
+    if (!cell._tileset) {
+        if (cell._tileId != -1)
+            return false;
+
+        packed = quint32(cell._flags);
+        return true;
+    }
+
+    if (cell._tileId < 0 || cell._tileId > MaxPackedTileId)
+        return false;
+
+    int index = mPalette.indexOf(cell._tileset);
+    if (index == -1) {
+        if (mPalette.size() == MaxPaletteSize) {
+            compactPalette();
+            if (mPalette.size() == MaxPaletteSize)
+                return false;
+        }
+
+        mPalette.append(cell._tileset);
+        index = mPalette.size() - 1;
+    }
+
+    packed = quint32(cell._flags)
+            | quint32(index + 1) << FlagBits
+            | quint32(cell._tileId) << TileIdShift;
+    return true;
+}
+
+/**
+ * Drops the palette entries that are no longer used by any cell.
+ */
+void Chunk::compactPalette()
+{
+    QVector<int> remap(mPalette.size() + 1, 0);
+    for (quint32 packed : qAsConst(mPacked))
+        remap[paletteIndex(packed)] = 1;
+
+    QVector<Tileset*> palette;
+    for (int i = 1; i < remap.size(); ++i) {
+        if (remap.at(i) && mPalette.at(i - 1)) {
+            palette.append(mPalette.at(i - 1));
+            remap[i] = palette.size();
+        } else {
+            remap[i] = 0;
+        }
+    }
+
+    for (quint32 &packed : mPacked) {
+        const int index = paletteIndex(packed);
+        if (index != 0) {
+            packed &= ~(quint32(PaletteMask) << FlagBits);
+            packed |= quint32(remap.at(index)) << FlagBits;
+        }
+    }
+
+    mPalette.swap(palette);
+}
+
+/**
+ * Switches to storing full cells, for when a cell can't be packed.
+ */
+void Chunk::unpackAll()
+{
+    mCells.resize(CHUNK_SIZE * CHUNK_SIZE);
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; ++i)
+        mCells[i] = unpack(mPacked.at(i));
+
+    mPacked = QVector<quint32>();
+    mPalette = QVector<Tileset*>();
+}
+
 TileLayer::TileLayer(const QString &name, int x, int y, int width, int height)
     : Layer(TileLayerType, name, x, y)
     , mWidth(width)
@@ -207,6 +339,65 @@ void Tiled::TileLayer::setCell(int x, int y, const Cell &cell)
     _chunk.setCell(x & CHUNK_MASK, y & CHUNK_MASK, cell);
 }
 
+/**
+ * Sets \a count cells in a row, starting at the given coordinates. This is
+ * equivalent to calling setCell() for each of them, but looks up each chunk
+ * only once.
+ */
+void TileLayer::setCellRow(int x, int y, const Cell *cells, int count)
+{
+    Tileset *lastInserted = nullptr;
+
+    while (count > 0) {
+        const int chunkX = x & CHUNK_MASK;
+        const int chunkY = y & CHUNK_MASK;
+        const int span = qMin(count, CHUNK_SIZE - chunkX);
+
+        const bool newChunk = !findChunk(x, y);
+        if (newChunk) {
+            const bool allEmpty = std::all_of(cells, cells + span, [this] (const Cell &cell) {
+                return cell == mEmptyCell && !cell.checked();
+            });
+
+            if (allEmpty) {
+                x += span;
+                cells += span;
+                count -= span;
+                continue;
+            }
+
+            mBounds = mBounds.united(QRect(x - chunkX, y - chunkY,
+                                           CHUNK_SIZE, CHUNK_SIZE));
+        }
+
+        Chunk &_chunk = chunk(x, y);
+
+        for (int i = 0; i < span; ++i) {
+            const Cell &cell = cells[i];
+
+            if (!mUsedTilesetsDirty) {
+                Tileset *oldTileset = newChunk ? nullptr
+                                               : _chunk.cellAt(chunkX + i, chunkY).tileset();
+                Tileset *newTileset = cell.tileset();
+                if (oldTileset != newTileset) {
+                    if (oldTileset) {
+                        mUsedTilesetsDirty = true;
+                    } else if (newTileset && newTileset != lastInserted) {
+                        mUsedTilesets.insert(newTileset->sharedPointer());
+                        lastInserted = newTileset;
+                    }
+                }
+            }
+
+            _chunk.setCell(chunkX + i, chunkY, cell);
+        }
+
+        x += span;
+        cells += span;
+        count -= span;
+    }
+}
+
 TileLayer *TileLayer::copy(const QRegion &region) const
 {
     const QRect regionBounds = region.boundingRect();
@@ -232,6 +423,62 @@ TileLayer *TileLayer::copy(const QRegion &region) const
     return copied;
 }
 
+/**
+ * Returns a copy of the chunks overlapping the given \a region. Since chunks
+ * are implicitly shared, no cells are copied until either layer changes. The
+ * caller is responsible for the returned tile layer.
+ *
+ * The returned layer covers all chunks overlapping the region. Its position
+ * is the top-left of the first of those chunks, in local coordinates.
+ */
+TileLayer *TileLayer::copyChunks(const QRegion &region) const
+{
+    const QRect regionBounds = region.boundingRect();
+    const QPoint topLeft(regionBounds.left() & ~CHUNK_MASK,
+                         regionBounds.top() & ~CHUNK_MASK);
+    const QPoint bottomRight(regionBounds.right() | CHUNK_MASK,
+                             regionBounds.bottom() | CHUNK_MASK);
+
+    if (regionBounds.isEmpty())
+        return new TileLayer(QString(), 0, 0, 0, 0);
+
+    TileLayer *copied = new TileLayer(QString(), topLeft,
+                                      QRect(topLeft, bottomRight).size());
+    copied->mUsedTilesetsDirty = true;
+
+    const QPoint chunkOffset(topLeft.x() / CHUNK_SIZE,
+                             topLeft.y() / CHUNK_SIZE);
+
+#if QT_VERSION < 0x050800
+    const auto rects = region.rects();
+    for (const QRect &rect : rects) {
+#else
+    for (const QRect &rect : region) {
+#endif
+        const int startX = (rect.left() & ~CHUNK_MASK) / CHUNK_SIZE;
+        const int startY = (rect.top() & ~CHUNK_MASK) / CHUNK_SIZE;
+        const int endX = (rect.right() & ~CHUNK_MASK) / CHUNK_SIZE;
+        const int endY = (rect.bottom() & ~CHUNK_MASK) / CHUNK_SIZE;
+
+        for (int chunkY = startY; chunkY <= endY; ++chunkY) {
+            for (int chunkX = startX; chunkX <= endX; ++chunkX) {
+                auto it = mChunks.find(QPoint(chunkX, chunkY));
+                if (it == mChunks.end())
+                    continue;
+
+                const QPoint key = it.key() - chunkOffset;
+                copied->mChunks.insert(key, it.value());
+                copied->mBounds = copied->mBounds.united(QRect(key.x() * CHUNK_SIZE,
+                                                               key.y() * CHUNK_SIZE,
+                                                               CHUNK_SIZE,
+                                                               CHUNK_SIZE));
+            }
+        }
+    }
+
+    return copied;
+}
+
 void TileLayer::merge(const QPoint &pos, const TileLayer *layer)
 {
     // Determine the overlapping area
@@ -548,8 +795,8 @@ QSet<SharedTileset> TileLayer::usedTilesets() const
         QSet<SharedTileset> tilesets;
 
         for (const Chunk &chunk : mChunks) {
-            for (const Cell &cell : chunk)
-                if (const Tile *tile = cell.tile())
+            for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; ++i)
+                if (const Tile *tile = chunk.cellAtIndex(i).tile())
                     tilesets.insert(tile->sharedTileset());
         }
 
@@ -598,6 +845,36 @@ void TileLayer::resize(const QSize &size, const QPoint &offset)
     if (this->size() == size && offset.isNull())
         return;
 
+    // When the chunks stay aligned to the layer, they can be moved as a whole
+    if (((offset.x() | offset.y() | size.width() | size.height()) & CHUNK_MASK) == 0) {
+        const QPoint chunkOffset(offset.x() / CHUNK_SIZE, offset.y() / CHUNK_SIZE);
+        const QRect chunkArea(0, 0, size.width() / CHUNK_SIZE, size.height() / CHUNK_SIZE);
+
+        QHash<QPoint, Chunk> chunks;
+        QRect bounds;
+
+        QHashIterator<QPoint, Chunk> it(mChunks);
+        while (it.hasNext()) {
+            it.next();
+
+            const QPoint key = it.key() + chunkOffset;
+            if (!chunkArea.contains(key))
+                continue;
+
+            chunks.insert(key, it.value());
+            bounds = bounds.united(QRect(key.x() * CHUNK_SIZE,
+                                         key.y() * CHUNK_SIZE,
+                                         CHUNK_SIZE,
+                                         CHUNK_SIZE));
+        }
+
+        mChunks = chunks;
+        mBounds = bounds;
+        mUsedTilesetsDirty = true;
+        setSize(size);
+        return;
+    }
+
     const std::unique_ptr<TileLayer> newLayer(new TileLayer(QString(), 0, 0, size.width(), size.height()));
 
     // Copy over the preserved part
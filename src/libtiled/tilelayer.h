@@ -110,6 +110,14 @@ public:
     bool refersTile(const Tile *tile) const;
 
 private:
+    friend class Chunk;
+
+    Cell(Tileset *tileset, int tileId, int flags) :
+        _tileset(tileset),
+        _tileId(tileId),
+        _flags(flags)
+    {}
+
     enum Flags {
         FlippedHorizontally     = 0x01,
         FlippedVertically       = 0x02,
@@ -151,18 +159,27 @@ inline bool Cell::refersTile(const Tile *tile) const
 
 /**
  * A Chunk is a grid of cells of size CHUNK_SIZExCHUNK_SIZE.
+ *
+ * The cells are stored packed into 32 bits each, referring to their tileset
+ * through a small palette kept by the chunk. A chunk whose cells don't fit,
+ * because it uses too many tilesets or very high tile IDs, falls back to
+ * storing full cells.
+ *
+ * Chunks are implicitly shared: copying a chunk doesn't copy its cells until
+ * one of the copies is changed.
  */
 class TILEDSHARED_EXPORT Chunk
 {
 public:
     Chunk() :
-        mGrid(CHUNK_SIZE * CHUNK_SIZE)
+        mPacked(CHUNK_SIZE * CHUNK_SIZE, 0u)
     {}
 
     QRegion region(std::function<bool (const Cell &)> condition) const;
 
-    const Cell &cellAt(int x, int y) const;
-    const Cell &cellAt(const QPoint &point) const;
+    Cell cellAt(int x, int y) const;
+    Cell cellAt(const QPoint &point) const;
+    Cell cellAtIndex(int index) const;
 
     void setCell(int x, int y, const Cell &cell);
 
@@ -174,21 +191,53 @@ public:
 
     void replaceReferencesToTileset(Tileset *oldTileset, Tileset *newTileset);
 
-    QVector<Cell>::iterator begin() { return mGrid.begin(); }
-    QVector<Cell>::iterator end() { return mGrid.end(); }
-    QVector<Cell>::const_iterator begin() const { return mGrid.begin(); }
-    QVector<Cell>::const_iterator end() const { return mGrid.end(); }
+    bool isPacked() const { return mCells.isEmpty(); }
 
 private:
-    QVector<Cell> mGrid;
+    enum {
+        FlagBits        = 5,
+        PaletteBits     = 5,
+        TileIdShift     = FlagBits + PaletteBits,
+        FlagMask        = (1 << FlagBits) - 1,
+        PaletteMask     = (1 << PaletteBits) - 1,
+        MaxPaletteSize  = PaletteMask,      // palette index 0 means no tileset
+        MaxPackedTileId = (1 << (32 - TileIdShift)) - 1
+    };
+
+    static int paletteIndex(quint32 packed) { return (packed >> FlagBits) & PaletteMask; }
+
+    Cell unpack(quint32 packed) const;
+    bool pack(const Cell &cell, quint32 &packed);
+    void compactPalette();
+    void unpackAll();
+
+    QVector<quint32> mPacked;
+    QVector<Tileset*> mPalette;
+    QVector<Cell> mCells;       // only used when the cells couldn't be packed
 };
 
-inline const Cell &Chunk::cellAt(int x, int y) const
+inline Cell Chunk::unpack(quint32 packed) const
 {
-    return mGrid.at(x + y * CHUNK_SIZE);
+    const int index = paletteIndex(packed);
+    const int flags = packed & FlagMask;
+
+    if (index == 0)
+        return Cell(nullptr, -1, flags);
+
+    return Cell(mPalette.at(index - 1), int(packed >> TileIdShift), flags);
 }
 
-inline const Cell &Chunk::cellAt(const QPoint &point) const
+inline Cell Chunk::cellAtIndex(int index) const
+{
+    return mCells.isEmpty() ? unpack(mPacked.at(index)) : mCells.at(index);
+}
+
+inline Cell Chunk::cellAt(int x, int y) const
+{
+    return cellAtIndex(x + y * CHUNK_SIZE);
+}
+
+inline Cell Chunk::cellAt(const QPoint &point) const
 {
     return cellAt(point.x(), point.y());
 }
@@ -203,71 +252,18 @@ inline const Cell &Chunk::cellAt(const QPoint &point) const
 class TILEDSHARED_EXPORT TileLayer : public Layer
 {
 public:
-    class iterator
-    {
-    public:
-        iterator(QHash<QPoint, Chunk>::iterator it, QHash<QPoint, Chunk>::iterator end)
-            : mChunkPointer(it)
-            , mChunkEndPointer(end)
-        {
-            if (it != end)
-                mCellPointer = it.value().begin();
-        }
-
-        iterator operator++(int)
-        {
-            iterator it = *this;
-            advance();
-            return it;
-        }
-
-        iterator &operator++()
-        {
-            advance();
-            return *this;
-        }
-
-        Cell &operator*() { return *mCellPointer; }
-
-        QVector<Cell>::iterator operator->() const { return mCellPointer; }
-
-        friend bool operator==(const iterator& lhs, const iterator& rhs)
-        {
-            if (lhs.mChunkPointer == lhs.mChunkEndPointer || rhs.mChunkPointer == rhs.mChunkEndPointer)
-                return lhs.mChunkPointer == rhs.mChunkPointer;
-            else
-                return lhs.mCellPointer == rhs.mCellPointer;
-        }
-
-        friend bool operator!=(const iterator& lhs, const iterator& rhs)
-        {
-            if (lhs.mChunkPointer == lhs.mChunkEndPointer || rhs.mChunkPointer == rhs.mChunkEndPointer)
-                return lhs.mChunkPointer != rhs.mChunkPointer;
-            else
-                return lhs.mCellPointer != rhs.mCellPointer;
-        }
-
-        Cell &value() const { return *mCellPointer; }
-
-        QPoint key() const;
-
-    private:
-        void advance();
-
-        QHash<QPoint, Chunk>::iterator mChunkPointer;
-        QHash<QPoint, Chunk>::iterator mChunkEndPointer;
-        QVector<Cell>::iterator mCellPointer;
-    };
-
+    /**
+     * Iterates over the cells of all chunks. Since cells are stored packed,
+     * they are returned by value.
+     */
     class const_iterator
     {
     public:
         const_iterator(QHash<QPoint, Chunk>::const_iterator it, QHash<QPoint, Chunk>::const_iterator end)
             : mChunkPointer(it)
             , mChunkEndPointer(end)
+            , mCellIndex(0)
         {
-            if (it != end)
-                mCellPointer = it.value().begin();
         }
 
         const_iterator operator++(int)
@@ -283,27 +279,22 @@ public:
             return *this;
         }
 
-        const Cell &operator*() { return *mCellPointer; }
-
-        QVector<Cell>::const_iterator operator->() const { return mCellPointer; }
+        Cell operator*() const { return value(); }
 
         friend bool operator==(const const_iterator& lhs, const const_iterator& rhs)
         {
             if (lhs.mChunkPointer == lhs.mChunkEndPointer || rhs.mChunkPointer == rhs.mChunkEndPointer)
                 return lhs.mChunkPointer == rhs.mChunkPointer;
             else
-                return lhs.mCellPointer == rhs.mCellPointer;
+                return lhs.mChunkPointer == rhs.mChunkPointer && lhs.mCellIndex == rhs.mCellIndex;
         }
 
         friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs)
         {
-            if (lhs.mChunkPointer == lhs.mChunkEndPointer || rhs.mChunkPointer == rhs.mChunkEndPointer)
-                return lhs.mChunkPointer != rhs.mChunkPointer;
-            else
-                return lhs.mCellPointer != rhs.mCellPointer;
+            return !(lhs == rhs);
         }
 
-        const Cell &value() const { return *mCellPointer; }
+        Cell value() const { return mChunkPointer.value().cellAtIndex(mCellIndex); }
 
         QPoint key() const;
 
@@ -312,9 +303,11 @@ public:
 
         QHash<QPoint, Chunk>::const_iterator mChunkPointer;
         QHash<QPoint, Chunk>::const_iterator mChunkEndPointer;
-        QVector<Cell>::const_iterator mCellPointer;
+        int mCellIndex;
     };
 
+    typedef const_iterator iterator;
+
     /**
      * Constructor.
      */
@@ -358,11 +351,13 @@ public:
     QRegion region(std::function<bool (const Cell &)> condition) const;
     QRegion region() const;
 
-    const Cell &cellAt(int x, int y) const;
-    const Cell &cellAt(const QPoint &point) const;
+    Cell cellAt(int x, int y) const;
+    Cell cellAt(const QPoint &point) const;
 
     void setCell(int x, int y, const Cell &cell);
 
+    void setCellRow(int x, int y, const Cell *cells, int count);
+
     /**
      * Returns a copy of the area specified by the given \a region. The
      * caller is responsible for the returned tile layer.
@@ -372,6 +367,8 @@ public:
     TileLayer *copy(int x, int y, int width, int height) const
     { return copy(QRegion(x, y, width, height)); }
 
+    TileLayer *copyChunks(const QRegion &region) const;
+
     /**
      * Merges the given \a layer onto this layer at position \a pos. Parts that
      * fall outside of this layer will be lost and empty tiles in the given
@@ -493,10 +490,8 @@ public:
 
     TileLayer *clone() const override;
 
-    iterator begin() { return iterator(mChunks.begin(), mChunks.end()); }
-    iterator end() { return iterator(mChunks.end(), mChunks.end()); }
-    const_iterator begin() const { return const_iterator(mChunks.begin(), mChunks.end()); }
-    const_iterator end() const { return const_iterator(mChunks.end(), mChunks.end()); }
+    const_iterator begin() const { return const_iterator(mChunks.constBegin(), mChunks.constEnd()); }
+    const_iterator end() const { return const_iterator(mChunks.constEnd(), mChunks.constEnd()); }
 
     QVector<QRect> sortedChunksToWrite() const;
 
@@ -513,33 +508,11 @@ private:
     mutable bool mUsedTilesetsDirty;
 };
 
-inline QPoint TileLayer::iterator::key() const
-{
-    QPoint chunkStart = mChunkPointer.key();
-
-    int index = mCellPointer - mChunkPointer.value().begin();
-    chunkStart += QPoint(index & CHUNK_MASK, index / CHUNK_SIZE);
-
-    return chunkStart;
-}
-
-inline void TileLayer::iterator::advance()
-{
-    if (mChunkPointer != mChunkEndPointer) {
-        if (++mCellPointer == mChunkPointer.value().end()) {
-            mChunkPointer++;
-            if (mChunkPointer != mChunkEndPointer)
-                mCellPointer = mChunkPointer.value().begin();
-        }
-    }
-}
-
 inline QPoint TileLayer::const_iterator::key() const
 {
     QPoint chunkStart = mChunkPointer.key();
 
-    int index = mCellPointer - mChunkPointer.value().begin();
-    chunkStart += QPoint(index & CHUNK_MASK, index / CHUNK_SIZE);
+    chunkStart += QPoint(mCellIndex & CHUNK_MASK, mCellIndex / CHUNK_SIZE);
 
     return chunkStart;
 }
@@ -547,10 +520,9 @@ inline QPoint TileLayer::const_iterator::key() const
 inline void TileLayer::const_iterator::advance()
 {
     if (mChunkPointer != mChunkEndPointer) {
-        if (++mCellPointer == mChunkPointer.value().end()) {
+        if (++mCellIndex == CHUNK_SIZE * CHUNK_SIZE) {
             mChunkPointer++;
-            if (mChunkPointer != mChunkEndPointer)
-                mCellPointer = mChunkPointer.value().begin();
+            mCellIndex = 0;
         }
     }
 }
@@ -599,10 +571,10 @@ inline QRegion TileLayer::region() const
 }
 
 /**
- * Returns a read-only reference to the cell at the given coordinates. The
- * coordinates have to be within this layer.
+ * Returns the cell at the given coordinates. The coordinates have to be
+ * within this layer.
  */
-inline const Cell &TileLayer::cellAt(int x, int y) const
+inline Cell TileLayer::cellAt(int x, int y) const
 {
     if (const Chunk *chunk = findChunk(x, y))
         return chunk->cellAt(x & CHUNK_MASK, y & CHUNK_MASK);
@@ -610,11 +582,67 @@ inline const Cell &TileLayer::cellAt(int x, int y) const
         return mEmptyCell;
 }
 
-inline const Cell &TileLayer::cellAt(const QPoint &point) const
+inline Cell TileLayer::cellAt(const QPoint &point) const
 {
     return cellAt(point.x(), point.y());
 }
 
+/**
+ * Looks up the cells of a tile layer while remembering the chunk of the last
+ * lookup, including when there was no chunk at all. Renderers look up
+ * neighbouring cells one after the other, which mostly lie in the same
+ * chunk, so this saves the chunk lookup for most cells.
+ */
+class CellLookup
+{
+public:
+    explicit CellLookup(const TileLayer &layer)
+        : mLayer(layer)
+        , mChunk(nullptr)
+        , mChunkX(0)
+        , mChunkY(0)
+        , mValid(false)
+    {}
+
+    /**
+     * Returns the chunk that contains the cell at the given coordinates, or
+     * null when that part of the layer has no chunk.
+     */
+    const Chunk *chunkAt(int x, int y)
+    {
+        const int chunkX = x < 0 ? (x + 1) / CHUNK_SIZE - 1 : x / CHUNK_SIZE;
+        const int chunkY = y < 0 ? (y + 1) / CHUNK_SIZE - 1 : y / CHUNK_SIZE;
+
+        if (!mValid || chunkX != mChunkX || chunkY != mChunkY) {
+            mChunk = mLayer.findChunk(x, y);
+            mChunkX = chunkX;
+            mChunkY = chunkY;
+            mValid = true;
+        }
+
+        return mChunk;
+    }
+
+    Cell cellAt(int x, int y)
+    {
+        if (const Chunk *chunk = chunkAt(x, y))
+            return chunk->cellAt(x & CHUNK_MASK, y & CHUNK_MASK);
+        return Cell();
+    }
+
+    Cell cellAt(const QPoint &point)
+    {
+        return cellAt(point.x(), point.y());
+    }
+
+private:
+    const TileLayer &mLayer;
+    const Chunk *mChunk;
+    int mChunkX;
+    int mChunkY;
+    bool mValid;
+};
+
 typedef QSharedPointer<TileLayer> SharedTileLayer;
 
 } // namespace Tiled
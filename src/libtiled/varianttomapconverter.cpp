@@ -21,6 +21,7 @@
 
 #include "varianttomapconverter.h"
 
+#include "compression.h"
 #include "grouplayer.h"
 #include "imagelayer.h"
 #include "map.h"
@@ -91,6 +92,11 @@ Map *VariantToMapConverter::toMap(const QVariant &variant,
     if (nextObjectId)
         map->setNextObjectId(nextObjectId);
 
+    bool compressionLevelOk;
+    const int compressionLevel = variantMap[QLatin1String("compressionlevel")].toInt(&compressionLevelOk);
+    if (compressionLevelOk)
+        map->setCompressionLevel(compressionLevel);
+
     mMap = map.get();
     map->setProperties(extractProperties(variantMap));
 
@@ -531,6 +537,8 @@ TileLayer *VariantToMapConverter::toTileLayer(const QVariantMap &variantMap)
             layerDataFormat = Map::Base64Gzip;
         } else if (compression == QLatin1String("zlib")) {
             layerDataFormat = Map::Base64Zlib;
+        } else if (compression == QLatin1String("zstd") && compressionSupported(Zstandard)) {
+            layerDataFormat = Map::Base64Zstandard;
         } else {
             mError = tr("Compression method '%1' not supported").arg(compression);
             return nullptr;
@@ -843,7 +851,8 @@ bool VariantToMapConverter::readTileLayerData(TileLayer &tileLayer,
 
     case Map::Base64:
     case Map::Base64Zlib:
-    case Map::Base64Gzip: {
+    case Map::Base64Gzip:
+    case Map::Base64Zstandard: {
         const QByteArray data = dataVariant.toByteArray();
         GidMapper::DecodeError error = mGidMapper.decodeLayerData(tileLayer,
                                                                   data,
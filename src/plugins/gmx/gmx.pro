@@ -2,7 +2,11 @@ include(../plugin.pri)
 
 DEFINES += GMX_LIBRARY
 
-SOURCES += gmxplugin.cpp
+SOURCES += gmxplugin.cpp \
+    gmxreader.cpp \
+    tilecombiner.cpp
 HEADERS += gmxplugin.h \
-    gmx_global.h
+    gmxreader.h \
+    gmx_global.h \
+    tilecombiner.h
 	
\ No newline at end of file
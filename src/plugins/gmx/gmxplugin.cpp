@@ -34,6 +34,7 @@
 #include <QDir>
 #include <QBuffer>
 #include <QFileInfo>
+#include <QHash>
 #include <QDirIterator>
 #include "layer.h"
 
@@ -44,6 +45,7 @@
 #include <iomanip>
 #include "qtcompat_p.h"
 #include <vector>
+#include <algorithm>
 #include <QTextCodec>
 #include <QTextDocument>
 #include "rapidxml.hpp"
@@ -59,6 +61,8 @@
 
 #include "roomimporterdialog.h"
 #include "bgximporterdialog.h"
+#include "gmxreader.h"
+#include "tilecombiner.h"
 
 using namespace Tiled;
 using namespace Gmx;
@@ -248,103 +252,138 @@ GmxPlugin::GmxPlugin(QObject *parent)
 {
 }
 
-void GmxPlugin::mapTemplates(std::unordered_map<std::string,std::string> *map, QDir &root )
+struct TileLayerKey
 {
-    QFileInfoList fileInfoList = root.entryInfoList();
+	int depth;
+	int xOffset;
+	int yOffset;
 
-    QDirIterator it(root.path(), QStringList() << "*.tx", QDir::Files, QDirIterator::Subdirectories);
-    while (it.hasNext())
-    {
-		it.next();
-		QFileInfo info = it.fileInfo();
-        if(info.isFile())
-        {
-            map->emplace(make_pair(info.baseName().toStdString(),info.absoluteFilePath().toStdString()));
-        }
+	bool operator==(const TileLayerKey &other) const
+	{
+		return depth == other.depth && xOffset == other.xOffset && yOffset == other.yOffset;
+	}
+};
 
-    }
+static inline uint qHash(const TileLayerKey &key, uint seed = 0) Q_DECL_NOTHROW
+{
+	return qHash(QPoint(key.xOffset, key.yOffset), seed) ^ qHash(key.depth, seed);
 }
 
-
-static TileLayer* tileLayerAtDepth(QVector<TileLayer*> &layers, int depth,int xo, int yo, Map *map)
+/**
+ * Keeps track of the tile layers and tilesets created while importing the
+ * tiles of a room, so each tile only needs a couple of hash lookups.
+ */
+class RoomImportContext
 {
-    if(layers.isEmpty())
-    {
-        TileLayer* newLayer = new TileLayer(QString::number(depth).append(QString("_0")),0,0,map->width(),map->height());
-        newLayer->setOffset(QPointF(xo,yo));
-        newLayer->setProperty(QString("depth"),QVariant(depth));
-        layers.append(newLayer);
-        map->addLayer(newLayer);
-        return newLayer;
-    }
-    else
-    {
-        for(TileLayer* tileLayer : layers)
-        {
-            QVariant lDepth = tileLayer->inheritedProperty(QString("depth"));
-            if(lDepth.isValid())
-            {
-                int layerDepth = lDepth.toInt();
-                if(layerDepth==depth && xo == tileLayer->offset().x() && yo == tileLayer->offset().y())
-                {
-                    return tileLayer;
-                }
-            }
-        }
+public:
+	RoomImportContext(Map *map, const QDir &imageDir)
+		: mMap(map)
+		, mImageDir(imageDir)
+	{}
+
+	TileLayer *tileLayerAtDepth(int depth, int xo, int yo);
+	SharedTileset tilesetWithName(const QString &bgName);
+
+private:
+	Map *mMap;
+	QDir mImageDir;
+	QHash<TileLayerKey, TileLayer*> mTileLayers;
+	QHash<QString, SharedTileset> mTilesets;	//Also remembers missing images
+};
 
-        TileLayer* newLayer = new TileLayer(QString::number(depth).append(QString("_")).append(QString::number(layers.size())),0,0,map->width(),map->height());
-        newLayer->setOffset(QPointF(xo,yo));
-        newLayer->setProperty(QString("depth"),QVariant(depth));
-        layers.append(newLayer);
-        map->addLayer(newLayer);
-        return newLayer;
-    }
+TileLayer *RoomImportContext::tileLayerAtDepth(int depth, int xo, int yo)
+{
+	const TileLayerKey key = { depth, xo, yo };
+	auto it = mTileLayers.constFind(key);
+	if(it != mTileLayers.constEnd())
+		return it.value();
+
+	QString name = QString::number(depth) + QLatin1Char('_') + QString::number(mTileLayers.size());
+	TileLayer* newLayer = new TileLayer(name,0,0,mMap->width(),mMap->height());
+	newLayer->setOffset(QPointF(xo,yo));
+	newLayer->setProperty(QString("depth"),QVariant(depth));
+	mMap->addLayer(newLayer);
+	mTileLayers.insert(key, newLayer);
+	return newLayer;
 }
 
-static SharedTileset tilesetWithName(const QString &bgName, Map *map, QDir &imageDir)
-{	
-	QString imgPath = imageDir.absoluteFilePath(bgName + (".png"));
-	QDir imgDir = QDir(imageDir.path());
-	imgDir.cdUp();
+SharedTileset RoomImportContext::tilesetWithName(const QString &bgName)
+{
+	auto it = mTilesets.constFind(bgName);
+	if(it != mTilesets.constEnd())
+		return it.value();
 
-	SharedTileset tst = TilesetManager::instance()->findTilesetAbsoluteWithSize(imgPath, map->tileSize());
+	QString imgPath = mImageDir.absoluteFilePath(bgName + (".png"));
 
-	if(!tst.isNull())
+	SharedTileset tst = TilesetManager::instance()->findTilesetAbsoluteWithSize(imgPath, mMap->tileSize());
+
+	if(tst.isNull())
 	{
-		map->addTileset(tst);
-		return tst;
+		SharedTileset newTileset = Tileset::create(bgName,mMap->tileWidth(),mMap->tileHeight(),0,0);
+
+		if(newTileset->loadFromImage(imgPath))
+		{
+			newTileset->setFileName(imgPath);
+			tst = newTileset;
+		}
 	}
 
-	QString fname = QString(bgName);
+	if(!tst.isNull())
+		mMap->addTileset(tst);
 
-	SharedTileset newTileset = Tileset::create(fname,map->tileWidth(),map->tileHeight(),0,0);
+	mTilesets.insert(bgName, tst);
+	return tst;
+}
 
-	if(newTileset->loadFromImage(imgPath))
-    {
+/**
+ * A layer along with the depth at which GameMaker draws it.
+ */
+template<typename LayerPtr>
+struct LayerDepth
+{
+	LayerPtr layer;
+	int depth;
+	bool hasDepth;  // whether the depth came from the "depth" property
+	int index;      // original position, to keep the sort stable
+};
 
-		newTileset->setFileName(imgPath);
-		map->addTileset(newTileset);
+/**
+ * Returns \a layers sorted by depth in descending order, which is the order
+ * in which GameMaker draws them. Layers at the same depth keep their order.
+ *
+ * The "depth" property of each layer is looked up only once. Layers without
+ * a depth are sorted as if at \a defaultDepth, or at \a defaultTileLayerDepth
+ * for tile layers.
+ */
+template<typename LayerPtr, typename Container>
+static std::vector<LayerDepth<LayerPtr>> sortedByDepth(const Container &layers,
+													  int defaultDepth,
+													  int defaultTileLayerDepth)
+{
+	static const QString depthName = QStringLiteral("depth");
 
-		return newTileset;
-    }
+	std::vector<LayerDepth<LayerPtr>> sorted;
+	sorted.reserve(layers.size());
 
-	return SharedTileset();
+	for (LayerPtr layer : layers) {
+		const QVariant depthProperty = layer->property(depthName);
 
-}
+		bool hasDepth = false;
+		int depth = depthProperty.isValid() ? depthProperty.toInt(&hasDepth) : 0;
+		if (!hasDepth)
+			depth = layer->isTileLayer() ? defaultTileLayerDepth : defaultDepth;
 
-static bool lesThanLayer(Layer *lay1, Layer *lay2)
-{
-	int depth1 = 99999990;
-    int depth2 = depth1;
+		sorted.push_back({ layer, depth, hasDepth, int(sorted.size()) });
+	}
 
-	QVariant aux = lay1->property(QStringLiteral("depth"));
-    if(aux.isValid())
-        depth1=aux.toInt();
-	aux = lay2->property(QStringLiteral("depth"));
-    if(aux.isValid())
-        depth2 = aux.toInt();
+	std::sort(sorted.begin(), sorted.end(),
+			  [](const LayerDepth<LayerPtr> &a, const LayerDepth<LayerPtr> &b) {
+		if (a.depth != b.depth)
+			return a.depth > b.depth;
+		return a.index < b.index;
+	});
 
-	return depth1>depth2;
+	return sorted;
 }
 
 void GmxPlugin::writeAttribute(const QString &qualifiedName, QString &value, QIODevice* d, QTextCodec* codec)
@@ -362,8 +401,7 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
     using namespace rapidxml;
     using namespace std;
 	mError = QStringLiteral("");
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    if (!QFile::exists(fileName)) {
         mError = tr("Could not open file for reading.");
         return nullptr;
     }
@@ -376,41 +414,75 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
         QString("../Backgrounds/images"),
         QString("../Objects/templates")
     };
-    bool accepted = false;
-    RoomImporterDialog *sDialog = new RoomImporterDialog(nullptr,&accepted,&settings);
+	//Batch tools (gmxconverter) set GMSMEBatch/Headless and provide the
+	//importer settings through the same keys the dialog reads its defaults from
+	bool headless = appSettings != nullptr
+			&& appSettings->value(QStringLiteral("GMSMEBatch/Headless"), false).toBool();
+
+	if(headless)
 	{
-	//	Preferences* prefs = Preferences::instance();
-		//sDialog->setDefaultPaths(prefs->gmProjectPath(), prefs->genTemplatesOutDir());
+		QSize tileSize = appSettings->value(QStringLiteral("GMSMESizes/lastUsedMapTilesize"), QSize(16,16)).toSize();
+		QSize quadSize = appSettings->value(QStringLiteral("GMSMESizes/LastUsedQuadSize"), QSize(256,224)).toSize();
+		settings.tileWidth = tileSize.width();
+		settings.tileHeigth = tileSize.height();
+		settings.quadWidth = quadSize.width();
+		settings.quadHeigth = quadSize.height();
+
+		//Empty paths mean the option wasn't given, keep the defaults then
+		const QString imagesPath = appSettings->value(QStringLiteral("GMSMEBatch/ImagesPath")).toString();
+		const QString templatePath = appSettings->value(QStringLiteral("GMSMEBatch/TemplatesPath")).toString();
+		if(!imagesPath.isEmpty())
+			settings.imagesPath = imagesPath;
+		if(!templatePath.isEmpty())
+			settings.templatePath = templatePath;
+
+		if(settings.tileWidth <= 0 || settings.tileHeigth <= 0)
+		{
+			mError = tr("Invalid tile size");
+			return nullptr;
+		}
 	}
-	if(appSettings != nullptr)
+	else
 	{
-		sDialog->setDefaultPaths(appSettings);
+		bool accepted = false;
+		RoomImporterDialog *sDialog = new RoomImporterDialog(nullptr,&accepted,&settings);
+		if(appSettings != nullptr)
+		{
+			sDialog->setDefaultPaths(appSettings);
 
-	}
+		}
 
-    sDialog->exec();
-	delete sDialog;
+		sDialog->exec();
+		delete sDialog;
 
-    if(!accepted)
-    {
-		mError = tr("Operation cancelled");
-        return nullptr;
-    }
+		if(!accepted)
+		{
+			mError = tr("Operation cancelled");
+			return nullptr;
+		}
 
-	appSettings->setValue(QStringLiteral("GMSMESizes/lastUsedMapTilesize"), QSize(settings.tileWidth, settings.tileHeigth));
-	appSettings->setValue(QStringLiteral("GMSMESizes/LastUsedQuadSize"), QSize(settings.quadWidth, settings.quadHeigth));
+		if(appSettings != nullptr)
+		{
+			appSettings->setValue(QStringLiteral("GMSMESizes/lastUsedMapTilesize"), QSize(settings.tileWidth, settings.tileHeigth));
+			appSettings->setValue(QStringLiteral("GMSMESizes/LastUsedQuadSize"), QSize(settings.quadWidth, settings.quadHeigth));
+		}
+	}
 
 
 	qDebug()<<"Importing gmx room";
-    xml_document<> doc;
+    GmxReader reader;
     xml_node<> * root_node;
 
-    ifstream theFile(fileName.toStdString().c_str());
-    vector<char> buffer((istreambuf_iterator<char>(theFile)), istreambuf_iterator<char>());
-    buffer.push_back('\0');
-
-    doc.parse<0>(&buffer[0]);
-    root_node = doc.first_node("room");
+    if (!reader.read(fileName)) {
+        mError = reader.errorString();
+        return nullptr;
+    }
+    root_node = reader.firstNode("room");
+    if(!root_node)
+    {
+        mError = tr("Invalid room file, no room node");
+        return nullptr;
+    }
     xml_node<> *tile = root_node->first_node("tiles")->first_node("tile");
     xml_node<> *instance = root_node->first_node("instances")->first_node("instance");
 
@@ -419,20 +491,20 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
 		xml_node<> *roomSpeedNode = root_node->first_node("speed");
 		if(roomSpeedNode)
 		{
-			roomSpeed = QString(roomSpeedNode->value()).toInt();
+			roomSpeed = GmxReader::intValue(root_node, "speed");
 		}
 	}
 
-	bool enableViews = QString(root_node->first_node("enableViews")->value()) == "-1" ? true : false;
+	bool enableViews = GmxReader::boolValue(root_node, "enableViews");
     int tileWidth = settings.tileWidth;
     int tileHeight = settings.tileHeigth;
-    int mapWidth = QString(root_node->first_node("width")->value()).toInt()/tileWidth;
-    int mapHeight = QString(root_node->first_node("height")->value()).toInt()/tileHeight;
-	QColor bgColor = oleToColor(QString(root_node->first_node("colour")->value()).toInt());
-    bool useBgColor = QString(root_node->first_node("showcolour")->value()).toInt() != 0;
+    int mapWidth = GmxReader::intValue(root_node, "width")/tileWidth;
+    int mapHeight = GmxReader::intValue(root_node, "height")/tileHeight;
+	QColor bgColor = oleToColor(GmxReader::intValue(root_node, "colour"));
+    bool useBgColor = GmxReader::boolValue(root_node, "showcolour");
 
     Map *newMap = new Map(Map::Orthogonal,mapWidth,mapHeight,tileWidth,tileHeight,false);
-    newMap->setProperty("code",QVariant(root_node->first_node("code")->value()));
+    newMap->setProperty("code",GmxReader::stringValue(root_node, "code"));
     newMap->setQuadWidth(settings.quadWidth);
     newMap->setQuadHeight(settings.quadHeigth);
 	newMap->setProperty("enableViews", enableViews);
@@ -443,6 +515,7 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
 		defaultCombineTiles = appSettings->value(QStringLiteral("Interface/DefaultCombineTiles"), false).toBool();
 	}
 	newMap->setProperty("combineTilesOnExport", defaultCombineTiles);
+	newMap->setProperty("combineTilesMode", QStringLiteral("optimal"));
 
     if(useBgColor)
     {
@@ -462,17 +535,17 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
 
 		while(background)
 		{
-			bool visible = QString(background->first_attribute("visible")->value()) == "-1" ? true : false;
-			bool foreground = QString(background->first_attribute("foreground")->value()) == "-1" ? true : false;
-			bool htiled = QString(background->first_attribute("htiled")->value()) == "-1" ? true : false;
-			bool vtiled = QString(background->first_attribute("vtiled")->value()) == "-1" ? true : false;
+			bool visible = GmxReader::boolAttribute(background, "visible");
+			bool foreground = GmxReader::boolAttribute(background, "foreground");
+			bool htiled = GmxReader::boolAttribute(background, "htiled");
+			bool vtiled = GmxReader::boolAttribute(background, "vtiled");
 
-			int x = QString(background->first_attribute("x")->value()).toInt();
-			int y = QString(background->first_attribute("y")->value()).toInt();
-			qreal hspeed = QString(background->first_attribute("hspeed")->value()).toFloat();
-			qreal vspeed = QString(background->first_attribute("vspeed")->value()).toFloat();
+			int x = GmxReader::intAttribute(background, "x");
+			int y = GmxReader::intAttribute(background, "y");
+			qreal hspeed = GmxReader::doubleAttribute(background, "hspeed");
+			qreal vspeed = GmxReader::doubleAttribute(background, "vspeed");
 
-			QString name = QString(background->first_attribute("name")->value());
+			QString name = reader.internedAttribute(background, "name");
 
 			auto obj = new MapObject(QStringLiteral("BG_").append(QString::number(bgCount)), QStringLiteral("t_gmRoomBackground"),QPointF(16*bgCount,0), QSizeF(16,16));
 
@@ -497,23 +570,23 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
 		qDebug()<<"Importing views";
 		while(view)
 		{
-			bool visible = QString(view->first_attribute("visible")->value()) == "-1" ? true : false;
+			bool visible = GmxReader::boolAttribute(view, "visible");
 
-			int xview = QString(view->first_attribute("xview")->value()).toInt();
-			int yview = QString(view->first_attribute("yview")->value()).toInt();
-			int wview = QString(view->first_attribute("wview")->value()).toInt();
-			int hview = QString(view->first_attribute("hview")->value()).toInt();
+			int xview = GmxReader::intAttribute(view, "xview");
+			int yview = GmxReader::intAttribute(view, "yview");
+			int wview = GmxReader::intAttribute(view, "wview");
+			int hview = GmxReader::intAttribute(view, "hview");
 
-			int xport = QString(view->first_attribute("xport")->value()).toInt();
-			int yport = QString(view->first_attribute("yport")->value()).toInt();
-			int wport = QString(view->first_attribute("wport")->value()).toInt();
-			int hport = QString(view->first_attribute("hport")->value()).toInt();
+			int xport = GmxReader::intAttribute(view, "xport");
+			int yport = GmxReader::intAttribute(view, "yport");
+			int wport = GmxReader::intAttribute(view, "wport");
+			int hport = GmxReader::intAttribute(view, "hport");
 
-			int hborder= QString(view->first_attribute("hborder")->value()).toInt();
-			int vborder = QString(view->first_attribute("vborder")->value()).toInt();
+			int hborder= GmxReader::intAttribute(view, "hborder");
+			int vborder = GmxReader::intAttribute(view, "vborder");
 
-			qreal hspeed = QString(view->first_attribute("hspeed")->value()).toFloat();
-			qreal vspeed = QString(view->first_attribute("vspeed")->value()).toFloat();
+			qreal hspeed = GmxReader::doubleAttribute(view, "hspeed");
+			qreal vspeed = GmxReader::doubleAttribute(view, "vspeed");
 
 			auto obj = new MapObject(QStringLiteral("VIEW_").append(QString::number(viewCount)), QStringLiteral("t_gmRoomView"),QPointF(16*viewCount,16), QSizeF(16,16));
 
@@ -551,20 +624,19 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
 	//VIEW/BG IMPORT END
 
 
-    QVector<TileLayer*> *mapLayers = new QVector<TileLayer*>();
 	//QVector<SharedTileset> *tilesets = new QVector<SharedTileset>();
 
 	bool warnAboutSkippedTiles = false;
 
 	//Import tiles
-    QDir imageDir = QDir(settings.imagesPath);
+    RoomImportContext context(newMap, QDir(settings.imagesPath));
     while(tile)
     {
-        if(QString(tile->name()) == "tile")
+        if(GmxReader::hasName(tile, "tile"))
         {
 
-            int w = QString(tile->first_attribute("w")->value()).toInt();
-            int h = QString(tile->first_attribute("h")->value()).toInt();
+            int w = GmxReader::intAttribute(tile, "w");
+            int h = GmxReader::intAttribute(tile, "h");
             int htiles=1;
             int vtiles=1;
             if(w!=tileWidth||h!=tileHeight)
@@ -588,27 +660,27 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
                     continue;
                 }
             }
-            int x = QString(tile->first_attribute("x")->value()).toInt();
-            int y = QString(tile->first_attribute("y")->value()).toInt();
-            int xo = QString(tile->first_attribute("xo")->value()).toInt();
-            int yo = QString(tile->first_attribute("yo")->value()).toInt();
-            int scaleX = QString(tile->first_attribute("scaleX")->value()).toInt();
-            int scaleY = QString(tile->first_attribute("scaleY")->value()).toInt();
+            int x = GmxReader::intAttribute(tile, "x");
+            int y = GmxReader::intAttribute(tile, "y");
+            int xo = GmxReader::intAttribute(tile, "xo");
+            int yo = GmxReader::intAttribute(tile, "yo");
+            int scaleX = GmxReader::intAttribute(tile, "scaleX");
+            int scaleY = GmxReader::intAttribute(tile, "scaleY");
 
             int xoff = x%tileWidth;
             int yoff = y%tileHeight;
 			x = (x/tileWidth)*tileWidth;
 			y = (y/tileHeight)*tileHeight;
-            int depth = QString(tile->first_attribute("depth")->value()).toInt();
-            QString bgName = QString(tile->first_attribute("bgName")->value());
+            int depth = GmxReader::intAttribute(tile, "depth");
+            QString bgName = reader.internedAttribute(tile, "bgName");
 
-            TileLayer *layer = tileLayerAtDepth(*mapLayers,depth,xoff, yoff,newMap);
+            TileLayer *layer = context.tileLayerAtDepth(depth, xoff, yoff);
             if(layer==nullptr)
             {
                 tile = tile->next_sibling();
                 continue;
             }
-			SharedTileset tileset = tilesetWithName(bgName,newMap,imageDir);
+			SharedTileset tileset = context.tilesetWithName(bgName);
 			if(tileset.isNull())
             {
                 tile = tile->next_sibling();
@@ -695,9 +767,7 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
     {
 		objects = new Tiled::ObjectGroup(QString("objects"),0,0);
         objects->setProperty(QString("depth"),QVariant(0));
-        unordered_map<string,string> *templateMap = new unordered_map<string,string> ();
-        QDir dir = QDir(settings.templatePath.append(QString("/")));
-        GmxPlugin::mapTemplates(templateMap,dir);
+        const QString templatesDir = QDir(settings.templatePath).absolutePath();
 
 		QDir imagesPath = QDir(settings.templatePath);
 		imagesPath.cdUp();
@@ -708,21 +778,15 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
 
         for(; instance ; instance=instance->next_sibling())
         {
-            int x = QString(instance->first_attribute("x")->value()).toInt();
+            int x = GmxReader::intAttribute(instance, "x");
 
-            int y = QString(instance->first_attribute("y")->value()).toInt();
+            int y = GmxReader::intAttribute(instance, "y");
 
-            QString code = QString(instance->first_attribute("code")->value());
+            QString code = GmxReader::stringAttribute(instance, "code");
 
-            QString objName = QString(instance->first_attribute("objName")->value());
+            QString objName = reader.internedAttribute(instance, "objName");
 
-            QString tempath = QString("");
-            unordered_map<string,string>::iterator it = templateMap->find(objName.toStdString());
-
-            if(it != templateMap->end())
-            {
-                tempath = QString(it->second.c_str());
-            }
+            QString tempath = TemplateManager::instance()->templateFileName(templatesDir, objName);
 
             QPointF pos = QPointF(x,y);
             ObjectTemplate *templ = TemplateManager::instance()->loadObjectTemplate(tempath);
@@ -734,9 +798,9 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
 				aux = templ->object()->inheritedProperty(QStringLiteral("originY"));
                 int originY = aux.toInt();
 
-                double rotation = QString(instance->first_attribute("rotation")->value()).toDouble() *-1;
-                double scaleX = QString(instance->first_attribute("scaleX")->value()).toDouble();
-                double scaleY = QString(instance->first_attribute("scaleY")->value()).toDouble();
+                double rotation = GmxReader::doubleAttribute(instance, "rotation") *-1;
+                double scaleX = GmxReader::doubleAttribute(instance, "scaleX");
+                double scaleY = GmxReader::doubleAttribute(instance, "scaleY");
                 if(scaleX<0)
                 {
                     originX = int(templ->object()->width() - originX);
@@ -769,18 +833,8 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
                 obj->setSize(QSizeF(templ->object()->width()*abs(scaleX),templ->object()->height()*abs(scaleY)));
 
 				//Colors and locked
-				auto auxAttr = instance->first_attribute("locked");
-				bool locked = false;
-				if(auxAttr && auxAttr->value() == QStringLiteral("-1"))
-				{
-					locked = true;
-				}
-				auxAttr = instance->first_attribute("colour");
-				QColor color = QColor(255,255,255,255);
-				if(auxAttr)
-				{
-					color = longOleToColor(QString(auxAttr->value()).toUInt());
-				}
+				bool locked = GmxReader::boolAttribute(instance, "locked");
+				QColor color = longOleToColor(GmxReader::uintAttribute(instance, "colour", 0xffffffffu));
 				obj->setProperty("colour", color);
 				if(locked)
 					obj->setProperty("locked", locked);
@@ -804,9 +858,9 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
 				int originX = 0;
 				int originY = 0;
 
-				double rotation = QString(instance->first_attribute("rotation")->value()).toDouble() *-1;
-				double scaleX = QString(instance->first_attribute("scaleX")->value()).toDouble();
-				double scaleY = QString(instance->first_attribute("scaleY")->value()).toDouble();
+				double rotation = GmxReader::doubleAttribute(instance, "rotation") *-1;
+				double scaleX = GmxReader::doubleAttribute(instance, "scaleX");
+				double scaleY = GmxReader::doubleAttribute(instance, "scaleY");
 
 				QPointF origin = QPointF(-originX*abs(scaleX),-originY*abs(scaleY));
 
@@ -834,17 +888,13 @@ Tiled::Map *GmxPlugin::read(const QString &fileName, QSettings *appSettings)
         newMap->addLayer(objects);
 
         qDebug()<<"Done";
-        delete templateMap;
     }
 
     QList<Layer*> *mLayers = newMap->layersNoConst();
-    if(!mLayers->isEmpty())
-    {
-		std::stable_sort(mLayers->begin(),mLayers->end(),lesThanLayer);
-    }
+	const auto sortedLayers = sortedByDepth<Layer*>(*mLayers, 99999990, 99999990);
+	for (int i = 0; i < mLayers->size(); ++i)
+		(*mLayers)[i] = sortedLayers[i].layer;
 
-	doc.clear();
-    delete mapLayers;
 	//delete tilesets;
 
 	if(warnAboutSkippedTiles)
@@ -990,7 +1040,9 @@ static void writeRoomProps(const Map* map, QXmlStreamWriter &stream)
 	stream.writeEndElement();
 }
 
-static void writeViews(QXmlStreamWriter &stream, const Map *map, std::vector<const Layer*> &layers)
+static void writeViews(QXmlStreamWriter &stream, const Map *map,
+					   const ObjectGroup *backgroundDefs,
+					   const ObjectGroup *viewDefs)
 {
 	// Write out views
 	if (true) {
@@ -999,19 +1051,7 @@ static void writeViews(QXmlStreamWriter &stream, const Map *map, std::vector<con
 
 		int bgCount = 0;
 
-		for(uint i=0; i<layers.size(); ++i){
-			const Layer *layer = layers[i];
-			if (layer->layerType() != Layer::ObjectGroupType)
-				continue;
-
-			if(layer->name() != QStringLiteral("_gmRoomBgDefs"))
-			{
-				continue;
-			}
-
-			const ObjectGroup *objectLayer = static_cast<const ObjectGroup*>(layer);
-
-
+		if (const ObjectGroup *objectLayer = backgroundDefs) {
 			for(int bgId = 0; bgId < 8; ++bgId)
 			{
 				for (const MapObject *object : objectLayer->objects()) {
@@ -1069,8 +1109,6 @@ static void writeViews(QXmlStreamWriter &stream, const Map *map, std::vector<con
 			{
 				writeBackground(&stream);
 			}
-
-			break;
 		}
 
 		stream.writeEndElement();//backgrounds
@@ -1079,20 +1117,7 @@ static void writeViews(QXmlStreamWriter &stream, const Map *map, std::vector<con
 		stream.writeStartElement("views");
 		int viewCount = 0;
 
-		for(uint i=0; i<layers.size(); ++i){
-			const Layer *layer = layers[i];
-
-			if (layer->layerType() != Layer::ObjectGroupType)
-				continue;
-
-			if(layer->name() != QStringLiteral("_gmsRoomViewDefs"))
-			{
-				continue;
-			}
-
-			const ObjectGroup *objectLayer = static_cast<const ObjectGroup*>(layer);
-
-
+		if (const ObjectGroup *objectLayer = viewDefs) {
 			for(int viewId = 0; viewId < 8; ++viewId)
 			{
 				for (const MapObject *object : objectLayer->objects()) {
@@ -1139,8 +1164,6 @@ static void writeViews(QXmlStreamWriter &stream, const Map *map, std::vector<con
 			{
 				writeView(&stream);
 			}
-
-			break;
 		}
 
 		stream.writeEndElement();//views
@@ -1160,12 +1183,12 @@ bool GmxPlugin::write(const Map *map, const QString &fileName)
 	int mapPixelHeight = map->tileHeight() * map->height();
 
 	//Prepare layers for iteration
-	std::vector<const Layer*> layers;
-	layers.reserve(32);
+	std::vector<const Layer*> allLayers;
+	allLayers.reserve(32);
 	{
 		LayerIterator iterator(map);
 		while (const Layer *layer = iterator.next()) {
-			layers.push_back(layer);
+			allLayers.push_back(layer);
 		}
 	}
 
@@ -1173,33 +1196,29 @@ bool GmxPlugin::write(const Map *map, const QString &fileName)
 
 	//Game maker outputs tiles ordered by their depth in descending order
 	//and instance id in ascending order
-	std::sort(layers.begin(), layers.end(),
-	[](const Layer *a, const Layer *b)
-	{
-		int depthA = 0;
-		int depthB = 0;
-		auto auxProp = a->property(QStringLiteral("depth"));
-		if(a->isTileLayer())
-		{
-			depthA	= 1000000;
-		}
-		if(auxProp.isValid() && auxProp.type() == QVariant::Int)
-		{
-			depthA = auxProp.toInt();
-		}
+	const auto layers = sortedByDepth<const Layer*>(allLayers, 0, 1000000);
 
-		auxProp = b->property(QStringLiteral("depth"));
-		if(b->isTileLayer())
-		{
-			depthB	= 1000000;
-		}
-		if(auxProp.isValid() && auxProp.type() == QVariant::Int)
-		{
-			depthB = auxProp.toInt();
-		}
+	//Find the layers of each section of the room in a single pass
+	const ObjectGroup *backgroundDefs = nullptr;
+	const ObjectGroup *viewDefs = nullptr;
+	std::vector<const ObjectGroup*> instanceLayers;
 
-		return depthA > depthB;
-	});
+	for (const auto &sortedLayer : layers) {
+		if (sortedLayer.layer->layerType() != Layer::ObjectGroupType)
+			continue;
+
+		auto objectGroup = static_cast<const ObjectGroup*>(sortedLayer.layer);
+
+		if (objectGroup->name() == QLatin1String("_gmRoomBgDefs")) {
+			if (!backgroundDefs)
+				backgroundDefs = objectGroup;
+		} else if (objectGroup->name() == QLatin1String("_gmsRoomViewDefs")) {
+			if (!viewDefs)
+				viewDefs = objectGroup;
+		} else {
+			instanceLayers.push_back(objectGroup);
+		}
+	}
 
 	QXmlStreamWriter stream;
 	stream.setDevice(file.device());
@@ -1211,28 +1230,24 @@ bool GmxPlugin::write(const Map *map, const QString &fileName)
 	stream.writeStartElement("room");
 
 	writeRoomProps(map, stream);
-	writeViews(stream, map, layers);
+	writeViews(stream, map, backgroundDefs, viewDefs);
 
 	//Global instance id for everything written out
 	uint instId = 100000u;//In GM They start at 100000 for some reason
 
 	// Write out object instances
 	stream.writeStartElement("instances");
-	for(uint i=0; i<layers.size(); ++i){
-		const Layer *layer = layers[i];
-		if (layer->layerType() != Layer::ObjectGroupType)
-			continue;
-		if(layer->name() == QStringLiteral("_gmsRoomViewDefs"))
-		{
-			continue;
-		}
-
-		if(layer->name() == QStringLiteral("_gmRoomBgDefs"))
-		{
-			continue;
-		}
-
-		const ObjectGroup *objectLayer = static_cast<const ObjectGroup*>(layer);
+	for (const ObjectGroup *objectLayer : instanceLayers) {
+		// These are looked up for every instance, so only create them once
+		static const QString imageWidthName = QStringLiteral("imageWidth");
+		static const QString imageHeightName = QStringLiteral("imageHeight");
+		static const QString originXName = QStringLiteral("originX");
+		static const QString originYName = QStringLiteral("originY");
+		static const QString scaleXName = QStringLiteral("scaleX");
+		static const QString scaleYName = QStringLiteral("scaleY");
+		static const QString lockedName = QStringLiteral("locked");
+		static const QString codeName = QStringLiteral("code");
+		static const QString colourName = QStringLiteral("colour");
 
 		for (const MapObject *object : objectLayer->objects()) {
 			const QString type = object->effectiveType();
@@ -1250,11 +1265,11 @@ bool GmxPlugin::write(const Map *map, const QString &fileName)
 			QPointF pos = object->position();
 			qreal scaleX = 1;
 			qreal scaleY = 1;
-			qreal imageWidth = optionalProperty(object,"imageWidth",-1);
-			qreal imageHeigth = optionalProperty(object,"imageHeight",-1);
+			qreal imageWidth = optionalProperty(object, imageWidthName, -1);
+			qreal imageHeigth = optionalProperty(object, imageHeightName, -1);
 
-			QPointF origin(optionalProperty(object, "originX", 0.0),
-						   optionalProperty(object, "originY", 0.0));
+			QPointF origin(optionalProperty(object, originXName, 0.0),
+						   optionalProperty(object, originYName, 0.0));
 
 			if (!object->cell().isEmpty()) {
 				// For tile objects we can support scaling and flipping, though
@@ -1306,8 +1321,8 @@ bool GmxPlugin::write(const Map *map, const QString &fileName)
 				scaleY = object->height() / imageHeigth;
 			}
 			// Allow overriding the scale using custom properties
-			scaleX = optionalProperty(object, "scaleX", scaleX);
-			scaleY = optionalProperty(object, "scaleY", scaleY);
+			scaleX = optionalProperty(object, scaleXName, scaleX);
+			scaleY = optionalProperty(object, scaleYName, scaleY);
 
 			// Adjust the position based on the origin
 			QTransform transform;
@@ -1321,17 +1336,17 @@ bool GmxPlugin::write(const Map *map, const QString &fileName)
 			QString instIdStr = QString::number(++instId);
 			stream.writeAttribute("name", QStringLiteral("inst_")+instIdStr);
 
-			stream.writeAttribute("locked", toString(optionalProperty(object, QStringLiteral("locked"), false)));
+			stream.writeAttribute("locked", toString(optionalProperty(object, lockedName, false)));
 
 			//Custom add atribute
-			QString cc2 = optionalProperty(object, "code", QString());
+			QString cc2 = optionalProperty(object, codeName, QString());
 
 			writeAttribute(QStringLiteral("code"),cc2,(QIODevice*)stream.device(),(QTextCodec*)stream.codec());
 			//stream.writeAttribute(QStringLiteral("code"), cc2);
 			//stream.writeAttribute("code", optionalProperty(object, "code", QString()));
 			stream.writeAttribute("scaleX", QString::number(scaleX));
 			stream.writeAttribute("scaleY", QString::number(scaleY));
-			QColor color = optionalProperty(object, QStringLiteral("colour"), QColor(255,255,255,255));
+			QColor color = optionalProperty(object, colourName, QColor(255,255,255,255));
 			QString colorStr = colorToLongOle(color);
 			stream.writeAttribute("colour", colorStr);
 			stream.writeAttribute("rotation", QString::number(-object->rotation()));
@@ -1346,14 +1361,16 @@ bool GmxPlugin::write(const Map *map, const QString &fileName)
 	stream.writeStartElement("tiles");
     int depthOff = 0;
     int layerCount = 0;
-	std::unordered_map <long, QPoint> processedTiles;
-	processedTiles.reserve((map->width()*map->height())/2);
+	TileCombiner combiner(TileCombiner::modeFromString(
+							  optionalProperty(map, QStringLiteral("combineTilesMode"), QString())));
+	const QSize cellSize(map->tileWidth(), map->tileHeight());
 
 
-	for(uint i=0; i<layers.size(); ++i){
-		const Layer *layer = layers[i];
+	for (const auto &sortedLayer : layers) {
+		const Layer *layer = sortedLayer.layer;
         --layerCount;
-		QString depth = QString::number(optionalProperty(layer, QLatin1String("depth"), 1000000 - depthOff));
+		QString depth = QString::number(sortedLayer.hasDepth ? sortedLayer.depth
+															 : 1000000 - depthOff);
 
         int xoff = layer->offset().x();
         int yoff = layer->offset().y();
@@ -1362,217 +1379,116 @@ bool GmxPlugin::write(const Map *map, const QString &fileName)
         case Layer::TileLayerType: {
             ++depthOff;
             auto tileLayer = static_cast<const TileLayer*>(layer);
-			int layerWidth = tileLayer->width();
-			int layerHeight = tileLayer->height();
-			for (int y = 0; y < layerHeight; ++y)
-			{
-				for (int x = 0; x < layerWidth; ++x)
-				{
-					//Skip processed tiles
-					if(combineTiles && processedTiles.count(x + y*layerWidth) > 0)
-					{
-						continue;
-					}
 
-                    const Cell &cell = tileLayer->cellAt(x, y);
+			//Each rect becomes one tile, merged cells are written as a
+			//single region of the background
+			QVector<QRect> rects;
+			if(combineTiles)
+			{
+				rects = combiner.combine(*tileLayer, cellSize);
+			}
+			else
+			{
+				for (int y = 0; y < tileLayer->height(); ++y)
+					for (int x = 0; x < tileLayer->width(); ++x)
+						if(tileLayer->cellAt(x, y).tile())
+							rects.append(QRect(x, y, 1, 1));
+			}
 
-                    if (const Tile *tile = cell.tile()) {
-                        const Tileset *tileset = tile->tileset();
+			for (const QRect &rect : qAsConst(rects))
+			{
+				const int x = rect.x();
+				const int y = rect.y();
 
-						stream.writeStartElement("tile");
+                const Cell &cell = tileLayer->cellAt(x, y);
 
-						int pixelX = x * map->tileWidth();
-						int pixelY = y * map->tileHeight();
-						qreal scaleX = 1;
-						qreal scaleY = 1;
+                if (const Tile *tile = cell.tile()) {
+                    const Tileset *tileset = tile->tileset();
 
-						if (cell.flippedHorizontally()) {
-							scaleX = -1;
-							pixelX += tile->width();
-						}
+					stream.writeStartElement("tile");
 
-						if (cell.flippedVertically()) {
-							scaleY = -1;
-							pixelY += tile->height();
+					int pixelX = x * map->tileWidth();
+					int pixelY = y * map->tileHeight();
+					qreal scaleX = 1;
+					qreal scaleY = 1;
 
-						}
+					if (cell.flippedHorizontally()) {
+						scaleX = -1;
+						pixelX += tile->width();
+					}
 
-						QString bgName;
-						int xo = 0;
-						int yo = 0;
-						int tileWidth = tile->width();
-						int tileHeight = tile->height();
-
-						if (tileset->isCollection()) {
-							bgName = QFileInfo(tile->imageSource().path()).baseName();
-						} else {
-							bgName = tileset->name().split(".",QString::SkipEmptyParts).at(0);
-							int tstColumns = tileset->columnCount();
-							int tstRows = tileset->rowCount();
-
-							int xInTilesetGrid = tile->id() % tileset->columnCount();
-							int yInTilesetGrid = (tile->id() / tileset->columnCount());
-
-							xo = tileset->margin() + (tileset->tileSpacing() + tileset->tileWidth()) * xInTilesetGrid;
-							yo = tileset->margin() + (tileset->tileSpacing() + tileset->tileHeight()) * yInTilesetGrid;
-
-							//We only combine these for now to keep it simple
-							if(combineTiles && scaleX == 1 && scaleY == 1
-							&& (tileset->margin() == 0) && (tileset->tileSpacing()) == 0
-							&& (tile->width() == map->tileWidth()) && (tile->height() == map->tileHeight()))
-							{
-								int maxCheckXOff = tstColumns-1 - xInTilesetGrid;
-								int maxCheckYOff = tstRows-1 - yInTilesetGrid;
+					if (cell.flippedVertically()) {
+						scaleY = -1;
+						pixelY += tile->height();
 
-								int combineXRight = 0;
-								int combineYBottom = 0;
-								int combineArea = 1;//in tiles
-								int currentArea = 1;
+					}
 
-								int checkX = 1;
-								int checkY = 0;
+					QString bgName;
+					int xo = 0;
+					int yo = 0;
+					int tileWidth = tile->width() * rect.width();
+					int tileHeight = tile->height() * rect.height();
 
-								bool prevAccepted = true;
+					if (tileset->isCollection()) {
+						bgName = QFileInfo(tile->imageSource().path()).baseName();
+					} else {
+						bgName = tileset->name().split(".",QString::SkipEmptyParts).at(0);
 
-								for(;checkY <= maxCheckYOff && (checkY + y) < layerHeight; ++checkY)
-								{
+						int xInTilesetGrid = tile->id() % tileset->columnCount();
+						int yInTilesetGrid = (tile->id() / tileset->columnCount());
 
-									for(; checkX <= maxCheckXOff && (checkX	+ x) < layerWidth; ++checkX)
-									{
-
-										const Cell &sCell = tileLayer->cellAt(x + checkX,y + checkY);
-										bool acceptedTile = false;
-										if(const Tile *sTile = sCell.tile())
-										{
-											if(processedTiles.count((checkX + x) + (checkY+y)*layerWidth) == 0)
-											{
-												const Tileset *sTileset = sTile->tileset();
-
-												if(sTileset == tileset
-												&& (sTile->width() == map->tileWidth()) && (sTile->height() == map->tileHeight())
-												&& !sCell.flippedVertically() && !sCell.flippedHorizontally())
-												{
-													int sTileXInGrid = sTile->id() % tstColumns;
-													int sTileYInGrid = (sTile->id() / tstColumns);
-
-													if( (sTileXInGrid == (xInTilesetGrid + checkX))
-													&& (sTileYInGrid == (yInTilesetGrid + checkY)))
-													{
-														currentArea = ((checkX+1)*(checkY+1));
-
-														acceptedTile = true;
-														if(currentArea > combineArea)
-														{
-															combineArea = currentArea;
-															combineXRight = checkX;
-															combineYBottom = checkY;
-
-
-														}
-													}
-												}
-											}
-										}
-
-										if(!acceptedTile)
-										{
-											if(checkX > 0)
-												maxCheckXOff = checkX-1;
-											else
-												maxCheckXOff = 0;
-											if(!prevAccepted || (maxCheckXOff == 0))
-											{
-												maxCheckXOff = -1;
-												maxCheckYOff = -1;
-											}
-
-											prevAccepted = false;
-											break;
-										}
-										else
-										{
-											prevAccepted = true;
-										}
-									}
-
-									checkX = 0;
-								}
+						xo = tileset->margin() + (tileset->tileSpacing() + tileset->tileWidth()) * xInTilesetGrid;
+						yo = tileset->margin() + (tileset->tileSpacing() + tileset->tileHeight()) * yInTilesetGrid;
 
-								if(combineArea > 1)
+						//Merged cells always match the map tile size
+						if(rect.width() == 1 && rect.height() == 1)
+						{
+							if(tile->width() > map->tileWidth())
+							{
+								pixelX = x*map->tileWidth();
+								if(cell.flippedHorizontally())
 								{
-									//Final step
-									checkX = 1;
-									for(checkY = 0 ;checkY <= combineYBottom && (checkY + y) < layerHeight; ++checkY)
-									{
-
-										for(; checkX <= combineXRight && (checkX + x) < layerWidth; ++checkX)
-										{
-											processedTiles.emplace(
-														(x+checkX) + (y+checkY)*layerWidth,
-														QPoint(checkX + x, checkY + y));
-										}
-
-										checkX	= 0;
-									}
-									tileWidth = (combineXRight + 1)*tile->width();
-									tileHeight = (combineYBottom+ 1)*tile->height();
-									if(!(tileWidth/tile->width())*(tileHeight/tile->height()) == combineArea )
-									{
-										qDebug() << "Fail";
-									}
+									pixelX += map->tileWidth();
 								}
+
 							}
-							else //No Combine
+							if(tile->height() > map->tileHeight())
 							{
-								if(tile->width() > map->tileWidth())
-								{
-									pixelX = x*map->tileWidth();
-									if(cell.flippedHorizontally())
-									{
-										pixelX += map->tileWidth();
-									}
+								pixelY = y*map->tileHeight();
 
-								}
-								if(tile->height() > map->tileHeight())
+								pixelY -= tile->height() - map->tileHeight();
+								if(cell.flippedVertically())
 								{
-									pixelY = y*map->tileHeight();
-
-									pixelY -= tile->height() - map->tileHeight();
-									if(cell.flippedVertically())
-									{
-										pixelY += map->tileHeight();
-									}
-
+									pixelY += map->tileHeight();
 								}
+
 							}
 						}
+					}
 
-						stream.writeAttribute("bgName", bgName);
-						stream.writeAttribute("x", QString::number(pixelX+xoff));
-						stream.writeAttribute("y", QString::number(pixelY+yoff));
-						stream.writeAttribute("w", QString::number(tileWidth));
-						stream.writeAttribute("h", QString::number(tileHeight));
+					stream.writeAttribute("bgName", bgName);
+					stream.writeAttribute("x", QString::number(pixelX+xoff));
+					stream.writeAttribute("y", QString::number(pixelY+yoff));
+					stream.writeAttribute("w", QString::number(tileWidth));
+					stream.writeAttribute("h", QString::number(tileHeight));
 
-						stream.writeAttribute("xo", QString::number(xo));
-						stream.writeAttribute("yo", QString::number(yo));
+					stream.writeAttribute("xo", QString::number(xo));
+					stream.writeAttribute("yo", QString::number(yo));
 
-						QString tileIdStr = QString::number(++instId);
-						stream.writeAttribute("id", tileIdStr);
-						stream.writeAttribute("name", QStringLiteral("inst_") + tileIdStr);
-						stream.writeAttribute("depth", depth);
-						stream.writeAttribute("locked","0");
-						stream.writeAttribute("colour", QStringLiteral("4294967295"));
+					QString tileIdStr = QString::number(++instId);
+					stream.writeAttribute("id", tileIdStr);
+					stream.writeAttribute("name", QStringLiteral("inst_") + tileIdStr);
+					stream.writeAttribute("depth", depth);
+					stream.writeAttribute("locked","0");
+					stream.writeAttribute("colour", QStringLiteral("4294967295"));
 
-						stream.writeAttribute("scaleX", QString::number(scaleX));
-						stream.writeAttribute("scaleY", QString::number(scaleY));
+					stream.writeAttribute("scaleX", QString::number(scaleX));
+					stream.writeAttribute("scaleY", QString::number(scaleY));
 
-						stream.writeEndElement();
-                    }
+					stream.writeEndElement();
                 }
+			}
 
-            }
-
-			processedTiles.clear();
             break;
         }
 
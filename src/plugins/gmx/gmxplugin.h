@@ -51,7 +51,6 @@ class GMXSHARED_EXPORT GmxPlugin : public Tiled::MapFormat
 public:
 	GmxPlugin(QObject *parent = nullptr);
 	void writeAttribute(const QString &qualifiedName, QString &value, QIODevice* d, QTextCodec* codec);
-    static void mapTemplates(std::unordered_map<std::string,std::string> *map, QDir &root );
 	Tiled::Map *read(const QString &fileName, QSettings *) override;
 	bool supportsFile(const QString &fileName) const override;
 	bool write(const Tiled::Map *map, const QString &fileName) override;
@@ -0,0 +1,345 @@
+/*
+ * gmxreader.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gmxreader.h"
+
+#include <QCoreApplication>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace Gmx;
+
+namespace {
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Narrows [begin, end) to the text without surrounding whitespace
+inline void trim(const char *&begin, const char *&end)
+{
+    while (begin != end && isSpace(*begin))
+        ++begin;
+    while (end != begin && isSpace(*(end - 1)))
+        --end;
+}
+
+// Parses an optionally signed decimal number that fits in a qint64
+bool parseInteger(const char *begin, const char *end, qint64 &value)
+{
+    trim(begin, end);
+
+    bool negative = false;
+    if (begin != end && (*begin == '-' || *begin == '+')) {
+        negative = *begin == '-';
+        ++begin;
+    }
+    if (begin == end)
+        return false;
+
+    quint64 result = 0;
+    for (; begin != end; ++begin) {
+        if (!isDigit(*begin))
+            return false;
+        result = result * 10 + quint64(*begin - '0');
+        if (result > quint64(std::numeric_limits<qint64>::max()))
+            return false;
+    }
+
+    value = negative ? -qint64(result) : qint64(result);
+    return true;
+}
+
+inline const GmxReader::Attribute *findAttribute(const GmxReader::Node *node, const char *name)
+{
+    return node ? node->first_attribute(name) : nullptr;
+}
+
+inline const GmxReader::Node *findNode(const GmxReader::Node *parent, const char *name)
+{
+    return parent ? parent->first_node(name) : nullptr;
+}
+
+} // anonymous namespace
+
+GmxReader::GmxReader()
+    : mMapped(nullptr)
+{
+}
+
+GmxReader::~GmxReader()
+{
+    close();
+}
+
+void GmxReader::close()
+{
+    mDocument.clear();
+    mInterned.clear();
+
+    if (mMapped) {
+        mFile.unmap(mMapped);
+        mMapped = nullptr;
+    }
+    mBuffer.clear();
+
+    if (mFile.isOpen())
+        mFile.close();
+}
+
+bool GmxReader::read(const QString &fileName)
+{
+    close();
+    mError.clear();
+
+    mFile.setFileName(fileName);
+    if (!mFile.open(QIODevice::ReadOnly)) {
+        mError = QCoreApplication::translate("GmxReader", "Could not open file for reading.");
+        return false;
+    }
+
+    const qint64 size = mFile.size();
+    if (size <= 0) {
+        mError = QCoreApplication::translate("GmxReader", "The file is empty.");
+        return false;
+    }
+
+    char *text = nullptr;
+
+    // rapidxml parses in place and needs the text to end with a null
+    // character. A private mapping can be written to without touching the
+    // file, so the trailing newline GameMaker writes can take its place.
+    // Files that don't end in whitespace are read into a buffer instead.
+    if (uchar *data = mFile.map(0, size, QFileDevice::MapPrivateOption)) {
+        if (isSpace(char(data[size - 1]))) {
+            data[size - 1] = '\0';
+            mMapped = data;
+            text = reinterpret_cast<char*>(data);
+        } else {
+            mFile.unmap(data);
+        }
+    }
+
+    if (!text) {
+        mBuffer = mFile.readAll();
+        text = mBuffer.data();
+    }
+
+    try {
+        mDocument.parse<0>(text);
+    } catch (rapidxml::parse_error &e) {
+        mError = QCoreApplication::translate("GmxReader", "Error parsing file: %1")
+                .arg(QString::fromLatin1(e.what()));
+        return false;
+    }
+
+    return true;
+}
+
+GmxReader::Node *GmxReader::firstNode(const char *name) const
+{
+    return mDocument.first_node(name);
+}
+
+bool GmxReader::hasName(const Node *node, const char *name)
+{
+    const std::size_t size = std::strlen(name);
+    return node && node->name_size() == size && std::memcmp(node->name(), name, size) == 0;
+}
+
+int GmxReader::intValue(const Node *parent, const char *name, int def)
+{
+    const Node *node = findNode(parent, name);
+    int value;
+    if (node && toInt(node->value(), node->value_size(), value))
+        return value;
+    return def;
+}
+
+bool GmxReader::boolValue(const Node *parent, const char *name, bool def)
+{
+    int value;
+    const Node *node = findNode(parent, name);
+    if (node && toInt(node->value(), node->value_size(), value))
+        return value != 0;
+    return def;
+}
+
+QString GmxReader::stringValue(const Node *parent, const char *name)
+{
+    const Node *node = findNode(parent, name);
+    if (!node)
+        return QString();
+    return QString::fromUtf8(node->value(), int(node->value_size()));
+}
+
+int GmxReader::intAttribute(const Node *node, const char *name, int def)
+{
+    const Attribute *attribute = findAttribute(node, name);
+    int value;
+    if (attribute && toInt(attribute->value(), attribute->value_size(), value))
+        return value;
+    return def;
+}
+
+uint GmxReader::uintAttribute(const Node *node, const char *name, uint def)
+{
+    const Attribute *attribute = findAttribute(node, name);
+    uint value;
+    if (attribute && toUInt(attribute->value(), attribute->value_size(), value))
+        return value;
+    return def;
+}
+
+double GmxReader::doubleAttribute(const Node *node, const char *name, double def)
+{
+    const Attribute *attribute = findAttribute(node, name);
+    double value;
+    if (attribute && toDouble(attribute->value(), attribute->value_size(), value))
+        return value;
+    return def;
+}
+
+/**
+ * GameMaker writes booleans as -1 and 0.
+ */
+bool GmxReader::boolAttribute(const Node *node, const char *name, bool def)
+{
+    const Attribute *attribute = findAttribute(node, name);
+    int value;
+    if (attribute && toInt(attribute->value(), attribute->value_size(), value))
+        return value != 0;
+    return def;
+}
+
+QString GmxReader::stringAttribute(const Node *node, const char *name)
+{
+    const Attribute *attribute = findAttribute(node, name);
+    if (!attribute)
+        return QString();
+    return QString::fromUtf8(attribute->value(), int(attribute->value_size()));
+}
+
+/**
+ * Returns the value of the attribute, converting it only the first time a
+ * given value is seen. Meant for names that are repeated throughout a room.
+ */
+QString GmxReader::internedAttribute(const Node *node, const char *name)
+{
+    const Attribute *attribute = findAttribute(node, name);
+    if (!attribute)
+        return QString();
+
+    // The key points into the parsed text, which outlives the hash
+    const QLatin1String key(attribute->value(), int(attribute->value_size()));
+
+    auto it = mInterned.find(key);
+    if (it == mInterned.end())
+        it = mInterned.insert(key, QString::fromUtf8(key.data(), key.size()));
+    return it.value();
+}
+
+bool GmxReader::toInt(const char *text, std::size_t size, int &value)
+{
+    qint64 result;
+    if (!parseInteger(text, text + size, result))
+        return false;
+    if (result < std::numeric_limits<int>::min() || result > std::numeric_limits<int>::max())
+        return false;
+
+    value = int(result);
+    return true;
+}
+
+bool GmxReader::toUInt(const char *text, std::size_t size, uint &value)
+{
+    qint64 result;
+    if (!parseInteger(text, text + size, result))
+        return false;
+    if (result < 0 || result > std::numeric_limits<uint>::max())
+        return false;
+
+    value = uint(result);
+    return true;
+}
+
+/**
+ * Parses plain decimal notation with an optional exponent, independent of
+ * the current locale.
+ */
+bool GmxReader::toDouble(const char *text, std::size_t size, double &value)
+{
+    const char *begin = text;
+    const char *end = text + size;
+    trim(begin, end);
+
+    bool negative = false;
+    if (begin != end && (*begin == '-' || *begin == '+')) {
+        negative = *begin == '-';
+        ++begin;
+    }
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    bool digits = false;
+
+    for (; begin != end && isDigit(*begin); ++begin) {
+        mantissa = mantissa * 10.0 + (*begin - '0');
+        digits = true;
+    }
+    if (begin != end && *begin == '.') {
+        ++begin;
+        for (; begin != end && isDigit(*begin); ++begin) {
+            mantissa = mantissa * 10.0 + (*begin - '0');
+            --exponent;
+            digits = true;
+        }
+    }
+    if (!digits)
+        return false;
+
+    if (begin != end && (*begin == 'e' || *begin == 'E')) {
+        qint64 explicitExponent;
+        if (!parseInteger(begin + 1, end, explicitExponent))
+            return false;
+        if (explicitExponent < -1000 || explicitExponent > 1000)
+            return false;
+        exponent += int(explicitExponent);
+        begin = end;
+    }
+    if (begin != end)
+        return false;
+
+    // Dividing by an exact power of ten keeps values like 0.1 exact
+    if (exponent < 0)
+        mantissa /= std::pow(10.0, -exponent);
+    else if (exponent > 0)
+        mantissa *= std::pow(10.0, exponent);
+
+    value = negative ? -mantissa : mantissa;
+    return true;
+}
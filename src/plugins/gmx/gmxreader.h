@@ -0,0 +1,86 @@
+/*
+ * gmxreader.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "rapidxml.hpp"
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QLatin1String>
+#include <QString>
+
+namespace Gmx {
+
+/**
+ * Parses a GameMaker XML file in place.
+ *
+ * The file is memory mapped and handed to rapidxml without being copied,
+ * and numbers are read straight from the parsed text. Strings that repeat
+ * a lot, like background and object names, can be interned so that each
+ * distinct name is only converted to a QString once.
+ *
+ * The nodes returned by the reader point into the mapped file, so they are
+ * only valid as long as the reader is alive.
+ */
+class GmxReader
+{
+public:
+    typedef rapidxml::xml_node<> Node;
+    typedef rapidxml::xml_attribute<> Attribute;
+
+    GmxReader();
+    ~GmxReader();
+
+    bool read(const QString &fileName);
+    QString errorString() const { return mError; }
+
+    Node *firstNode(const char *name) const;
+
+    static bool hasName(const Node *node, const char *name);
+
+    static int intValue(const Node *parent, const char *name, int def = 0);
+    static bool boolValue(const Node *parent, const char *name, bool def = false);
+    static QString stringValue(const Node *parent, const char *name);
+
+    static int intAttribute(const Node *node, const char *name, int def = 0);
+    static uint uintAttribute(const Node *node, const char *name, uint def = 0);
+    static double doubleAttribute(const Node *node, const char *name, double def = 0.0);
+    static bool boolAttribute(const Node *node, const char *name, bool def = false);
+    static QString stringAttribute(const Node *node, const char *name);
+
+    QString internedAttribute(const Node *node, const char *name);
+
+    static bool toInt(const char *text, std::size_t size, int &value);
+    static bool toUInt(const char *text, std::size_t size, uint &value);
+    static bool toDouble(const char *text, std::size_t size, double &value);
+
+private:
+    void close();
+
+    QFile mFile;
+    uchar *mMapped;
+    QByteArray mBuffer;
+    rapidxml::xml_document<> mDocument;
+    QHash<QLatin1String, QString> mInterned;
+    QString mError;
+};
+
+} // namespace Gmx
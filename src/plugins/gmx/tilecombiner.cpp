@@ -0,0 +1,173 @@
+/*
+ * tilecombiner.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilecombiner.h"
+
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QBitArray>
+
+using namespace Tiled;
+using namespace Gmx;
+
+namespace {
+
+/**
+ * Cells that may be merged share a tileset and an anchor, the position the
+ * tileset image would have in the layer for the cell to line up with it.
+ */
+struct CellKey
+{
+    const Tileset *tileset = nullptr;
+    int anchorX = 0;
+    int anchorY = 0;
+
+    bool operator==(const CellKey &other) const
+    {
+        return tileset == other.tileset
+                && anchorX == other.anchorX
+                && anchorY == other.anchorY;
+    }
+};
+
+} // anonymous namespace
+
+TileCombiner::TileCombiner(Mode mode)
+    : mMode(mode)
+{
+}
+
+QVector<QRect> TileCombiner::combine(const TileLayer &layer, QSize cellSize) const
+{
+    const int width = layer.width();
+    const int height = layer.height();
+    const int cellCount = width * height;
+
+    QBitArray combinable(cellCount);
+    QBitArray visited(cellCount);
+    QVector<CellKey> keys(cellCount);
+
+    int nonEmpty = 0;
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const Cell &cell = layer.cellAt(x, y);
+            const Tile *tile = cell.tile();
+            if (!tile)
+                continue;
+
+            ++nonEmpty;
+
+            const Tileset *tileset = tile->tileset();
+            if (tileset->isCollection() || tileset->columnCount() <= 0)
+                continue;
+            if (tileset->margin() != 0 || tileset->tileSpacing() != 0)
+                continue;
+            if (tile->size() != cellSize)
+                continue;
+            if (cell.flippedHorizontally() || cell.flippedVertically())
+                continue;
+
+            const int index = x + y * width;
+            CellKey &key = keys[index];
+            key.tileset = tileset;
+            key.anchorX = tile->id() % tileset->columnCount() - x;
+            key.anchorY = tile->id() / tileset->columnCount() - y;
+            combinable.setBit(index);
+        }
+    }
+
+    QVector<QRect> rects;
+    rects.reserve(nonEmpty);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const int index = x + y * width;
+            if (visited.testBit(index))
+                continue;
+
+            if (!combinable.testBit(index)) {
+                if (layer.cellAt(x, y).tile())
+                    rects.append(QRect(x, y, 1, 1));
+                continue;
+            }
+
+            const CellKey &key = keys.at(index);
+            auto matches = [&](int cx, int cy) {
+                const int i = cx + cy * width;
+                return combinable.testBit(i) && !visited.testBit(i) && keys.at(i) == key;
+            };
+
+            // Length of the run of matching cells starting at (x, cy),
+            // looking no further than maxLength
+            auto runLength = [&](int cy, int maxLength) {
+                int length = 0;
+                while (length < maxLength && matches(x + length, cy))
+                    ++length;
+                return length;
+            };
+
+            int rectWidth = runLength(y, width - x);
+            int rectHeight = 1;
+
+            if (mMode == Fast) {
+                while (y + rectHeight < height
+                       && runLength(y + rectHeight, rectWidth) == rectWidth)
+                    ++rectHeight;
+            } else {
+                // The run on each row limits the width of the rows below,
+                // so this finds the largest rectangle with its top-left
+                // corner at this cell
+                int bestArea = rectWidth;
+                int maxWidth = rectWidth;
+
+                for (int rows = 2; y + rows - 1 < height; ++rows) {
+                    maxWidth = runLength(y + rows - 1, maxWidth);
+                    if (maxWidth == 0)
+                        break;
+
+                    const int area = maxWidth * rows;
+                    if (area > bestArea) {
+                        bestArea = area;
+                        rectWidth = maxWidth;
+                        rectHeight = rows;
+                    }
+                }
+            }
+
+            for (int cy = y; cy < y + rectHeight; ++cy)
+                visited.fill(true, x + cy * width, x + rectWidth + cy * width);
+
+            rects.append(QRect(x, y, rectWidth, rectHeight));
+        }
+    }
+
+    return rects;
+}
+
+TileCombiner::Mode TileCombiner::modeFromString(const QString &mode, Mode def)
+{
+    if (mode.compare(QLatin1String("fast"), Qt::CaseInsensitive) == 0)
+        return Fast;
+    if (mode.compare(QLatin1String("optimal"), Qt::CaseInsensitive) == 0)
+        return Optimal;
+    return def;
+}
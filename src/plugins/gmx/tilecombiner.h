@@ -0,0 +1,67 @@
+/*
+ * tilecombiner.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+namespace Tiled {
+class TileLayer;
+}
+
+namespace Gmx {
+
+/**
+ * Merges the cells of a tile layer into as few GameMaker tiles as possible.
+ *
+ * A GameMaker tile is a rectangular region of a background, so neighbouring
+ * cells can only be merged when they show neighbouring tiles of the same
+ * tileset, laid out in the layer the same way as in the tileset image.
+ */
+class TileCombiner
+{
+public:
+    enum Mode {
+        Fast,       // Extends each rectangle to the right, then down
+        Optimal     // Picks the largest rectangle starting at each cell
+    };
+
+    explicit TileCombiner(Mode mode = Optimal);
+
+    Mode mode() const { return mMode; }
+    void setMode(Mode mode) { mMode = mode; }
+
+    /**
+     * Returns the rectangles, in cells, that cover all non-empty cells of
+     * \a layer, ordered by their top-left cell. Only unflipped cells of
+     * \a cellSize from tilesets without margin or spacing are merged, all
+     * other cells end up in a rectangle of their own.
+     */
+    QVector<QRect> combine(const Tiled::TileLayer &layer, QSize cellSize) const;
+
+    static Mode modeFromString(const QString &mode, Mode def = Optimal);
+
+private:
+    Mode mMode;
+};
+
+} // namespace Gmx
@@ -233,7 +233,12 @@ void LuaWriter::writeMap(LuaTableWriter &writer, const Map *map)
     }
     writer.writeEndTable();
 
-    writeLayers(writer, map->layers(), map->layerDataFormat());
+    // Lua map loaders generally only support zlib and gzip compression
+    Map::LayerDataFormat format = map->layerDataFormat();
+    if (format == Map::Base64Zstandard)
+        format = Map::Base64Zlib;
+
+    writeLayers(writer, map->layers(), format);
 
     writer.writeEndTable();
 }
@@ -460,7 +465,8 @@ void LuaWriter::writeTileLayer(LuaTableWriter &writer,
 
     case Map::Base64:
     case Map::Base64Zlib:
-    case Map::Base64Gzip: {
+    case Map::Base64Gzip:
+    case Map::Base64Zstandard: {
         writer.writeKeyAndValue("encoding", "base64");
 
         if (format == Map::Base64Zlib)
@@ -518,7 +524,8 @@ void LuaWriter::writeTileLayerData(LuaTableWriter &writer,
 
     case Map::Base64:
     case Map::Base64Zlib:
-    case Map::Base64Gzip: {
+    case Map::Base64Gzip:
+    case Map::Base64Zstandard: {
         QByteArray layerData = mGidMapper.encodeLayerData(*tileLayer, format, bounds);
         writer.writeKeyAndValue("data", layerData);
         break;
@@ -37,9 +37,15 @@
 #include "tilelayer.h"
 
 #include <QDebug>
+#include <QHash>
+#include <QThread>
+#include <QtConcurrentMap>
 
 #include "qtcompat_p.h"
 
+#include <algorithm>
+#include <climits>
+
 using namespace Tiled;
 using namespace Tiled::Internal;
 
@@ -364,6 +370,8 @@ bool AutoMapper::prepareAutoMap()
     if (!setupTilesets())
         return false;
 
+    compileRules();
+
     return true;
 }
 
@@ -438,25 +446,80 @@ bool AutoMapper::setupTilesets()
     return true;
 }
 
-void AutoMapper::autoMap(QRegion *where)
+namespace Tiled {
+
+static uint qHash(const Cell &cell, uint seed = 0) Q_DECL_NOTHROW
 {
-    Q_ASSERT(mRulesInput.size() == mRulesOutput.size());
-    // first resize the active area
-    if (mAutoMappingRadius) {
-        QRegion region;
+    // Only the visual flags take part in the comparison of cells
+    const int flags = (cell.flippedHorizontally() ? 1 : 0)
+            | (cell.flippedVertically() ? 2 : 0)
+            | (cell.flippedAntiDiagonally() ? 4 : 0)
+            | (cell.rotatedHexagonal120() ? 8 : 0);
+
+    return ::qHash(cell.tileset(), seed) ^ ::qHash(cell.tileId() << 4 | flags, seed);
+}
+
+namespace Internal {
+
+struct AutoMapper::MatchContext
+{
+    MatchContext()
+        : emptyLayer(QString(), 0, 0, 0, 0)
+        , inParallel(false)
+        , changed(nullptr)
+    {}
+
+    TileLayer emptyLayer;                   // stands in for missing layers
+    QVector<const TileLayer*> setLayers;    // for each of mSetLayerNames
+    bool inParallel;
+
+    // Collects the changes when automapping incrementally
+    ChangedRegions *changed;
+
+    // Maps the cells of each set layer to their positions. These are only
+    // built when matching in parallel, since the set layers don't change
+    // while automapping in that case.
+    QVector<QHash<Cell, QVector<QPoint>>> anchorIndexes;
+    QVector<bool> anchorIndexBuilt;
+    QRect indexedArea;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+static QRegion expandedRegion(const QRegion &region, int radius)
+{
+    if (!radius)
+        return region;
+
+    QRegion result;
 #if QT_VERSION < 0x050800
-        const auto rects = where->rects();
-        for (const QRect &r : rects) {
+    const auto rects = region.rects();
+    for (const QRect &r : rects)
 #else
-        for (const QRect &r : *where) {
+    for (const QRect &r : region)
 #endif
-            region += r.adjusted(- mAutoMappingRadius,
-                                 - mAutoMappingRadius,
-                                 + mAutoMappingRadius,
-                                 + mAutoMappingRadius);
-        }
-        where->swap(region);
+        result += r.adjusted(-radius, -radius, radius, radius);
+    return result;
+}
+
+void AutoMapper::invalidateSpatialIndexes()
+{
+    for (Map *map : { mMapWork, mMapRules }) {
+        LayerIterator iterator(map, Layer::ObjectGroupType);
+        while (Layer *layer = iterator.next())
+            static_cast<ObjectGroup*>(layer)->invalidateSpatialIndex();
     }
+}
+
+void AutoMapper::autoMap(QRegion *where)
+{
+    Q_ASSERT(mRulesInput.size() == mRulesOutput.size());
+    invalidateSpatialIndexes();
+
+    // first resize the active area
+    if (mAutoMappingRadius)
+        *where = expandedRegion(*where, mAutoMappingRadius);
 
     // delete all the relevant area, if the property "DeleteTiles" is set
     if (mDeleteTiles) {
@@ -477,6 +540,13 @@ void AutoMapper::autoMap(QRegion *where)
         }
     }
 
+    // The same seed is used each time, so that automapping the same region
+    // always picks the same random outputs
+    mRandomEngine.seed(std::default_random_engine::default_seed);
+
+    MatchContext context;
+    setupMatchContext(context, where->boundingRect());
+
     // Increase the given region where the next automapper should work.
     // This needs to be done, so you can rely on the order of the rules at all
     // locations
@@ -487,16 +557,107 @@ void AutoMapper::autoMap(QRegion *where)
 #else
     for (const QRect &rect : *where) {
 #endif
-        for (int i = 0; i < mRulesInput.size(); ++i) {
-            // at the moment the parallel execution does not work yet
-            // TODO: make multithreading available!
-            // either by dividing the rules or the region to multiple threads
-            ret = ret.united(applyRule(i, rect));
-        }
+        for (int i = 0; i < mRulesInput.size(); ++i)
+            ret = ret.united(applyRule(i, rect, context));
     }
     *where = where->united(ret);
 }
 
+void AutoMapper::autoMap(ChangedRegions &changed)
+{
+    Q_ASSERT(mRulesInput.size() == mRulesOutput.size());
+    invalidateSpatialIndexes();
+
+    // Deleting the tiles and avoiding overlaps both rely on remapping the
+    // whole area at once, so these rules are applied as usual
+    if (mDeleteTiles || mNoOverlappingRules) {
+        QRegion where;
+        for (const QRegion &region : qAsConst(changed))
+            where |= region;
+
+        autoMap(&where);
+
+        for (const QString &name : qAsConst(mTouchedTileLayers))
+            changed[name] |= where;
+        return;
+    }
+
+    if (mAppliedRules.size() != mRulesInput.size()) {
+        mAppliedRules.clear();
+        mAppliedRules.resize(mRulesInput.size());
+    }
+
+    mRandomEngine.seed(std::default_random_engine::default_seed);
+
+    QRegion setLayersChanged;
+    for (const QString &name : qAsConst(mSetLayerNames))
+        setLayersChanged |= changed.value(name);
+
+    MatchContext context;
+    context.changed = &changed;
+    setupMatchContext(context, expandedRegion(setLayersChanged, mAutoMappingRadius).boundingRect());
+
+    // Each rule is checked only where any of the layers it reads from have
+    // changed, including the changes made by the rules before it
+    for (int i = 0; i < mRulesInput.size(); ++i) {
+        QRegion where;
+        for (int setLayer : mCompiledRules.at(i).setLayers)
+            where |= changed.value(mSetLayerNames.at(setLayer));
+
+        where = expandedRegion(where, mAutoMappingRadius);
+
+#if QT_VERSION < 0x050800
+        const auto rects = where.rects();
+        for (const QRect &rect : rects)
+#else
+        for (const QRect &rect : where)
+#endif
+            applyRule(i, rect, context);
+    }
+}
+
+void AutoMapper::setupMatchContext(MatchContext &context, const QRect &area) const
+{
+    context.inParallel = !outputAffectsInput();
+
+    for (const QString &name : qAsConst(mSetLayerNames)) {
+        const int index = mMapWork->indexOfLayer(name, Layer::TileLayerType);
+        context.setLayers.append(index >= 0 ? mMapWork->layerAt(index)->asTileLayer()
+                                            : &context.emptyLayer);
+    }
+    context.anchorIndexes.resize(mSetLayerNames.size());
+
+    // The anchor cells are looked up in the area where any rule could touch
+    // a cell overlapping the given area
+    const int maxWidth = qMax(0, mMaxRuleSize.width() - 1);
+    const int maxHeight = qMax(0, mMaxRuleSize.height() - 1);
+    context.indexedArea = area.adjusted(-maxWidth, -maxHeight,
+                                        2 * maxWidth, 2 * maxHeight);
+}
+
+/**
+ * Returns whether any of the output layers is also compared against by the
+ * input layers. In that case, a rule may match differently depending on
+ * where it has already been applied, so the positions need to be checked
+ * in order.
+ */
+bool AutoMapper::outputAffectsInput() const
+{
+    QSet<int> inputIndexes;
+    for (const QString &name : qAsConst(mInputRules.names)) {
+        const int index = mMapWork->indexOfLayer(name, Layer::TileLayerType);
+        if (index != -1)
+            inputIndexes.insert(index);
+    }
+
+    for (const RuleOutput &translationTable : qAsConst(mLayerList))
+        for (const int index : translationTable)
+            if (inputIndexes.contains(index))
+                return true;
+
+    return false;
+}
+
 QRegion AutoMapper::computeSetLayersRegion() const
 {
     QRegion result;
@@ -598,81 +759,276 @@ static void collectCellsInRegion(const QVector<InputLayer> &list,
  * If all positions are considered good, return true.
  * return false otherwise.
  *
- * @return bool, if the tile layer matches the given list of layers.
+ * The rules are compiled to a list of positions with the cells allowed and
+ * disallowed at each of them, so that the rule map doesn't need to be
+ * looked at while matching. See compileRules() and conditionMatches().
  */
-static bool layerMatchesConditions(const TileLayer &setLayer,
-                                   const InputConditions &conditions,
-                                   const QRegion &ruleRegion,
-                                   const QPoint &offset)
-{
-    const auto &listYes = conditions.listYes;
-    const auto &listNo = conditions.listNo;
-    if (listYes.isEmpty() && listNo.isEmpty())
-        return false;
+void AutoMapper::compileRules()
+{
+    mCompiledRules.clear();
+    mSetLayerNames.clear();
+    mMaxRuleSize = QSize();
+
+    for (const QRegion &ruleInputRegion : qAsConst(mRulesInput)) {
+        CompiledRule rule;
+        mMaxRuleSize = mMaxRuleSize.expandedTo(ruleInputRegion.boundingRect().size());
+
+        for (const InputIndex &inputIndex : qAsConst(mInputRules)) {
+            QVector<CompiledCondition> conditions;
+            bool neverMatches = false;
+
+            int anchor = -1;
+            int anchorChoices = INT_MAX;
 
-    QVarLengthArray<Cell, 8> cells;
-    if (listNo.isEmpty())
-        collectCellsInRegion(listYes, ruleRegion, cells);
+            for (auto it = inputIndex.begin(), end = inputIndex.end(); it != end; ++it) {
+                const InputConditions &input = it.value();
+                const auto &listYes = input.listYes;
+                const auto &listNo = input.listNo;
+
+                if (listYes.isEmpty() && listNo.isEmpty()) {
+                    neverMatches = true;
+                    break;
+                }
+
+                CompiledCondition condition;
+                condition.setLayer = mSetLayerNames.indexOf(it.key());
+                if (condition.setLayer == -1) {
+                    condition.setLayer = mSetLayerNames.size();
+                    mSetLayerNames.append(it.key());
+                }
+                condition.hasListNo = !listNo.isEmpty();
+
+                if (!condition.hasListNo) {
+                    QVarLengthArray<Cell, 8> usedCells;
+                    collectCellsInRegion(listYes, ruleInputRegion, usedCells);
+                    condition.usedCells.reserve(usedCells.size());
+                    for (const Cell &cell : usedCells)
+                        condition.usedCells.append(cell);
+                }
+
+                int bestPosition = -1;
+                int bestChoices = INT_MAX;
+                bool bestCanAnchor = false;
 
 #if QT_VERSION < 0x050800
-    const auto rects = ruleRegion.rects();
-    for (const QRect &rect : rects) {
+                const auto rects = ruleInputRegion.rects();
+                for (const QRect &rect : rects) {
 #else
-    for (const QRect &rect : ruleRegion) {
+                for (const QRect &rect : ruleInputRegion) {
 #endif
-        for (int x = rect.left(); x <= rect.right(); ++x) {
-            for (int y = rect.top(); y <= rect.bottom(); ++y) {
-                const Cell &setCell = setLayer.cellAt(x + offset.x(),
-                                                      y + offset.y());
-
-                // First check listNo. If any tile matches there, we can
-                // immediately know there is no match.
-                for (const InputLayer &inputNotLayer : listNo) {
-                    const Cell &noCell = inputNotLayer.tileLayer->cellAt(x, y);
-                    if ((inputNotLayer.strictEmpty || !noCell.isEmpty()) && setCell == noCell)
-                        return false;
-                }
-
-                // ruleDefinedListYes will be set when there is a tile in at
-                // least one layer. If there is a tile in at least one layer,
-                // only the given tiles in the different listYes layers are
-                // valid. Otherwise, consider all tiles not used elsewhere in
-                // the input as valid.
-                bool ruleDefinedListYes = false;
-                bool matchListYes = false;
-
-                for (const InputLayer &inputLayer : listYes) {
-                    const Cell &yesCell = inputLayer.tileLayer->cellAt(x, y);
-                    if (inputLayer.strictEmpty || !yesCell.isEmpty()) {
-                        ruleDefinedListYes = true;
-                        if (setCell == yesCell) {
-                            matchListYes = true;
-                            break;
+                    for (int x = rect.left(); x <= rect.right(); ++x) {
+                        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+                            CompiledCondition::Position position;
+                            position.pos = QPoint(x, y);
+
+                            position.noBegin = condition.cells.size();
+                            for (const InputLayer &inputNotLayer : listNo) {
+                                const Cell noCell = inputNotLayer.tileLayer->cellAt(x, y);
+                                if (inputNotLayer.strictEmpty || !noCell.isEmpty())
+                                    condition.cells.append(noCell);
+                            }
+                            position.noEnd = condition.cells.size();
+
+                            bool canAnchor = true;
+                            position.yesBegin = condition.cells.size();
+                            for (const InputLayer &inputLayer : listYes) {
+                                const Cell yesCell = inputLayer.tileLayer->cellAt(x, y);
+                                if (inputLayer.strictEmpty || !yesCell.isEmpty()) {
+                                    condition.cells.append(yesCell);
+                                    canAnchor &= !yesCell.isEmpty();
+                                }
+                            }
+                            position.yesEnd = condition.cells.size();
+
+                            // Prefer positions that allow only a few cells,
+                            // since they reject most quickly
+                            const int choices = position.yesEnd - position.yesBegin;
+                            canAnchor &= choices > 0;
+                            if (choices > 0 && (canAnchor > bestCanAnchor ||
+                                                (canAnchor == bestCanAnchor && choices < bestChoices))) {
+                                bestPosition = condition.positions.size();
+                                bestChoices = choices;
+                                bestCanAnchor = canAnchor;
+                            }
+
+                            condition.positions.append(position);
                         }
                     }
                 }
 
-                if (!ruleDefinedListYes) {
-                    // if there were only layers in the listYes, check the exception
-                    if (listNo.isEmpty() && cells.contains(setCell))
-                        return false;
-                } else if (!matchListYes) {
-                    return false;
+                if (bestPosition > 0)
+                    std::swap(condition.positions[0], condition.positions[bestPosition]);
+
+                if (bestCanAnchor && bestChoices < anchorChoices) {
+                    anchor = conditions.size();
+                    anchorChoices = bestChoices;
                 }
+
+                conditions.append(condition);
             }
+
+            if (neverMatches)
+                continue;
+
+            for (const CompiledCondition &condition : qAsConst(conditions))
+                if (!rule.setLayers.contains(condition.setLayer))
+                    rule.setLayers.append(condition.setLayer);
+
+            rule.inputIndexes.append(conditions);
+            rule.anchors.append(anchor);
         }
+
+        mCompiledRules.append(rule);
+    }
+}
+
+/**
+ * Returns whether \a setLayer matches \a condition when the rule is placed
+ * at \a offset.
+ *
+ * This only reads from the layer, so it can be called from multiple threads
+ * as long as the layer is not changed meanwhile.
+ */
+static bool conditionMatches(const CompiledCondition &condition,
+                             const TileLayer &setLayer,
+                             QPoint offset)
+{
+    const Cell *cells = condition.cells.constData();
+
+    for (const CompiledCondition::Position &position : condition.positions) {
+        const Cell setCell = setLayer.cellAt(position.pos + offset);
+
+        // First check listNo. If any tile matches there, we can
+        // immediately know there is no match.
+        for (int i = position.noBegin; i < position.noEnd; ++i)
+            if (setCell == cells[i])
+                return false;
+
+        if (position.yesBegin == position.yesEnd) {
+            // if there were only layers in the listYes, check the exception
+            if (!condition.hasListNo && condition.usedCells.contains(setCell))
+                return false;
+            continue;
+        }
+
+        bool matchListYes = false;
+        for (int i = position.yesBegin; i < position.yesEnd; ++i) {
+            if (setCell == cells[i]) {
+                matchListYes = true;
+                break;
+            }
+        }
+
+        if (!matchListYes)
+            return false;
     }
 
     return true;
 }
 
-QRect AutoMapper::applyRule(int ruleIndex, const QRect &where)
+static bool ruleMatches(const CompiledRule &rule,
+                        const QVector<const TileLayer*> &setLayers,
+                        QPoint offset)
+{
+    for (const auto &conditions : rule.inputIndexes) {
+        bool allLayerNamesMatch = true;
+
+        for (const CompiledCondition &condition : conditions) {
+            if (!conditionMatches(condition, *setLayers.at(condition.setLayer), offset)) {
+                allLayerNamesMatch = false;
+                break;
+            }
+        }
+
+        if (allLayerNamesMatch)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Collects the offsets within \a offsets where the anchor of any of the
+ * input indexes of \a rule is found in its set layer. The rule can't match
+ * anywhere else.
+ *
+ * Returns false when any of the input indexes has no anchor, in which case
+ * all offsets need to be checked.
+ */
+bool AutoMapper::anchorCandidates(const CompiledRule &rule,
+                                  const QRect &offsets,
+                                  MatchContext &context,
+                                  QVector<QPoint> &candidates) const
+{
+    for (int anchor : rule.anchors)
+        if (anchor == -1)
+            return false;
+
+    if (context.anchorIndexBuilt.isEmpty())
+        context.anchorIndexBuilt.fill(false, mSetLayerNames.size());
+
+    for (int i = 0; i < rule.inputIndexes.size(); ++i) {
+        const CompiledCondition &condition = rule.inputIndexes.at(i).at(rule.anchors.at(i));
+        const CompiledCondition::Position &position = condition.positions.first();
+
+        auto &index = context.anchorIndexes[condition.setLayer];
+        if (!context.anchorIndexBuilt.at(condition.setLayer)) {
+            const TileLayer *setLayer = context.setLayers.at(condition.setLayer);
+            const QRect area = context.indexedArea.intersected(setLayer->bounds()
+                                                               .translated(-setLayer->position()));
+
+            for (int y = area.top(); y <= area.bottom(); ++y) {
+                for (int x = area.left(); x <= area.right(); ++x) {
+                    const Cell cell = setLayer->cellAt(x, y);
+                    if (!cell.isEmpty())
+                        index[cell].append(QPoint(x, y));
+                }
+            }
+
+            context.anchorIndexBuilt[condition.setLayer] = true;
+        }
+
+        for (int c = position.yesBegin; c < position.yesEnd; ++c) {
+            const auto it = index.constFind(condition.cells.at(c));
+            if (it == index.constEnd())
+                continue;
+
+            for (const QPoint &cellPos : it.value()) {
+                const QPoint offset = cellPos - position.pos;
+                if (offsets.contains(offset))
+                    candidates.append(offset);
+            }
+        }
+    }
+
+    // Check the candidates in the same order as when checking all offsets
+    std::sort(candidates.begin(), candidates.end(), [] (QPoint a, QPoint b) {
+        return a.y() < b.y() || (a.y() == b.y() && a.x() < b.x());
+    });
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    return true;
+}
+
+namespace {
+
+struct MatchBand
+{
+    int begin;
+    int end;
+    QVector<QPoint> matches;
+};
+
+} // anonymous namespace
+
+QRect AutoMapper::applyRule(int ruleIndex, const QRect &where, MatchContext &context)
 {
     QRect ret;
 
     if (mLayerList.isEmpty())
         return ret;
 
+    const CompiledRule &rule = mCompiledRules.at(ruleIndex);
     const QRegion &ruleInputRegion = mRulesInput.at(ruleIndex);
     const QRegion &ruleOutputRegion = mRulesOutput.at(ruleIndex);
     const QRect rbr = ruleInputRegion.boundingRect();
@@ -694,85 +1050,211 @@ QRect AutoMapper::applyRule(int ruleIndex, const QRect &where)
     if (mNoOverlappingRules)
         appliedRegions.resize(mMapWork->layerCount());
 
-    const TileLayer dummy(QString(), 0, 0, 0, 0);
+    auto applyAt = [&] (QPoint offset) {
+        const int x = offset.x();
+        const int y = offset.y();
+
+        // When automapping incrementally, the rule may still be applied
+        // here from an earlier time
+        AppliedRule *applied = nullptr;
+        if (context.changed) {
+            QHash<QPoint, AppliedRule> &appliedRules = mAppliedRules[ruleIndex];
+            const auto it = appliedRules.constFind(offset);
+            if (it != appliedRules.constEnd() && isStillApplied(it.value()))
+                return;
+
+            applied = &appliedRules[offset];
+            applied->clear();
+        }
+
+        // choose by chance which group of rule_layers should be used:
+        std::uniform_int_distribution<int> dis(0, mLayerList.size() - 1);
+        const RuleOutput &translationTable = mLayerList.at(dis(mRandomEngine));
 
-    for (int y = minY; y <= maxY; ++y)
-    for (int x = minX; x <= maxX; ++x) {
-        bool anyMatch = false;
+        if (mNoOverlappingRules) {
+            const QList<Layer*> layers = translationTable.keys();
 
-        for (const InputIndex &inputIndex : qAsConst(mInputRules)) {
-            bool allLayerNamesMatch = true;
+            // check if there are no overlaps within this rule.
+            QVector<QRegion> ruleRegionInLayer;
+            for (int i = 0; i < layers.size(); ++i) {
+                Layer *layer = layers.at(i);
 
-            QMapIterator<QString, InputConditions> inputIndexIterator(inputIndex);
-            while (inputIndexIterator.hasNext()) {
-                inputIndexIterator.next();
+                QRegion appliedPlace;
 
-                const QString &name = inputIndexIterator.key();
-                const InputConditions &conditions = inputIndexIterator.value();
+                if (TileLayer *tileLayer = layer->asTileLayer())
+                    appliedPlace = tileLayer->region();
+                else if (ObjectGroup *objectGroup = layer->asObjectGroup())
+                    appliedPlace = tileRegionOfObjectGroup(objectGroup);
+                else
+                    continue;
 
-                const int i = mMapWork->indexOfLayer(name, Layer::TileLayerType);
-                const TileLayer &setLayer = (i >= 0) ? *mMapWork->layerAt(i)->asTileLayer() : dummy;
+                ruleRegionInLayer.append(appliedPlace.intersected(ruleOutputRegion));
 
-                if (!layerMatchesConditions(setLayer, conditions, ruleInputRegion, QPoint(x, y))) {
-                    allLayerNamesMatch = false;
-                    break;
-                }
+                if (appliedRegions.at(i).intersects(ruleRegionInLayer.at(i).translated(x, y)))
+                    return;
             }
 
-            if (allLayerNamesMatch) {
-                anyMatch = true;
-                break;
+            for (int i = 0; i < translationTable.size(); ++i)
+                appliedRegions[i] += ruleRegionInLayer.at(i).translated(x, y);
+        }
+
+        copyMapRegion(ruleOutputRegion, offset, translationTable, applied);
+        ret = ret.united(rbr.translated(offset));
+
+        if (applied) {
+            for (auto it = applied->cbegin(), end = applied->cend(); it != end; ++it) {
+                QRect written;
+                for (const WrittenCell &cell : it.value())
+                    written |= QRect(cell.pos, QSize(1, 1));
+                (*context.changed)[it.key()] |= written;
             }
         }
+    };
 
-        if (anyMatch) {
-            // choose by chance which group of rule_layers should be used:
-            const int r = qrand() % mLayerList.size();
-            const RuleOutput &translationTable = mLayerList.at(r);
+    const QRect offsets(QPoint(minX, minY), QPoint(maxX, maxY));
 
-            if (mNoOverlappingRules) {
-                bool overlap = false;
-                const QList<Layer*> layers = translationTable.keys();
+    if (context.changed)
+        undoUnmatchedRules(ruleIndex, offsets, context);
 
-                // check if there are no overlaps within this rule.
-                QVector<QRegion> ruleRegionInLayer;
-                for (int i = 0; i < layers.size(); ++i) {
-                    Layer *layer = layers.at(i);
+    // Either only the offsets where an anchor was found are checked, or all
+    // of them, in rows from top to bottom.
+    QVector<QPoint> candidates;
+    const bool useCandidates = context.inParallel &&
+            anchorCandidates(rule, offsets, context, candidates);
 
-                    QRegion appliedPlace;
+    const int width = offsets.width();
+    const int count = useCandidates ? candidates.size() : width * offsets.height();
 
-                    if (TileLayer *tileLayer = layer->asTileLayer())
-                        appliedPlace = tileLayer->region();
-                    else if (ObjectGroup *objectGroup = layer->asObjectGroup())
-                        appliedPlace = tileRegionOfObjectGroup(objectGroup);
-                    else
-                        continue;
+    auto offsetAt = [&] (int i) {
+        return useCandidates ? candidates.at(i)
+                             : QPoint(minX + i % width, minY + i / width);
+    };
 
-                    ruleRegionInLayer.append(appliedPlace.intersected(ruleOutputRegion));
+    if (!context.inParallel) {
+        for (int i = 0; i < count; ++i) {
+            const QPoint offset = offsetAt(i);
+            if (ruleMatches(rule, context.setLayers, offset))
+                applyAt(offset);
+        }
 
-                    if (appliedRegions.at(i).intersects(ruleRegionInLayer.at(i).translated(x, y))) {
-                        overlap = true;
-                        break;
-                    }
-                }
+        return ret;
+    }
+
+    // The output doesn't affect the input, so all matches can be found up
+    // front. The offsets are split into bands that are checked in parallel,
+    // after which the rule is applied to the matches in the same order as
+    // when checking one offset at a time.
+    const int bandCount = qBound(1, QThread::idealThreadCount() * 4, count);
+
+    QVector<MatchBand> bands(bandCount);
+    for (int i = 0; i < bandCount; ++i) {
+        bands[i].begin = int(qint64(count) * i / bandCount);
+        bands[i].end = int(qint64(count) * (i + 1) / bandCount);
+    }
+
+    const QVector<const TileLayer*> &setLayers = context.setLayers;
+
+    QtConcurrent::blockingMap(bands, [&] (MatchBand &band) {
+        for (int i = band.begin; i < band.end; ++i) {
+            const QPoint offset = offsetAt(i);
+            if (ruleMatches(rule, setLayers, offset))
+                band.matches.append(offset);
+        }
+    });
+
+    for (const MatchBand &band : qAsConst(bands))
+        for (const QPoint &match : band.matches)
+            applyAt(match);
+
+    return ret;
+}
+
+/**
+ * Returns whether all tiles written by \a applied are still there.
+ */
+bool AutoMapper::isStillApplied(const AppliedRule &applied) const
+{
+    for (auto it = applied.cbegin(), end = applied.cend(); it != end; ++it) {
+        const int index = mMapWork->indexOfLayer(it.key(), Layer::TileLayerType);
+        if (index == -1)
+            return false;
 
-                if (overlap)
+        const TileLayer *layer = mMapWork->layerAt(index)->asTileLayer();
+        for (const WrittenCell &cell : it.value())
+            if (layer->cellAt(cell.pos) != cell.after)
+                return false;
+    }
+
+    return true;
+}
+
+void AutoMapper::undoUnmatchedRules(int ruleIndex, const QRect &offsets,
+                                    MatchContext &context)
+{
+    QHash<QPoint, AppliedRule> &appliedRules = mAppliedRules[ruleIndex];
+    if (appliedRules.isEmpty())
+        return;
+
+    const CompiledRule &rule = mCompiledRules.at(ruleIndex);
+    QVector<QPoint> unmatched;
+
+    // Look up either the offsets or the applied rules, whichever are fewer
+    if (qint64(offsets.width()) * offsets.height() <= appliedRules.size()) {
+        for (int y = offsets.top(); y <= offsets.bottom(); ++y) {
+            for (int x = offsets.left(); x <= offsets.right(); ++x) {
+                const QPoint offset(x, y);
+                if (appliedRules.contains(offset) &&
+                        !ruleMatches(rule, context.setLayers, offset))
+                    unmatched.append(offset);
+            }
+        }
+    } else {
+        for (auto it = appliedRules.cbegin(), end = appliedRules.cend(); it != end; ++it) {
+            if (offsets.contains(it.key()) &&
+                    !ruleMatches(rule, context.setLayers, it.key()))
+                unmatched.append(it.key());
+        }
+
+        std::sort(unmatched.begin(), unmatched.end(), [] (QPoint a, QPoint b) {
+            return a.y() < b.y() || (a.y() == b.y() && a.x() < b.x());
+        });
+    }
+
+    for (const QPoint &offset : qAsConst(unmatched)) {
+        const AppliedRule applied = appliedRules.take(offset);
+
+        for (auto it = applied.cbegin(), end = applied.cend(); it != end; ++it) {
+            const int index = mMapWork->indexOfLayer(it.key(), Layer::TileLayerType);
+            if (index == -1)
+                continue;
+
+            TileLayer *layer = mMapWork->layerAt(index)->asTileLayer();
+            QRect restored;
+
+            for (const WrittenCell &cell : it.value()) {
+                // Leave alone the tiles that were changed since
+                if (layer->cellAt(cell.pos) != cell.after)
                     continue;
 
-                for (int i = 0; i < translationTable.size(); ++i)
-                    appliedRegions[i] += ruleRegionInLayer.at(i).translated(x, y);
+                // The tileset of the previous tile may have been removed
+                Cell before = cell.before;
+                if (!before.isEmpty() &&
+                        mMapWork->indexOfTileset(before.tileset()->sharedPointer()) == -1)
+                    before = Cell();
+
+                layer->setCell(cell.pos.x(), cell.pos.y(), before);
+                restored |= QRect(cell.pos, QSize(1, 1));
             }
 
-            copyMapRegion(ruleOutputRegion, QPoint(x, y), translationTable);
-            ret = ret.united(rbr.translated(QPoint(x, y)));
+            if (!restored.isEmpty())
+                (*context.changed)[it.key()] |= restored;
         }
     }
-
-    return ret;
 }
 
 void AutoMapper::copyMapRegion(const QRegion &region, QPoint offset,
-                               const RuleOutput &layerTranslation)
+                               const RuleOutput &layerTranslation,
+                               AppliedRule *applied)
 {
     for (auto it = layerTranslation.begin(), end = layerTranslation.end(); it != end; ++it) {
         Layer *from = it.key();
@@ -790,7 +1272,8 @@ void AutoMapper::copyMapRegion(const QRegion &region, QPoint offset,
                 copyTileRegion(fromTileLayer, rect.x(), rect.y(),
                                rect.width(), rect.height(),
                                toTileLayer,
-                               rect.x() + offset.x(), rect.y() + offset.y());
+                               rect.x() + offset.x(), rect.y() + offset.y(),
+                               applied ? &(*applied)[to->name()] : nullptr);
 
             } else if (ObjectGroup *fromObjectGroup = from->asObjectGroup()) {
                 ObjectGroup *toObjectGroup = to->asObjectGroup();
@@ -819,7 +1302,8 @@ void AutoMapper::copyMapRegion(const QRegion &region, QPoint offset,
 
 void AutoMapper::copyTileRegion(const TileLayer *srcLayer, int srcX, int srcY,
                                 int width, int height,
-                                TileLayer *dstLayer, int dstX, int dstY)
+                                TileLayer *dstLayer, int dstX, int dstY,
+                                QVector<WrittenCell> *written)
 {
     int startX = dstX;
     int startY = dstY;
@@ -841,6 +1325,13 @@ void AutoMapper::copyTileRegion(const TileLayer *srcLayer, int srcX, int srcY,
         for (int y = startY; y < endY; ++y) {
             const Cell &cell = srcLayer->cellAt(x + offsetX, y + offsetY);
             if (!cell.isEmpty()) {
+                if (written) {
+                    const Cell before = dstLayer->cellAt(x, y);
+                    if (before == cell)
+                        continue;
+                    written->append(WrittenCell { QPoint(x, y), before, cell });
+                }
+
                 // this is without graphics update, it's done afterwards for all
                 dstLayer->setCell(x, y, cell);
             }
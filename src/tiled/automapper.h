@@ -20,15 +20,22 @@
 
 #pragma once
 
+#include "tilelayer.h"
 #include "tileset.h"
 
+#include <QHash>
 #include <QList>
 #include <QMap>
+#include <QPoint>
 #include <QRegion>
 #include <QSet>
+#include <QSize>
 #include <QString>
+#include <QStringList>
 #include <QVector>
 
+#include <random>
+
 namespace Tiled {
 
 class Layer;
@@ -70,6 +77,65 @@ public:
     QString index;
 };
 
+// Maps layer names to the regions of the working map that changed
+typedef QHash<QString, QRegion> ChangedRegions;
+
+/**
+ * A tile written to the working map by applying a rule.
+ */
+struct WrittenCell
+{
+    QPoint pos;
+    Cell before;
+    Cell after;
+};
+
+/**
+ * The tiles written by applying a rule at one position, by layer name. These
+ * are remembered when automapping incrementally, so the rule can be undone
+ * once it no longer matches there.
+ */
+typedef QMap<QString, QVector<WrittenCell>> AppliedRule;
+
+/**
+ * The conditions one input index places on one layer of the working map,
+ * flattened into the cells expected at each position of a rule.
+ */
+struct CompiledCondition
+{
+    struct Position
+    {
+        QPoint pos;
+        int noBegin;        // range of "inputnot" cells in cells
+        int noEnd;
+        int yesBegin;       // range of "input" cells in cells
+        int yesEnd;
+    };
+
+    int setLayer;                   // index into the names of the set layers
+    bool hasListNo;
+    QVector<Position> positions;    // the most selective position comes first
+    QVector<Cell> cells;
+    QVector<Cell> usedCells;        // all "input" cells, when there is no "inputnot" layer
+};
+
+/**
+ * A rule compiled for matching. It matches when all conditions of any of
+ * its input indexes match.
+ */
+struct CompiledRule
+{
+    QVector<QVector<CompiledCondition>> inputIndexes;
+
+    // For each input index, the condition whose first position is an anchor:
+    // a position where the set layer has to contain one of a few non-empty
+    // cells. -1 when the input index has no such position.
+    QVector<int> anchors;
+
+    // The set layers read by any of the input indexes
+    QVector<int> setLayers;
+};
+
 
 /**
  * This class does all the work for the automapping feature.
@@ -124,6 +190,17 @@ public:
      */
     void autoMap(QRegion *where);
 
+    /**
+     * Automaps incrementally, after the layers of the working map changed
+     * in the given regions. Each rule is only checked where one of the
+     * layers it reads from changed, and rules applied by an earlier call
+     * are undone where they no longer match.
+     *
+     * The regions changed by this automapper are added to \a changed, so
+     * the following automappers see the impact.
+     */
+    void autoMap(ChangedRegions &changed);
+
     /**
      * This cleans all data structures, which are setup via prepareAutoMap,
      * so the auto mapper becomes ready for its next automatic mapping.
@@ -201,10 +278,13 @@ private:
      * if there is no tile in src TileLayer, there will nothing be copied,
      * so the maybe existing tile in dst will not be overwritten.
      *
+     * The tiles that got changed in dst are appended to \a written, when
+     * given.
      */
     void copyTileRegion(const TileLayer *srcLayer, int srcX, int srcY,
                         int width, int height, TileLayer *dstLayer,
-                        int dstX, int dstY);
+                        int dstX, int dstY,
+                        QVector<WrittenCell> *written = nullptr);
 
     /**
      * This copies all objects from the \a src_lr ObjectGroup to the \a dst_lr
@@ -225,9 +305,26 @@ private:
      * In the destination it will come to the region translated by Offset.
      * The parameter \a LayerTranslation is a map of which layers of the rulesmap
      * should get copied into which layers of the working map.
+     * The tiles that got changed are recorded in \a applied, when given.
      */
     void copyMapRegion(const QRegion &region, QPoint Offset,
-                       const RuleOutput &LayerTranslation);
+                       const RuleOutput &LayerTranslation,
+                       AppliedRule *applied = nullptr);
+
+    struct MatchContext;
+
+    /**
+     * Looks up the set layers in the working map and prepares the context
+     * for matching rules that touch \a area.
+     */
+    void setupMatchContext(MatchContext &context, const QRect &area) const;
+
+    /**
+     * Drops the spatial indexes of the object groups in the working and
+     * rules maps, since the tilesets and templates they depend on may have
+     * changed since the previous run.
+     */
+    void invalidateSpatialIndexes();
 
     /**
      * This goes through all the positions of the mMapWork and checks if
@@ -235,9 +332,32 @@ private:
      * if there is a match all Layers are copied to mMapWork.
      * @param ruleIndex: the region which should be compared to all positions
      *              of mMapWork will be looked up in mRulesInput and mRulesOutput
+     * @param context: the layers to match against, and the anchor cell
+     *              indexes when the positions may be checked in parallel
      * @return where: an rectangle where the rule actually got applied
      */
-    QRect applyRule(int ruleIndex, const QRect &where);
+    QRect applyRule(int ruleIndex, const QRect &where, MatchContext &context);
+
+    bool anchorCandidates(const CompiledRule &rule, const QRect &offsets,
+                          MatchContext &context, QVector<QPoint> &candidates) const;
+
+    /**
+     * Undoes the earlier applications of the rule at \a ruleIndex at
+     * \a offsets, where the rule no longer matches.
+     */
+    void undoUnmatchedRules(int ruleIndex, const QRect &offsets,
+                            MatchContext &context);
+
+    bool isStillApplied(const AppliedRule &applied) const;
+
+    bool outputAffectsInput() const;
+
+    /**
+     * Compiles the input of each rule into mCompiledRules. This needs to be
+     * done after setupTilesets(), since that may change the tilesets the
+     * cells of the rules map refer to.
+     */
+    void compileRules();
 
     /**
      * Cleans up the data structures filled by setupRuleMapLayers(),
@@ -316,6 +436,27 @@ private:
      */
     QVector<QRegion> mRulesOutput;
 
+    /**
+     * The input of each rule in mRulesInput, compiled by compileRules().
+     */
+    QVector<CompiledRule> mCompiledRules;
+
+    /**
+     * The names of the layers in the working map the rules compare against.
+     */
+    QStringList mSetLayerNames;
+
+    /**
+     * The size of the largest rule input.
+     */
+    QSize mMaxRuleSize;
+
+    /**
+     * For each rule, the positions where it was applied while automapping
+     * incrementally, with the tiles it wrote there.
+     */
+    QVector<QHash<QPoint, AppliedRule>> mAppliedRules;
+
     /**
      * The inner set with layers to indexes is needed for translating
      * tile layers from mMapRules to mMapWork.
@@ -359,6 +500,12 @@ private:
     QSet<QString> mTouchedTileLayers;
     QSet<QString> mTouchedObjectGroups;
 
+    /**
+     * Picks between the different translation tables in mLayerList. It is
+     * reseeded for each autoMap() call, so the result is reproducible.
+     */
+    std::default_random_engine mRandomEngine;
+
     QString mError;
     QString mWarning;
 };
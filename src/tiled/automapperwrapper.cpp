@@ -32,7 +32,8 @@ using namespace Tiled::Internal;
 
 AutoMapperWrapper::AutoMapperWrapper(MapDocument *mapDocument,
                                      QVector<AutoMapper*> autoMapper,
-                                     QRegion *where)
+                                     QRegion *where,
+                                     Layer *touchedLayer)
 {
     mMapDocument = mapDocument;
     Map *map = mMapDocument->map();
@@ -54,8 +55,16 @@ AutoMapperWrapper::AutoMapperWrapper(MapDocument *mapDocument,
         mLayersBefore.append(static_cast<TileLayer*>(map->layerAt(layerIndex)->clone()));
     }
 
-    for (AutoMapper *a : autoMapper)
-        a->autoMap(where);
+    if (touchedLayer) {
+        ChangedRegions changed;
+        changed.insert(touchedLayer->name(), *where);
+
+        for (AutoMapper *a : autoMapper)
+            a->autoMap(changed);
+    } else {
+        for (AutoMapper *a : autoMapper)
+            a->autoMap(where);
+    }
 
     int beforeIndex = 0;
     for (const QString &layerName : qAsConst(touchedLayers)) {
@@ -75,13 +84,14 @@ AutoMapperWrapper::AutoMapperWrapper(MapDocument *mapDocument,
         if (flags)
             emit mMapDocument->tileLayerChanged(after, flags);
 
-        // reduce memory usage by saving only diffs
+        // reduce memory usage by saving only the chunks that differ, which
+        // are shared with the layer rather than copied
         QRect diffRegion = before->computeDiffRegion(after).boundingRect();
-        TileLayer *before1 = before->copy(diffRegion);
-        TileLayer *after1 = after->copy(diffRegion);
+        TileLayer *before1 = before->copyChunks(diffRegion);
+        TileLayer *after1 = after->copyChunks(diffRegion);
 
-        before1->setPosition(diffRegion.topLeft());
-        after1->setPosition(diffRegion.topLeft());
+        before1->setPosition(before1->position() + after->position());
+        after1->setPosition(after1->position() + after->position());
         before1->setName(before->name());
         after1->setName(after->name());
         mLayersBefore.replace(beforeIndex, before1);
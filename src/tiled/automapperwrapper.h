@@ -37,12 +37,15 @@ class MapDocument;
  * is provided.
  * This class will take a snapshot of the layers before and after the
  * automapping is done. In between instances of AutoMapper are doing the work.
+ *
+ * When a \a touchedLayer is given, the automapping is incremental: only the
+ * rules depending on the changes to that layer within \a where are updated.
  */
 class AutoMapperWrapper : public QUndoCommand
 {
 public:
     AutoMapperWrapper(MapDocument *mapDocument, QVector<AutoMapper*> autoMapper,
-                      QRegion *where);
+                      QRegion *where, Layer *touchedLayer = nullptr);
     ~AutoMapperWrapper() override;
 
     void undo() override;
@@ -118,9 +118,12 @@ void AutomappingManager::autoMapInternal(const QRegion &where,
         // following automappers do see the impact
         QRegion region(where);
 
+        // When automapping while drawing, only the rules depending on the
+        // touched layer are updated
         QUndoStack *undoStack = mMapDocument->undoStack();
         undoStack->beginMacro(tr("Apply AutoMap rules"));
-        AutoMapperWrapper *aw = new AutoMapperWrapper(mMapDocument, passedAutoMappers, &region);
+        AutoMapperWrapper *aw = new AutoMapperWrapper(mMapDocument, passedAutoMappers,
+                                                      &region, touchedLayer);
         undoStack->push(aw);
         undoStack->endMacro();
     }
@@ -27,7 +27,9 @@
 #include "maprenderer.h"
 #include "objectgroup.h"
 
+#include <QPolygonF>
 #include <QUndoStack>
+#include <QVector>
 
 namespace Tiled {
 namespace Internal {
@@ -37,8 +39,24 @@ void eraseRegionObjectGroup(MapDocument *mapDocument,
                             const QRegion &where)
 {
     QUndoStack *undo = mapDocument->undoStack();
+    const MapRenderer *renderer = mapDocument->renderer();
 
-    const auto objects = layer->objects();
+    // Only objects near the region can overlap it, so look up the objects
+    // around the region in pixels. The margin makes up for renderers that
+    // don't map tiles to pixels linearly.
+    const QRect tileBounds = where.boundingRect().adjusted(-2, -2, 2, 2);
+    const qreal left = tileBounds.left();
+    const qreal top = tileBounds.top();
+    const qreal right = tileBounds.left() + tileBounds.width();
+    const qreal bottom = tileBounds.top() + tileBounds.height();
+
+    QPolygonF pixelBounds;
+    pixelBounds << renderer->tileToPixelCoords(left, top)
+                << renderer->tileToPixelCoords(right, top)
+                << renderer->tileToPixelCoords(right, bottom)
+                << renderer->tileToPixelCoords(left, bottom);
+
+    const auto objects = layer->objectsIntersecting(pixelBounds.boundingRect());
     for (MapObject *obj : objects) {
         // TODO: we are checking bounds, which is only correct for rectangles and
         // tile objects. polygons and polylines are not covered correctly by this
@@ -47,10 +65,10 @@ void eraseRegionObjectGroup(MapDocument *mapDocument,
 
         // Convert the boundary of the object into tile space
         const QRectF objBounds = obj->boundsUseTile();
-        QPointF tl = mapDocument->renderer()->pixelToTileCoords(objBounds.topLeft());
-        QPointF tr = mapDocument->renderer()->pixelToTileCoords(objBounds.topRight());
-        QPointF br = mapDocument->renderer()->pixelToTileCoords(objBounds.bottomRight());
-        QPointF bl = mapDocument->renderer()->pixelToTileCoords(objBounds.bottomLeft());
+        QPointF tl = renderer->pixelToTileCoords(objBounds.topLeft());
+        QPointF tr = renderer->pixelToTileCoords(objBounds.topRight());
+        QPointF br = renderer->pixelToTileCoords(objBounds.bottomRight());
+        QPointF bl = renderer->pixelToTileCoords(objBounds.bottomLeft());
 
         QRectF objInTileSpace;
         objInTileSpace.setTopLeft(tl);
@@ -66,21 +84,41 @@ void eraseRegionObjectGroup(MapDocument *mapDocument,
 
 QRegion tileRegionOfObjectGroup(const ObjectGroup *layer)
 {
-    QRegion ret;
+    QVector<QRegion> regions;
+    regions.reserve(layer->objectCount());
+
     for (MapObject *obj : layer->objects()) {
         // TODO: we are using bounds, which is only correct for rectangles and
         // tile objects. polygons and polylines are not probably covering less
         // tiles.
-        ret += obj->bounds().toAlignedRect();
+        regions.append(obj->bounds().toAlignedRect());
     }
-    return ret;
+
+    // Unite the regions pairwise, which keeps the intermediate regions small
+    // compared to adding every rect to a single growing region
+    while (regions.size() > 1) {
+        QVector<QRegion> united;
+        united.reserve((regions.size() + 1) / 2);
+
+        for (int i = 0; i + 1 < regions.size(); i += 2)
+            united.append(regions.at(i).united(regions.at(i + 1)));
+        if (regions.size() % 2)
+            united.append(regions.last());
+
+        regions.swap(united);
+    }
+
+    return regions.isEmpty() ? QRegion() : regions.first();
 }
 
 const QList<MapObject*> objectsInRegion(const ObjectGroup *layer,
                                         const QRegion &where)
 {
+    // The margin covers the rounding done by toAlignedRect below
+    const QRectF area = QRectF(where.boundingRect()).adjusted(-1, -1, 1, 1);
+
     QList<MapObject*> ret;
-    for (MapObject *obj : layer->objects()) {
+    for (MapObject *obj : layer->objectsIntersecting(area)) {
         // TODO: we are checking bounds, which is only correct for rectangles and
         // tile objects. polygons and polylines are not covered correctly by this
         // erase method (we are in fact deleting too many objects)
@@ -45,13 +45,15 @@ public:
         Orientation,
         RenderOrder,
         BackgroundColor,
-        LayerDataFormat
+        LayerDataFormat,
+        CompressionLevel
     };
 
     /**
      * Constructs a command that changes the value of the given property.
      *
-     * Can only be used for the HexSideLength property.
+     * Can only be used for the integer properties, like HexSideLength and
+     * CompressionLevel.
      *
      * @param mapDocument       the map document of the map
      * @param backgroundColor   the new color to apply for the background
@@ -21,6 +21,7 @@
 #include "document.h"
 
 #include "object.h"
+#include "preferences.h"
 #include "tile.h"
 
 #include <QFileInfo>
@@ -41,6 +42,8 @@ Document::Document(DocumentType type, const QString &fileName,
     , mChangedOnDisk(false)
     , mIgnoreBrokenLinks(false)
 {
+    mUndoStack->setUndoLimit(Preferences::instance()->undoLimit());
+
     connect(mUndoStack, &QUndoStack::cleanChanged,
             this, &Document::modifiedChanged);
 
@@ -9,13 +9,24 @@
 #include "rapidxml_print.hpp"
 #include "rapidxml_utils.hpp"
 #include "rapidxml_iterators.hpp"
+#include <QDateTime>
 #include <QDebug>
+#include <QEventLoop>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QtConcurrentMap>
 #include <stack>
 #include <QCoreApplication>
 #include <preferences.h>
 #include <QMessageBox>
 #include <templatemanager.h>
 #include <documentmanager.h>
+#include <imagecache.h>
+#include <tile.h>
 
 using namespace Tiled;
 
@@ -140,514 +151,310 @@ void GameMakerObjectImporter::mapObjectsToFolders(QString &projectFilePath, std:
 
 }
 
-bool GameMakerObjectImporter::showGenerateTemplatesDialog(QWidget* prt)
+namespace {
+
+/**
+ * What a template and its object type are made of. The parse stage fills in
+ * everything read from the .object.gmx and .sprite.gmx files, the gid and the
+ * paths are assigned by the ordered merge stage.
+ */
+struct ObjectTemplateInfo
 {
-	auto diag = new MMGenerateTemplatesDialog(prt);
-	diag->importer = this;
-	prtWidget = diag;
-	//diag->setWindowModality(Qt::WindowModal);
-	//diag->setModal(true);
-	diag->exec();
-	bool rv = diag->succeeded;
-	delete diag;
-	return rv;
-}
+	enum Status {
+		Valid,
+		Skipped,
+		Invalid
+	};
+
+	Status status = Skipped;
+	QString objectName;
+	QString spriteName;
+	QString imageFilePath;
+	int depth = 0;
+	int originX = 0;
+	int originY = 0;
+	int imageWidth = 1;
+	int imageHeigth = 1;
+
+	QString objectStamp;
+	QString spriteStamp;
+
+	int gid = -1;
+	QString folder;
+	QString templatePath;
+	QString imageCollectionPath;
+	bool changed = false;
+};
+
+/**
+ * Remembers what the templates were generated from, stored next to
+ * types.xml so that only what changed has to be generated again.
+ */
+struct TemplatesManifest
+{
+	struct Image
+	{
+		QString name;
+		QString source;
+		int width;
+		int height;
+	};
 
-bool GameMakerObjectImporter::generateTemplates(QString projectFilePath, QString outputDirPath, bool deleteOld, bool updateTypesInEditor)
+	QVector<Image> images;  // in gid order
+	QHash<QString, ObjectTemplateInfo> objects;
+};
+
+} // anonymous namespace
+
+static bool readXmlFile(const QString &fileName, QByteArray &buffer, rapidxml::xml_document<> &doc)
 {
-    if(projectFilePath.isEmpty() || outputDirPath.isEmpty())
-    {
-        QMessageBox::warning(nullptr ,QStringLiteral("A path was empty"),
-                             QStringLiteral("Can't generate templates with an empty project file path"));
+	QFile file(fileName);
+	if(!file.open(QIODevice::ReadOnly))
 		return false;
-    }
 
+	buffer = file.readAll();
+	file.close();
 
-
-	if(Tiled::Internal::DocumentManager::instance()->documents().count() > 0)
-	{
-        QMessageBox::warning(nullptr ,QStringLiteral("Can't generate templates"),
-                             QStringLiteral("Close all documents before generating templates"));
+	try {
+		doc.parse<0>(buffer.data());
+	} catch (rapidxml::parse_error &e) {
 		return false;
 	}
+	return true;
+}
 
-    using namespace rapidxml;
-    using namespace std;
+static QString fileStamp(const QFileInfo &fileInfo)
+{
+	if(!fileInfo.exists())
+		return QString();
+	return QString::number(fileInfo.lastModified().toMSecsSinceEpoch())
+			+ QLatin1Char(':') + QString::number(fileInfo.size());
+}
 
+static QString spriteStamp(const QDir &spriteDir, const QString &spriteName)
+{
+	if(spriteName.isEmpty())
+		return QString();
+	return fileStamp(QFileInfo(spriteDir.absoluteFilePath(spriteName + QStringLiteral(".sprite.gmx"))));
+}
 
-    if (!QFile::exists(projectFilePath)) {
-        QMessageBox::warning(nullptr ,QStringLiteral("Can't generate templates"),
-                             QStringLiteral("The project file doesn't exist"));
-        return false;
-    }
+static QString templateFilePath(const QDir &templateDir, const QString &folder, const QString &objectName)
+{
+	return templateDir.path() + folder + QLatin1Char('/') + objectName + QStringLiteral(".tx");
+}
 
-    QString projectDir;
-    {
-        QDir tempProjDir=QDir(projectFilePath);
-        tempProjDir.cdUp();
-        projectDir = tempProjDir.path();
-        qDebug() << "Project Dir: " << projectDir;
+/**
+ * Reads an object file and its sprite, called from the thread pool.
+ *
+ * The directories are kept as paths, since a QDir caches data on access and
+ * can't be shared between threads.
+ */
+struct ParseObjectFile
+{
+	typedef ObjectTemplateInfo result_type;
 
+	QString spritePath;
+	QString imagePath;
+	QString outputPath;
 
-    }
+	ObjectTemplateInfo operator()(const QFileInfo &fileInfo) const
+	{
+		using namespace rapidxml;
 
-	bool valid = true;
-    //Directories
-    QDir rootDir =  QDir(projectDir);
-	valid &= rootDir.cd(QStringLiteral("objects"));
-    QDir objectDir =  QDir(rootDir.path());
-	rootDir.cdUp();
-	valid &= rootDir.cd(QStringLiteral("sprites"));
-    QDir spriteDir =  QDir(rootDir.path());
-	valid &= rootDir.cd(QStringLiteral("images"));
-    QDir imageDir =  QDir(rootDir.path());
-    rootDir.cdUp();
-    rootDir.cdUp();
+		const QDir spriteDir(spritePath);
+		const QDir imageDir(imagePath);
+		const QDir outputDir(outputPath);
 
-	QDir outputDir = QDir(outputDirPath);
-	bool needTilesetReload = false;
-	if(deleteOld)
-	{
-		if(outputDir.exists(QStringLiteral("templates")))
-		{
-			QDir tmplDir(outputDir.filePath(QStringLiteral("templates")));
-			tmplDir.removeRecursively();
-		}
-		if(outputDir.exists(QStringLiteral("types.xml")))
+		ObjectTemplateInfo info;
+		info.objectName = fileInfo.baseName();
+		info.objectStamp = fileStamp(fileInfo);
+
+		QByteArray buffer;
+		xml_document<> doc;
+		if(!readXmlFile(fileInfo.filePath(), buffer, doc))
 		{
-			QFile::remove(outputDir.filePath(QStringLiteral("types.xml")));
+			qDebug()<<"error parsing object file";
+			return info;
 		}
-		if(outputDir.exists(QStringLiteral("images.tsx")))
+
+		xml_node<> *objectNode = doc.first_node("object");
+		if(!objectNode)
 		{
-			if(!TilesetManager::instance()->findTileset(outputDir.filePath(QStringLiteral("images.tsx"))).isNull())
-				needTilesetReload = true;
+			info.status = ObjectTemplateInfo::Invalid;
+			return info;
 		}
-	}
-
-
-	outputDir .mkdir(QStringLiteral("templates"));
-	valid &= outputDir .cd(QStringLiteral("templates"));
-	QDir templateDir = QDir(outputDir.path());
-	outputDir.cdUp();
-
-	if(!valid)
-	{
-		qDebug() << "Invalid directory";
-		return false;
-	}
-
-
-
-	if(!outputDir.exists(QStringLiteral("gmDefaultImage.png")))
-	{
-		qDebug() << "No default image file at " << outputDir.filePath(QStringLiteral("gmDefaultImage.png"));
-		QFile::copy(QStringLiteral(":/GMTemplateGeneration/DefaultTemplate.png"), outputDir.filePath(QStringLiteral("gmDefaultImage.png")));
-	}
-
-    objectDir.setFilter(QDir::Files | QDir::Hidden | QDir::NoSymLinks);
-    objectDir.setSorting(QDir::Size | QDir::Reversed);
 
-    //File info
-    QFileInfoList objectFileInfo = objectDir.entryInfoList();
-    int totalObjects =objectFileInfo.size();
+		xml_node<> *auxNode = objectNode->first_node("spriteName");
+		if(auxNode)
+			info.spriteName = QString(QLatin1String(auxNode->value()));
 
-    //Progress Bar
-	QProgressDialog progress(nullptr);
+		auxNode = objectNode->first_node("depth");
+		if(auxNode)
+			info.depth = QString(QLatin1String(auxNode->value())).toInt();
 
-	progress.setLabelText(QStringLiteral("Generating Templates"));
-	progress.setCancelButtonText(QStringLiteral("Abort"));
-	progress.setMinimum(0);
-	progress.setMaximum(totalObjects);
-	progress.setWindowFlags(Qt::WindowMinMaxButtonsHint);
-	progress.setWindowModality(Qt::ApplicationModal);
-	progress.show();
-	progress.setValue(0);
-	QCoreApplication::processEvents();
-	//progress->repaint();
+		if(info.spriteName == QStringLiteral("<undefined>")
+				|| info.spriteName == QStringLiteral("&lt;undefined&gt;")
+				|| info.spriteName.isEmpty())
+		{
+			//Uses the default image, if there is one
+			info.spriteName.clear();
+			info.imageWidth = 8;
+			info.imageHeigth = 8;
+			info.status = ObjectTemplateInfo::Valid;
+			return info;
+		}
 
-    //QString projectFilePath = QStringLiteral("");
-    unordered_map<string,string> *objectFolderMap = new unordered_map<string,string>();
-    unordered_map<string,int> *imageIDMap = new unordered_map<string,int>();
-    bool useObjectFolders = true;
+		QString spriteFileName = spriteDir.absoluteFilePath(info.spriteName + QStringLiteral(".sprite.gmx"));
+		if(!QFile::exists(spriteFileName))
+			return info;
 
-//    {
-//        QFileInfoList rootInfo = rootDir.entryInfoList();
-//        int size = rootInfo.size();
-//        for(int a = 0; a < size; ++a)
-//        {
-//            QFileInfo finfo = rootInfo.at(a);
-//            if(finfo.isFile())
-//            {
-//				if(finfo.fileName().endsWith(QStringLiteral(".project.gmx")))
-//                {
-//                    projectFilePath = finfo.filePath();
-//                    useObjectFolders = true;
-//                    break;
-//                }
-//            }
-//        }
-//    }
-    if(useObjectFolders)
-    {
-        mapObjectsToFolders(projectFilePath,objectFolderMap);
-    }
+		info.imageFilePath = outputDir.relativeFilePath(imageDir.filePath(info.spriteName + QStringLiteral("_0.png")));
+		info.spriteStamp = fileStamp(QFileInfo(spriteFileName));
 
-	QString undefined = QStringLiteral("&lt;undefined&gt;");
+		doc.clear();
+		if(!readXmlFile(spriteFileName, buffer, doc))
+		{
+			qDebug()<<"Error parsing sprite file";
+			return info;
+		}
 
-	QFile *imageCollection = new QFile(outputDir.path().append(QStringLiteral("/images.tsx")));
-    imageCollection->open(QIODevice::WriteOnly | QIODevice::Text);
-    imageCollection->flush();
+		xml_node<> *spriteNode = doc.first_node("sprite");
+		if(spriteNode)
+		{
+			auxNode = spriteNode->first_node("xorig");
+			if(auxNode)
+				info.originX = QString(QLatin1String(auxNode->value())).toInt();
+			auxNode = spriteNode->first_node("yorigin");
+			if(auxNode)
+				info.originY = QString(QLatin1String(auxNode->value())).toInt();
+			auxNode = spriteNode->first_node("width");
+			if(auxNode)
+				info.imageWidth = QString(QLatin1String(auxNode->value())).toInt();
+			auxNode = spriteNode->first_node("height");
+			if(auxNode)
+				info.imageHeigth = QString(QLatin1String(auxNode->value())).toInt();
+		}
 
-	QString typesDir = outputDir.path().append(QStringLiteral("/types.xml"));
-	QString imageCollectionPath = templateDir.relativeFilePath(outputDir.path().append(QStringLiteral("/images.tsx")));
+		info.status = ObjectTemplateInfo::Valid;
+		return info;
+	}
+};
 
-    QVector<imageEntry*>* imageList = new QVector<imageEntry*>();
-	imageList->reserve(totalObjects+1);
+/**
+ * Writes the .tx file of a template, called from the thread pool.
+ */
+static void writeTemplateFile(const ObjectTemplateInfo &info)
+{
+	if(info.status != ObjectTemplateInfo::Valid || !info.changed)
+		return;
 
-	int defaultImageId = -1;
-	if(outputDir.exists(QStringLiteral("gmDefaultImage.png")))
+	QFile templateFile(info.templatePath);
+	if(!templateFile.open(QIODevice::WriteOnly | QIODevice::Text ))
 	{
-		auto defaultImgName = QStringLiteral("gmDefaultImage.png");
-		auto defaultImgPath = outputDir.relativeFilePath(QStringLiteral("gmDefaultImage.png"));
-		defaultImageId = addImage(defaultImgName,
-								  defaultImgPath, 8, 8, imageList, imageIDMap);
+		qDebug()<<"\nError creating template file";
+		return;
 	}
 
-    int maxWidth = 0;
-    int maxHeigth = 0;
-
-
-    QFile *typesFile = new QFile(typesDir);
-    if(!typesFile->open(QIODevice::WriteOnly | QIODevice::Text))
-    {
-        delete typesFile;
-        delete imageList;
-        delete imageCollection;
-		delete imageIDMap;
-		return false;
-    }
-
-    QXmlStreamWriter typesWriter;
-    QXmlStreamWriter templateWriter;
-    templateWriter.setAutoFormatting(true);
-    typesWriter.setAutoFormatting(true);
-    typesWriter.setDevice(typesFile);
-    typesWriter.writeStartDocument();
-	typesWriter.writeStartElement(QStringLiteral("objecttypes"));
-
-
-    //Loop through object files
-    for (int i = 0; i < totalObjects; ++i) {
-		if((i%32) == 0)
-		{
-			progress.setValue(i);
-		}
-		if((i%64) == 0)
-		{
-			QCoreApplication::processEvents();
-		}
-		if(progress.wasCanceled())
-            break;
+	QXmlStreamWriter templateWriter;
+	templateWriter.setAutoFormatting(true);
+	templateWriter.setDevice(&templateFile);
+	templateWriter.writeStartDocument();
 
-        QFileInfo fileInfo = objectFileInfo.at(i);
+	templateWriter.writeStartElement(QStringLiteral("template"));
+		templateWriter.writeStartElement(QStringLiteral("tileset"));
+		templateWriter.writeAttribute(QStringLiteral("firstgid"),QStringLiteral("0"));
+		templateWriter.writeAttribute(QStringLiteral("source"),info.imageCollectionPath);
+	templateWriter.writeEndElement();
 
+	templateWriter.writeStartElement(QStringLiteral("object"));
+		templateWriter.writeAttribute(QStringLiteral("type"),info.objectName);
+		templateWriter.writeAttribute(QStringLiteral("gid"),QString::number(info.gid));
+		templateWriter.writeAttribute(QStringLiteral("width"),QString::number(info.imageWidth));
+		templateWriter.writeAttribute(QStringLiteral("height"),QString::number(info.imageHeigth));
 
-        xml_document<> auxDoc;
-        ifstream theFile(fileInfo.filePath().toStdString().c_str());
-        vector<char> buffer((istreambuf_iterator<char>(theFile)), istreambuf_iterator<char>());
-        buffer.push_back('\0');
-
-        try {
-            auxDoc.parse<0>(&buffer[0]);
-        } catch (parse_error e) {
-            qDebug()<<"error parsing object file";
-            continue;
-        }
+		//We don't actually need any properties since they're specified by the object type
+		templateWriter.writeStartElement(QStringLiteral("properties"));
+		templateWriter.writeEndElement();
 
+	templateWriter.writeEndElement();
 
-		if(!auxDoc.first_node("object")) {
-
-            qDebug()<<"critical error";
-			break;
-		}
-        xml_node<> *auxNode = auxDoc.first_node("object")->first_node("spriteName");
-        //Object info
-        QString objectName = fileInfo.baseName();//objectDir.relativeFilePath(fileInfo.filePath()).chopped(11);
+	templateWriter.writeEndDocument();
 
-        //Sprite info
-        QString spriteName = undefined;
+	templateFile.close();
+}
 
-        if(auxNode)
-        {
-            spriteName = QString(QLatin1String(auxNode->value()));
-        }
+static void writeObjectType(QXmlStreamWriter &typesWriter, const ObjectTemplateInfo &info)
+{
+	typesWriter.writeStartElement(QStringLiteral("objecttype"));
+		typesWriter.writeAttribute(QStringLiteral("name"),info.objectName);
+		typesWriter.writeAttribute(QStringLiteral("color"),QStringLiteral("#ffffff"));
 
-		int depth = 0;
-		auxNode = auxDoc.first_node("object")->first_node("depth");
-		if(auxNode)
-		{
-			depth = QString(QLatin1String(auxNode->value())).toInt();
-		}
-        int originX=0;
-        int originY=0;
-        int imageWidth=1;
+		typesWriter.writeStartElement(QStringLiteral("property"));
+			typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("offsetX"));
+			typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
+			typesWriter.writeAttribute(QStringLiteral("default"),QString::number(info.originX));
+		typesWriter.writeEndElement();
 
-        int imageHeigth=1;
-		int gid;
-		if(spriteName == QStringLiteral("<undefined>") || spriteName==undefined || spriteName.isEmpty())
-        {
-			//qDebug()<<"Object doesn't have a sprite, skipping...";
-			if(defaultImageId < 1)
-			{
-				auxDoc.clear();
-				continue;
-			}
-			gid = defaultImageId;
-			imageWidth = 8;
-			imageHeigth = 8;
-        }
-		else
-		{
-			QFile *spriteFile = findSprite(spriteName,&spriteDir);
+		typesWriter.writeStartElement(QStringLiteral("property"));
+			typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("originX"));
+			typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
+			typesWriter.writeAttribute(QStringLiteral("default"),QString::number(info.originX));
+		typesWriter.writeEndElement();
 
-			if(spriteFile==nullptr){
-				continue;
-			}
-			QString spr = QString(spriteName);
-
-			QString imageFilePath = outputDir.relativeFilePath( imageDir.filePath(spriteName.append(QStringLiteral("_0.png"))));
-			theFile.close();
-			auxDoc.clear();
-			theFile = ifstream(spriteFile->fileName().toStdString().c_str());
-
-			buffer = vector<char>((istreambuf_iterator<char>(theFile)), istreambuf_iterator<char>());
-			buffer.push_back('\0');
-			try {
-				auxDoc.parse<0>(&buffer[0]);
-			} catch (parse_error e) {
-				qDebug()<<"Error parsing sprite file";
-				delete spriteFile;
-				continue;
-			}
+		typesWriter.writeStartElement(QStringLiteral("property"));
+			typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("offsetY"));
+			typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
+			typesWriter.writeAttribute(QStringLiteral("default"),QString::number(info.originY));
+		typesWriter.writeEndElement();
 
-			{
-				xml_node<> *spriteNode = auxDoc.first_node("sprite");
-				if(spriteNode)
-				{
-					auxNode = spriteNode->first_node("xorig");
-					if(auxNode)
-						originX = QString(QLatin1String(auxNode->value())).toInt();
-					auxNode = spriteNode->first_node("yorigin");
-					if(auxNode)
-						originY = QString(QLatin1String(auxNode->value())).toInt();
-					auxNode = spriteNode->first_node("width");
-					if(auxNode)
-						imageWidth = QString(QLatin1String(auxNode->value())).toInt();
-					auxNode = spriteNode->first_node("height");
-					if(auxNode)
-						imageHeigth = QString(QLatin1String(auxNode->value())).toInt();
-				}
+		typesWriter.writeStartElement(QStringLiteral("property"));
+			typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("originY"));
+			typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
+			typesWriter.writeAttribute(QStringLiteral("default"),QString::number(info.originY));
+		typesWriter.writeEndElement();
 
-			}
+		typesWriter.writeStartElement(QStringLiteral("property"));
+			typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("imageWidth"));
+			typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
+			typesWriter.writeAttribute(QStringLiteral("default"),QString::number(info.imageWidth));
+		typesWriter.writeEndElement();
 
-			if(imageWidth>maxWidth)
-				maxWidth=imageWidth;
-			if(imageHeigth>maxHeigth)
-				maxHeigth=imageHeigth;
-			gid = addImage(spr,imageFilePath,imageWidth,imageHeigth,imageList,imageIDMap);
+		typesWriter.writeStartElement(QStringLiteral("property"));
+			typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("imageHeight"));
+			typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
+			typesWriter.writeAttribute(QStringLiteral("default"),QString::number(info.imageHeigth));
+		typesWriter.writeEndElement();
 
-			delete spriteFile;
-		}
+		typesWriter.writeStartElement(QStringLiteral("property"));
+			typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("locked"));
+			typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("bool"));
+			typesWriter.writeAttribute(QStringLiteral("value"),QStringLiteral("false"));
+		typesWriter.writeEndElement();
 
+		typesWriter.writeStartElement(QStringLiteral("property"));
+			typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("colour"));
+			typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("color"));
+			typesWriter.writeAttribute(QStringLiteral("value"),QStringLiteral("#ffffffff"));
+            typesWriter.writeAttribute(QStringLiteral("default"),QStringLiteral("#ffffffff"));
+		typesWriter.writeEndElement();
 
-        //Make template
-		QString subFolders = QStringLiteral("");
-        if(useObjectFolders)
-        {
-            unordered_map<string,string>::iterator it;
-            it = objectFolderMap->find(objectName.toStdString());
-            if(it!=objectFolderMap->end())
-            {
-				subFolders = str((char*)it->second.c_str());
+		typesWriter.writeStartElement(QStringLiteral("property"));
+			typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("depth"));
+			typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
+			typesWriter.writeAttribute(QStringLiteral("value"),QString::number(info.depth));
+		typesWriter.writeEndElement();
 
-            }
-        }
-		QString templatePath = templateDir.path().append(subFolders);
-
-        //QString templatePoth=templateDir.path().append(QLatin1String("/")).append(objectName).append(QLatin1String(".tx"));
-		imageCollectionPath = QDir(templatePath).relativeFilePath(outputDir.filePath(QStringLiteral("images.tsx")));
-		templatePath = templatePath.append(QStringLiteral("/").append(objectName).append(QStringLiteral(".tx")));
-        auxDoc.clear();
-		templateDir.mkpath(QFileInfo(templatePath).absolutePath());
-		QFile templateFile(templatePath);
-        if(true)
-        {
+		typesWriter.writeStartElement(QStringLiteral("property"));
+			typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("code"));
+			typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("string"));
+			typesWriter.writeAttribute(QStringLiteral("default"),QStringLiteral(""));
+		typesWriter.writeEndElement();
 
-            if(!templateFile.open(QIODevice::WriteOnly | QIODevice::Text ))
-            {
-                qDebug()<<"\nError creating template file";
-                continue;
-            }
-            templateWriter.setDevice(&templateFile);
-            templateWriter.writeStartDocument();
-
-			templateWriter.writeStartElement(QStringLiteral("template"));
-				templateWriter.writeStartElement(QStringLiteral("tileset"));
-				templateWriter.writeAttribute(QStringLiteral("firstgid"),QStringLiteral("0"));
-				templateWriter.writeAttribute(QStringLiteral("source"),imageCollectionPath);
-            templateWriter.writeEndElement();
-
-			templateWriter.writeStartElement(QStringLiteral("object"));
-				templateWriter.writeAttribute(QStringLiteral("type"),objectName);
-				templateWriter.writeAttribute(QStringLiteral("gid"),QString::number(gid));
-				templateWriter.writeAttribute(QStringLiteral("width"),QString::number(imageWidth));
-				templateWriter.writeAttribute(QStringLiteral("height"),QString::number(imageHeigth));
-
-				//We don't actually need these since they're specified by the object type
-				templateWriter.writeStartElement(QStringLiteral("properties"));
-					/*
-					templateWriter.writeStartElement(QStringLiteral("property"));
-						templateWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("offsetX"));
-						templateWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-						templateWriter.writeAttribute(QStringLiteral("value"),QString::number(originX));
-					templateWriter.writeEndElement();
-
-					templateWriter.writeStartElement(QStringLiteral("property"));
-						templateWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("originX"));
-						templateWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-						templateWriter.writeAttribute(QStringLiteral("value"),QString::number(originX));
-					templateWriter.writeEndElement();
-
-					templateWriter.writeStartElement(QStringLiteral("property"));
-						templateWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("offsetY"));
-						templateWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-						templateWriter.writeAttribute(QStringLiteral("value"),QString::number(originY));
-					templateWriter.writeEndElement();
-
-					templateWriter.writeStartElement(QStringLiteral("property"));
-						templateWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("originY"));
-						templateWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-						templateWriter.writeAttribute(QStringLiteral("value"),QString::number(originY));
-					templateWriter.writeEndElement();
-
-					templateWriter.writeStartElement(QStringLiteral("property"));
-						templateWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("imageWidth"));
-						templateWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-						templateWriter.writeAttribute(QStringLiteral("value"),QString::number(imageWidth));
-					templateWriter.writeEndElement();
-
-					templateWriter.writeStartElement(QStringLiteral("property"));
-						templateWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("imageHeight"));
-						templateWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-						templateWriter.writeAttribute(QStringLiteral("value"),QString::number(imageHeigth));
-					templateWriter.writeEndElement();
-
-					templateWriter.writeStartElement(QStringLiteral("property"));
-						templateWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("depth"));
-						templateWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-						templateWriter.writeAttribute(QStringLiteral("value"),QString::number(depth));
-					templateWriter.writeEndElement();
-
-					templateWriter.writeStartElement(QStringLiteral("property"));
-						templateWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("locked"));
-						templateWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("bool"));
-						templateWriter.writeAttribute(QStringLiteral("value"),QStringLiteral("false"));
-					templateWriter.writeEndElement();
-
-					templateWriter.writeStartElement(QStringLiteral("property"));
-						templateWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("colour"));
-						templateWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("color"));
-						templateWriter.writeAttribute(QStringLiteral("value"),QStringLiteral("#ffffffff"));
-					templateWriter.writeEndElement();
-
-					templateWriter.writeStartElement(QStringLiteral("property"));
-						templateWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("code"));
-						templateWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("string"));
-						templateWriter.writeAttribute(QStringLiteral("value"),QStringLiteral(""));
-					templateWriter.writeEndElement();
-				*/
-
-				templateWriter.writeEndElement();
-
-
-
-			templateWriter.writeEndElement();
-
-            templateWriter.writeEndDocument();
-
-            templateFile.close();
-        }
+    typesWriter.writeEndElement();
+}
 
-		typesWriter.writeStartElement(QStringLiteral("objecttype"));
-			typesWriter.writeAttribute(QStringLiteral("name"),objectName);
-			typesWriter.writeAttribute(QStringLiteral("color"),QStringLiteral("#ffffff"));
-
-			typesWriter.writeStartElement(QStringLiteral("property"));
-				typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("offsetX"));
-				typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-				typesWriter.writeAttribute(QStringLiteral("default"),QString::number(originX));
-			typesWriter.writeEndElement();
-
-			typesWriter.writeStartElement(QStringLiteral("property"));
-				typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("originX"));
-				typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-				typesWriter.writeAttribute(QStringLiteral("default"),QString::number(originX));
-			typesWriter.writeEndElement();
-
-			typesWriter.writeStartElement(QStringLiteral("property"));
-				typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("offsetY"));
-				typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-				typesWriter.writeAttribute(QStringLiteral("default"),QString::number(originY));
-			typesWriter.writeEndElement();
-
-			typesWriter.writeStartElement(QStringLiteral("property"));
-				typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("originY"));
-				typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-				typesWriter.writeAttribute(QStringLiteral("default"),QString::number(originY));
-			typesWriter.writeEndElement();
-
-			typesWriter.writeStartElement(QStringLiteral("property"));
-				typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("imageWidth"));
-				typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-				typesWriter.writeAttribute(QStringLiteral("default"),QString::number(imageWidth));
-			typesWriter.writeEndElement();
-
-			typesWriter.writeStartElement(QStringLiteral("property"));
-				typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("imageHeight"));
-				typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-				typesWriter.writeAttribute(QStringLiteral("default"),QString::number(imageHeigth));
-			typesWriter.writeEndElement();
-
-			typesWriter.writeStartElement(QStringLiteral("property"));
-				typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("locked"));
-				typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("bool"));
-				typesWriter.writeAttribute(QStringLiteral("value"),QStringLiteral("false"));
-			typesWriter.writeEndElement();
-
-			typesWriter.writeStartElement(QStringLiteral("property"));
-				typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("colour"));
-				typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("color"));
-				typesWriter.writeAttribute(QStringLiteral("value"),QStringLiteral("#ffffffff"));
-                typesWriter.writeAttribute(QStringLiteral("default"),QStringLiteral("#ffffffff"));
-			typesWriter.writeEndElement();
-
-			typesWriter.writeStartElement(QStringLiteral("property"));
-				typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("depth"));
-				typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("int"));
-				typesWriter.writeAttribute(QStringLiteral("value"),QString::number(depth));
-			typesWriter.writeEndElement();
-
-			typesWriter.writeStartElement(QStringLiteral("property"));
-				typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("code"));
-				typesWriter.writeAttribute(QStringLiteral("type"),QStringLiteral("string"));
-				typesWriter.writeAttribute(QStringLiteral("default"),QStringLiteral(""));
-			typesWriter.writeEndElement();
-
-        typesWriter.writeEndElement();
-
-     }
-
-	//DEFAULT TYPES
+static void writeDefaultTypes(QXmlStreamWriter &typesWriter)
+{
 
 	//ROOM VIEW
 	typesWriter.writeStartElement(QStringLiteral("objecttype"));
@@ -816,95 +623,622 @@ bool GameMakerObjectImporter::generateTemplates(QString projectFilePath, QString
 		typesWriter.writeEndElement();
 
 	typesWriter.writeEndElement();//ROOM BACKGROUND
+}
 
+static bool writeObjectTypes(const QString &fileName, const QVector<ObjectTemplateInfo> &templates)
+{
+	QFile typesFile(fileName);
+	if(!typesFile.open(QIODevice::WriteOnly | QIODevice::Text))
+		return false;
 
+	QXmlStreamWriter typesWriter;
+	typesWriter.setAutoFormatting(true);
+	typesWriter.setDevice(&typesFile);
+	typesWriter.writeStartDocument();
+	typesWriter.writeStartElement(QStringLiteral("objecttypes"));
 
-    typesWriter.writeEndElement();
-    typesWriter.writeEndDocument();
-
-    typesFile->close();
-
-    //Write image collection
-    int total = imageList->size();
-
-    typesWriter.setDevice(imageCollection);
-    typesWriter.writeStartDocument();
-	typesWriter.writeStartElement(QStringLiteral("tileset"));
-	typesWriter.writeAttribute(QStringLiteral("name"),QStringLiteral("images"));
-	typesWriter.writeAttribute(QStringLiteral("tilewidth"),QString::number(maxWidth));
-	typesWriter.writeAttribute(QStringLiteral("tileheight"),QString::number(maxHeigth));
-	typesWriter.writeAttribute(QStringLiteral("tileCount"),QString::number(total));
-	typesWriter.writeAttribute(QStringLiteral("columns"),QString::number(0));
-	typesWriter.writeStartElement(QStringLiteral("grid"));
-	typesWriter.writeAttribute(QStringLiteral("orientation"),QStringLiteral("orthogonal"));
-	typesWriter.writeAttribute(QStringLiteral("width"),QStringLiteral("1"));
-	typesWriter.writeAttribute(QStringLiteral("heigth"),QStringLiteral("1"));
-    typesWriter.writeEndElement();
-	for(int i=0;i<total;++i)
-    {
-		imageEntry* image = imageList->at(i);
-		typesWriter.writeStartElement(QStringLiteral("tile"));
-		typesWriter.writeAttribute(QStringLiteral("id"),QString::number(i+1));
-		typesWriter.writeStartElement(QStringLiteral("image"));
-		typesWriter.writeAttribute(QStringLiteral("width"),QString::number(image->imageWidth));
-		typesWriter.writeAttribute(QStringLiteral("height"),QString::number(image->imageHeigth));
-		typesWriter.writeAttribute(QStringLiteral("source"),image->rPath);
-        typesWriter.writeEndElement();
-        typesWriter.writeEndElement();
-    }
+	for(const ObjectTemplateInfo &info : templates)
+	{
+		if(info.status == ObjectTemplateInfo::Valid)
+			writeObjectType(typesWriter, info);
+	}
 
-    typesWriter.writeEndElement();
-	typesWriter.writeEndDocument();//Image collection
+	writeDefaultTypes(typesWriter);
 
-    imageCollection->close();
+	typesWriter.writeEndElement();
+	typesWriter.writeEndDocument();
 
-	delete imageCollection;
-	delete imageList;
-	delete objectFolderMap;
-	delete imageIDMap;
+	typesFile.close();
+	return true;
+}
 
-	TemplateManager::instance()->deleteInstance();
-	TilesetManager::instance()->deleteInstance();
+static bool writeImageCollection(const QString &fileName, const QVector<imageEntry*> &imageList)
+{
+	QFile imageCollection(fileName);
+	if(!imageCollection.open(QIODevice::WriteOnly | QIODevice::Text))
+		return false;
 
-	if(updateTypesInEditor)
+	int maxWidth = 0;
+	int maxHeigth = 0;
+	for(const imageEntry *image : imageList)
 	{
-		ObjectTypes objectTypes;
-		ObjectTypesSerializer serializer;
-
-		if (!serializer.readObjectTypes(typesFile->fileName(), objectTypes)) {
-			QMessageBox::critical(prtWidget, tr("Error Reading Object Types"),
-								  serializer.errorString());
-		}
-		else
-		{
-			auto *prefs = Internal::Preferences::instance();
-			prefs->setObjectTypesFile(typesFile->fileName());
-			prefs->setObjectTypes(objectTypes);
-			qDebug() << "Types reloaded";
-		}
-
+		maxWidth = qMax(maxWidth, image->imageWidth);
+		maxHeigth = qMax(maxHeigth, image->imageHeigth);
 	}
-	delete typesFile;
-
 
-	progress.close();
+	int total = imageList.size();
+
+	QXmlStreamWriter writer;
+	writer.setAutoFormatting(true);
+	writer.setDevice(&imageCollection);
+	writer.writeStartDocument();
+	writer.writeStartElement(QStringLiteral("tileset"));
+	writer.writeAttribute(QStringLiteral("name"),QStringLiteral("images"));
+	writer.writeAttribute(QStringLiteral("tilewidth"),QString::number(maxWidth));
+	writer.writeAttribute(QStringLiteral("tileheight"),QString::number(maxHeigth));
+	writer.writeAttribute(QStringLiteral("tileCount"),QString::number(total));
+	writer.writeAttribute(QStringLiteral("columns"),QString::number(0));
+	writer.writeStartElement(QStringLiteral("grid"));
+	writer.writeAttribute(QStringLiteral("orientation"),QStringLiteral("orthogonal"));
+	writer.writeAttribute(QStringLiteral("width"),QStringLiteral("1"));
+	writer.writeAttribute(QStringLiteral("heigth"),QStringLiteral("1"));
+	writer.writeEndElement();
+	for(int i=0;i<total;++i)
+	{
+		const imageEntry* image = imageList.at(i);
+		writer.writeStartElement(QStringLiteral("tile"));
+		writer.writeAttribute(QStringLiteral("id"),QString::number(i+1));
+		writer.writeStartElement(QStringLiteral("image"));
+		writer.writeAttribute(QStringLiteral("width"),QString::number(image->imageWidth));
+		writer.writeAttribute(QStringLiteral("height"),QString::number(image->imageHeigth));
+		writer.writeAttribute(QStringLiteral("source"),image->rPath);
+		writer.writeEndElement();
+		writer.writeEndElement();
+	}
+
+	writer.writeEndElement();
+	writer.writeEndDocument();//Image collection
+
+	imageCollection.close();
 	return true;
+}
+
+static bool readManifest(const QString &fileName, const QString &projectFilePath, TemplatesManifest &manifest)
+{
+	QFile file(fileName);
+	if(!file.open(QIODevice::ReadOnly))
+		return false;
 
+	QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+	if(root.value(QStringLiteral("version")).toInt() != 1
+			|| root.value(QStringLiteral("project")).toString() != projectFilePath)
+		return false;
+
+	const QJsonArray images = root.value(QStringLiteral("images")).toArray();
+	for(const QJsonValue &value : images)
+	{
+		QJsonObject object = value.toObject();
+		TemplatesManifest::Image image;
+		image.name = object.value(QStringLiteral("name")).toString();
+		image.source = object.value(QStringLiteral("source")).toString();
+		image.width = object.value(QStringLiteral("width")).toInt();
+		image.height = object.value(QStringLiteral("height")).toInt();
+		manifest.images.append(image);
+	}
+
+	const QJsonArray objects = root.value(QStringLiteral("objects")).toArray();
+	for(const QJsonValue &value : objects)
+	{
+		QJsonObject object = value.toObject();
+		ObjectTemplateInfo info;
+		info.status = ObjectTemplateInfo::Valid;
+		info.objectName = object.value(QStringLiteral("name")).toString();
+		info.spriteName = object.value(QStringLiteral("sprite")).toString();
+		info.imageFilePath = object.value(QStringLiteral("image")).toString();
+		info.depth = object.value(QStringLiteral("depth")).toInt();
+		info.originX = object.value(QStringLiteral("originX")).toInt();
+		info.originY = object.value(QStringLiteral("originY")).toInt();
+		info.imageWidth = object.value(QStringLiteral("width")).toInt();
+		info.imageHeigth = object.value(QStringLiteral("height")).toInt();
+		info.objectStamp = object.value(QStringLiteral("objectStamp")).toString();
+		info.spriteStamp = object.value(QStringLiteral("spriteStamp")).toString();
+		info.folder = object.value(QStringLiteral("folder")).toString();
+		manifest.objects.insert(info.objectName, info);
+	}
+
+	return true;
 }
 
-QFile* GameMakerObjectImporter::findSprite(QString filename, QDir* dir)
+static bool writeManifest(const QString &fileName, const QString &projectFilePath,
+						  const QVector<imageEntry*> &imageList,
+						  const std::unordered_map<std::string,int> &imageIDMap,
+						  const QVector<ObjectTemplateInfo> &templates)
 {
-	QString fname = filename.append(QStringLiteral(".sprite.gmx"));
-    QFile * newFile = new QFile(dir->absoluteFilePath(fname));
-    if(newFile->exists())
-        return newFile;
-    else
+	QVector<QString> imageNames(imageList.size());
+	for(const auto &entry : imageIDMap)
+		imageNames[entry.second - 1] = QString::fromStdString(entry.first);
+
+	QJsonArray images;
+	for(int i = 0; i < imageList.size(); ++i)
+	{
+		const imageEntry *image = imageList.at(i);
+		QJsonObject object;
+		object.insert(QStringLiteral("name"), imageNames.at(i));
+		object.insert(QStringLiteral("source"), image->rPath);
+		object.insert(QStringLiteral("width"), image->imageWidth);
+		object.insert(QStringLiteral("height"), image->imageHeigth);
+		images.append(object);
+	}
+
+	QJsonArray objects;
+	for(const ObjectTemplateInfo &info : templates)
+	{
+		if(info.status != ObjectTemplateInfo::Valid)
+			continue;
+
+		QJsonObject object;
+		object.insert(QStringLiteral("name"), info.objectName);
+		object.insert(QStringLiteral("sprite"), info.spriteName);
+		object.insert(QStringLiteral("image"), info.imageFilePath);
+		object.insert(QStringLiteral("depth"), info.depth);
+		object.insert(QStringLiteral("originX"), info.originX);
+		object.insert(QStringLiteral("originY"), info.originY);
+		object.insert(QStringLiteral("width"), info.imageWidth);
+		object.insert(QStringLiteral("height"), info.imageHeigth);
+		object.insert(QStringLiteral("objectStamp"), info.objectStamp);
+		object.insert(QStringLiteral("spriteStamp"), info.spriteStamp);
+		object.insert(QStringLiteral("folder"), info.folder);
+		objects.append(object);
+	}
+
+	QJsonObject root;
+	root.insert(QStringLiteral("version"), 1);
+	root.insert(QStringLiteral("project"), projectFilePath);
+	root.insert(QStringLiteral("images"), images);
+	root.insert(QStringLiteral("objects"), objects);
+
+	QFile file(fileName);
+	if(!file.open(QIODevice::WriteOnly))
+		return false;
+	file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+	file.close();
+	return true;
+}
+
+/**
+ * Brings an already loaded images.tsx up to date without reloading every
+ * tileset. Known sprites that moved or were resized get their new image,
+ * new sprites are appended. Falls back to dropping all tilesets when the
+ * loaded collection doesn't line up with the generated one.
+ */
+static void updateLoadedImageCollection(const QDir &outputDir, const QString &fileName,
+										const QVector<imageEntry*> &imageList, int previousImageCount)
+{
+	SharedTileset images = TilesetManager::instance()->findTilesetAbsolute(fileName);
+	if(images.isNull())
+		return;
+
+	for(int gid = 1; gid <= previousImageCount; ++gid)
+	{
+		Tile *tile = images->findTile(gid);
+		if(!tile)
+		{
+			images.reset();
+			TilesetManager::instance()->deleteInstance();
+			return;
+		}
+
+		const imageEntry *image = imageList.at(gid - 1);
+		const QUrl source = QUrl::fromLocalFile(outputDir.absoluteFilePath(image->rPath));
+		if(tile->imageSource() != source || tile->image().size() != QSize(image->imageWidth, image->imageHeigth))
+		{
+			ImageCache::remove(source.toLocalFile());
+			images->setTileImage(tile, ImageCache::loadPixmap(source.toLocalFile()), source);
+		}
+	}
+
+	for(int gid = previousImageCount + 1; gid <= imageList.size(); ++gid)
+	{
+		if(images->nextTileId() != gid)
+		{
+			images.reset();
+			TilesetManager::instance()->deleteInstance();
+			return;
+		}
+
+		QString source = outputDir.absoluteFilePath(imageList.at(gid - 1)->rPath);
+		images->addTile(ImageCache::loadPixmap(source), QUrl::fromLocalFile(source));
+	}
+
+	TilesetManager::instance()->reloadImages(images.data());
+}
+
+/**
+ * Runs an event loop until \a future is done, keeping \a progress updated
+ * and cancelling the future when the progress dialog is cancelled.
+ * Returns false when it was cancelled.
+ */
+template<typename T>
+static bool waitForFuture(const QFuture<T> &future, QProgressDialog &progress, int progressOffset)
+{
+	QFutureWatcher<T> watcher;
+	QEventLoop loop;
+
+	QObject::connect(&watcher, &QFutureWatcherBase::finished, &loop, &QEventLoop::quit);
+	QObject::connect(&watcher, &QFutureWatcherBase::progressValueChanged, &progress,
+					 [&progress, progressOffset](int value) { progress.setValue(progressOffset + value); });
+	QObject::connect(&progress, &QProgressDialog::canceled, &watcher, &QFutureWatcherBase::cancel);
+
+	//Finished is delivered through the event loop even if the future is already done
+	watcher.setFuture(future);
+	loop.exec();
+
+	return !future.isCanceled();
+}
+
+bool GameMakerObjectImporter::showGenerateTemplatesDialog(QWidget* prt)
+{
+	auto diag = new MMGenerateTemplatesDialog(prt);
+	diag->importer = this;
+	prtWidget = diag;
+	//diag->setWindowModality(Qt::WindowModal);
+	//diag->setModal(true);
+	diag->exec();
+	bool rv = diag->succeeded;
+	delete diag;
+	return rv;
+}
+
+bool GameMakerObjectImporter::generateTemplates(QString projectFilePath, QString outputDirPath, bool deleteOld, bool updateTypesInEditor)
+{
+    if(projectFilePath.isEmpty() || outputDirPath.isEmpty())
+    {
+        QMessageBox::warning(nullptr ,QStringLiteral("A path was empty"),
+                             QStringLiteral("Can't generate templates with an empty project file path"));
+		return false;
+    }
+
+
+
+	if(Tiled::Internal::DocumentManager::instance()->documents().count() > 0)
+	{
+        QMessageBox::warning(nullptr ,QStringLiteral("Can't generate templates"),
+                             QStringLiteral("Close all documents before generating templates"));
+		return false;
+	}
+
+    using namespace rapidxml;
+    using namespace std;
+
+
+    if (!QFile::exists(projectFilePath)) {
+        QMessageBox::warning(nullptr ,QStringLiteral("Can't generate templates"),
+                             QStringLiteral("The project file doesn't exist"));
+        return false;
+    }
+
+    QString projectDir;
+    {
+        QDir tempProjDir=QDir(projectFilePath);
+        tempProjDir.cdUp();
+        projectDir = tempProjDir.path();
+        qDebug() << "Project Dir: " << projectDir;
+
+
+    }
+
+	bool valid = true;
+    //Directories
+    QDir rootDir =  QDir(projectDir);
+	valid &= rootDir.cd(QStringLiteral("objects"));
+    QDir objectDir =  QDir(rootDir.path());
+	rootDir.cdUp();
+	valid &= rootDir.cd(QStringLiteral("sprites"));
+    QDir spriteDir =  QDir(rootDir.path());
+	valid &= rootDir.cd(QStringLiteral("images"));
+    QDir imageDir =  QDir(rootDir.path());
+    rootDir.cdUp();
+    rootDir.cdUp();
+
+	QDir outputDir = QDir(outputDirPath);
+
+	if(!valid)
+	{
+		qDebug() << "Invalid directory";
+		return false;
+	}
+
+	QString typesDir = outputDir.filePath(QStringLiteral("types.xml"));
+	QString imageCollectionFileName = outputDir.filePath(QStringLiteral("images.tsx"));
+	QString manifestFileName = outputDir.filePath(QStringLiteral("templates.manifest.json"));
+
+	//Without deleteOld only what changed since the last run is regenerated,
+	//as long as the manifest belongs to this project and the output is there
+	TemplatesManifest manifest;
+	bool incremental = !deleteOld
+			&& outputDir.exists(QStringLiteral("templates"))
+			&& QFile::exists(typesDir)
+			&& QFile::exists(imageCollectionFileName)
+			&& readManifest(manifestFileName, projectFilePath, manifest);
+
+    objectDir.setFilter(QDir::Files | QDir::Hidden | QDir::NoSymLinks);
+    objectDir.setSorting(QDir::Size | QDir::Reversed);
+
+    //File info
+    QFileInfoList objectFileInfo = objectDir.entryInfoList();
+    int totalObjects =objectFileInfo.size();
+
+	//Reuse what the manifest knows about objects whose files didn't change
+	QVector<ObjectTemplateInfo> templates(totalObjects);
+	QFileInfoList filesToParse;
+	QVector<int> parsedIndexes;
+	for (int i = 0; i < totalObjects; ++i) {
+		const QFileInfo &fileInfo = objectFileInfo.at(i);
+		if(incremental)
+		{
+			auto it = manifest.objects.constFind(fileInfo.baseName());
+			if(it != manifest.objects.constEnd()
+					&& it->objectStamp == fileStamp(fileInfo)
+					&& it->spriteStamp == spriteStamp(spriteDir, it->spriteName))
+			{
+				templates[i] = it.value();
+				continue;
+			}
+		}
+		filesToParse.append(fileInfo);
+		parsedIndexes.append(i);
+	}
+
+    //Progress Bar, covers parsing the changed files and writing the templates
+	QProgressDialog progress(nullptr);
+
+	progress.setLabelText(QStringLiteral("Generating Templates"));
+	progress.setCancelButtonText(QStringLiteral("Abort"));
+	progress.setMinimum(0);
+	progress.setMaximum(filesToParse.size() + totalObjects);
+	progress.setWindowFlags(Qt::WindowMinMaxButtonsHint);
+	progress.setWindowModality(Qt::ApplicationModal);
+	progress.show();
+	progress.setValue(0);
+	QCoreApplication::processEvents();
+
+	//Parse the object and sprite files in parallel, nothing is written or
+	//deleted until this is done so cancelling here leaves the old output intact
+	ParseObjectFile parseObjectFile;
+	parseObjectFile.spritePath = spriteDir.path();
+	parseObjectFile.imagePath = imageDir.path();
+	parseObjectFile.outputPath = outputDir.path();
+
+	QFuture<ObjectTemplateInfo> parsed = QtConcurrent::mapped(filesToParse, parseObjectFile);
+	if(!waitForFuture(parsed, progress, 0))
+	{
+		progress.close();
+		return false;
+	}
+	for (int i = 0; i < parsedIndexes.size(); ++i) {
+		ObjectTemplateInfo &info = templates[parsedIndexes.at(i)];
+		info = parsed.resultAt(i);
+		info.changed = true;
+	}
+
+	if(deleteOld)
+	{
+		if(outputDir.exists(QStringLiteral("templates")))
+		{
+			QDir tmplDir(outputDir.filePath(QStringLiteral("templates")));
+			tmplDir.removeRecursively();
+		}
+		if(outputDir.exists(QStringLiteral("types.xml")))
+		{
+			QFile::remove(outputDir.filePath(QStringLiteral("types.xml")));
+		}
+	}
+
+	outputDir .mkdir(QStringLiteral("templates"));
+	if(!outputDir .cd(QStringLiteral("templates")))
+	{
+		qDebug() << "Invalid directory";
+		progress.close();
+		return false;
+	}
+	QDir templateDir = QDir(outputDir.path());
+	outputDir.cdUp();
+
+	if(!outputDir.exists(QStringLiteral("gmDefaultImage.png")))
+	{
+		qDebug() << "No default image file at " << outputDir.filePath(QStringLiteral("gmDefaultImage.png"));
+		QFile::copy(QStringLiteral(":/GMTemplateGeneration/DefaultTemplate.png"), outputDir.filePath(QStringLiteral("gmDefaultImage.png")));
+	}
+
+    unordered_map<string,string> *objectFolderMap = new unordered_map<string,string>();
+    unordered_map<string,int> *imageIDMap = new unordered_map<string,int>();
+    bool useObjectFolders = true;
+
+    if(useObjectFolders)
     {
-        delete newFile;
+        mapObjectsToFolders(projectFilePath,objectFolderMap);
     }
 
-    return nullptr;
+    QVector<imageEntry*>* imageList = new QVector<imageEntry*>();
+	imageList->reserve(totalObjects+1);
+
+	//Keep the gids of known images so existing maps stay valid
+	for (int i = 0; i < manifest.images.size(); ++i) {
+		TemplatesManifest::Image &image = manifest.images[i];
+		addImage(image.name, image.source, image.width, image.height, imageList, imageIDMap);
+	}
+	const int previousImageCount = imageList->size();
+	bool imagesChanged = !incremental;
+
+	int defaultImageId = -1;
+	if(outputDir.exists(QStringLiteral("gmDefaultImage.png")))
+	{
+		auto defaultImgName = QStringLiteral("gmDefaultImage.png");
+		auto defaultImgPath = outputDir.relativeFilePath(QStringLiteral("gmDefaultImage.png"));
+		defaultImageId = addImage(defaultImgName,
+								  defaultImgPath, 8, 8, imageList, imageIDMap);
+	}
+
+	//Assign gids in file order so the output doesn't depend on which
+	//thread finished first
+	bool templatesChanged = !incremental;
+	QSet<QString> currentObjects;
+	QSet<QString> createdDirs;
+	for (int i = 0; i < templates.size(); ++i) {
+		ObjectTemplateInfo &info = templates[i];
+
+		if(info.status == ObjectTemplateInfo::Invalid)
+		{
+            qDebug()<<"critical error";
+			templates.resize(i);
+			break;
+		}
+		if(info.status == ObjectTemplateInfo::Skipped)
+			continue;
+
+		if(info.spriteName.isEmpty())
+        {
+			if(defaultImageId < 1)
+			{
+				info.status = ObjectTemplateInfo::Skipped;
+				continue;
+			}
+			info.gid = defaultImageId;
+        }
+		else
+		{
+			info.gid = addImage(info.spriteName,info.imageFilePath,info.imageWidth,info.imageHeigth,imageList,imageIDMap);
+
+			//A known sprite may have been resized
+			imageEntry *image = imageList->at(info.gid - 1);
+			if(image->imageWidth != info.imageWidth || image->imageHeigth != info.imageHeigth || image->rPath != info.imageFilePath)
+			{
+				image->imageWidth = info.imageWidth;
+				image->imageHeigth = info.imageHeigth;
+				image->path = info.imageFilePath;
+				image->rPath = info.imageFilePath;
+				imagesChanged = true;
+			}
+		}
+
+		QString subFolders = QStringLiteral("");
+        if(useObjectFolders)
+        {
+            unordered_map<string,string>::iterator it;
+			it = objectFolderMap->find(info.objectName.toStdString());
+            if(it!=objectFolderMap->end())
+            {
+				subFolders = str((char*)it->second.c_str());
+
+            }
+        }
+
+		//Objects moved to another folder in the project leave their old template behind
+		auto previous = manifest.objects.constFind(info.objectName);
+		if(previous != manifest.objects.constEnd() && previous->folder != subFolders)
+		{
+			QFile::remove(templateFilePath(templateDir, previous->folder, info.objectName));
+			info.changed = true;
+		}
+
+		info.folder = subFolders;
+		info.imageCollectionPath = QDir(templateDir.path().append(subFolders)).relativeFilePath(imageCollectionFileName);
+		info.templatePath = templateFilePath(templateDir, subFolders, info.objectName);
+
+		if(!info.changed && !QFile::exists(info.templatePath))
+			info.changed = true;
+		templatesChanged |= info.changed;
+		currentObjects.insert(info.objectName);
+
+		if(!info.changed)
+			continue;
+
+		//Directories are created here so the writers don't race on them
+		QString templateFileDir = QFileInfo(info.templatePath).absolutePath();
+		if(!createdDirs.contains(templateFileDir))
+		{
+			templateDir.mkpath(templateFileDir);
+			createdDirs.insert(templateFileDir);
+		}
+	}
+
+	//Remove the templates of objects that were deleted from the project
+	for (auto it = manifest.objects.constBegin(); it != manifest.objects.constEnd(); ++it) {
+		if(!currentObjects.contains(it.key()))
+		{
+			QFile::remove(templateFilePath(templateDir, it->folder, it.key()));
+			templatesChanged = true;
+		}
+	}
+
+	imagesChanged |= imageList->size() != previousImageCount;
+
+	//Write the changed templates in parallel
+	QFuture<void> written = QtConcurrent::map(templates, writeTemplateFile);
+	bool canceled = !waitForFuture(written, progress, filesToParse.size());
+
+	if(templatesChanged)
+	{
+		if(!writeObjectTypes(typesDir, templates))
+		{
+			qDebug() << "Error writing" << typesDir;
+			canceled = true;
+		}
+	}
+
+	if(imagesChanged)
+	{
+		if(!writeImageCollection(imageCollectionFileName, *imageList))
+			qDebug() << "Error writing" << imageCollectionFileName;
+	}
+
+	//Canceled runs get no manifest, so the next run checks everything again
+	if(canceled)
+		QFile::remove(manifestFileName);
+	else
+		writeManifest(manifestFileName, projectFilePath, *imageList, *imageIDMap, templates);
+
+	if(!incremental)
+	{
+		TemplateManager::instance()->deleteInstance();
+		TilesetManager::instance()->deleteInstance();
+	}
+	else
+	{
+		if(templatesChanged)
+			TemplateManager::instance()->deleteInstance();
+		if(imagesChanged)
+			updateLoadedImageCollection(outputDir, imageCollectionFileName, *imageList, previousImageCount);
+	}
+
+	qDeleteAll(*imageList);
+	delete imageList;
+	delete objectFolderMap;
+	delete imageIDMap;
+
+	if(updateTypesInEditor && templatesChanged)
+	{
+		ObjectTypes objectTypes;
+		ObjectTypesSerializer serializer;
+
+		if (!serializer.readObjectTypes(typesDir, objectTypes)) {
+			QMessageBox::critical(prtWidget, tr("Error Reading Object Types"),
+								  serializer.errorString());
+		}
+		else
+		{
+			auto *prefs = Internal::Preferences::instance();
+			prefs->setObjectTypesFile(typesDir);
+			prefs->setObjectTypes(objectTypes);
+			qDebug() << "Types reloaded";
+		}
+
+	}
+
+	progress.close();
+	return !canceled;
 }
+
 int GameMakerObjectImporter::addImage(QString &filename,QString &fileDir,int width, int heigth, QVector<imageEntry*> *list, std::unordered_map<std::string,int> *idmap)
 {
     using namespace std;
@@ -44,7 +44,6 @@ protected:
     void run() override;
 private:
     QWidget *prtWidget;
-    QFile *findSprite(QString filename, QDir* dir);
     GameMakerObjectImporter *myThread = nullptr;
     void mapChilds(rapidxml::xml_node<>* node, std::unordered_map<std::string,std::string> *objectFolderMap);
     void mapObjectsToFolders(QString &projectFilePath, std::unordered_map<std::string, std::string> *objectFolderMap);
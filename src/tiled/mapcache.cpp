@@ -0,0 +1,227 @@
+/*
+ * mapcache.cpp
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapcache.h"
+
+#include "map.h"
+#include "mapformat.h"
+#include "maptovariantconverter.h"
+#include "varianttomapconverter.h"
+
+#include <QAtomicInt>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrentRun>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+static const quint32 CacheMagic = 0x544d4300;   // "TMC\0"
+
+/*
+ * Increase this whenever the way maps are stored in the cache changes, so
+ * that existing snapshots are ignored.
+ */
+static const quint32 CacheVersion = 3;
+
+static const QDataStream::Version StreamVersion = QDataStream::Qt_5_5;
+
+// Snapshots that weren't written for this long are removed
+static const int MaxCacheAgeDays = 30;
+
+// When the snapshots take more space, the oldest ones are removed
+static const qint64 MaxCacheSize = 256 * 1024 * 1024;
+
+/**
+ * Returns whether maps read by \a format can be cached. This is only the case
+ * for formats that can write back everything they read, and that don't
+ * depend on anything but the map file and the files it refers to.
+ */
+bool MapCache::canCache(const MapFormat *format)
+{
+    if (!format)
+        return false;
+
+    const QString shortName = format->shortName();
+    return shortName == QLatin1String("tmx") || shortName == QLatin1String("json");
+}
+
+Map *MapCache::read(const QString &fileName, const MapFormat *format)
+{
+    if (!canCache(format))
+        return nullptr;
+
+    const QString cacheFile = cacheFileName(fileName);
+    if (cacheFile.isEmpty())
+        return nullptr;
+
+    QFile file(cacheFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    QDataStream in(&file);
+    in.setVersion(StreamVersion);
+
+    quint32 magic;
+    quint32 version;
+    QString formatName;
+    in >> magic >> version;
+
+    if (magic != CacheMagic || version != CacheVersion)
+        return nullptr;
+
+    in >> formatName;
+    if (formatName != format->shortName())
+        return nullptr;
+
+    // Only use the snapshot when the source file hasn't changed since
+    const QFileInfo sourceInfo(fileName);
+    qint64 sourceSize;
+    qint64 sourceModified;
+    in >> sourceSize >> sourceModified;
+
+    if (sourceSize != sourceInfo.size() ||
+            sourceModified != sourceInfo.lastModified().toMSecsSinceEpoch())
+        return nullptr;
+
+    qint32 layerDataFormat;
+    qint32 compressionLevel;
+    QVariant mapVariant;
+    in >> layerDataFormat >> compressionLevel >> mapVariant;
+
+    if (in.status() != QDataStream::Ok)
+        return nullptr;
+
+    VariantToMapConverter converter;
+    Map *map = converter.toMap(mapVariant, sourceInfo.dir());
+    if (!map)
+        return nullptr;
+
+    // The snapshot stores the layer data in its own format
+    map->setLayerDataFormat(static_cast<Map::LayerDataFormat>(layerDataFormat));
+    map->setCompressionLevel(compressionLevel);
+
+    return map;
+}
+
+void MapCache::write(const Map &map, const QString &fileName,
+                     const MapFormat *format)
+{
+    if (!canCache(format))
+        return;
+
+    const QString cacheFile = cacheFileName(fileName);
+    if (cacheFile.isEmpty())
+        return;
+
+    const QFileInfo sourceInfo(fileName);
+
+    // Uncompressed layer data is the quickest to read back in
+    MapToVariantConverter converter;
+    converter.setLayerDataFormat(Map::Base64);
+    const QVariant mapVariant = converter.toVariant(map, sourceInfo.dir());
+
+    const QString formatName = format->shortName();
+    const qint64 sourceSize = sourceInfo.size();
+    const qint64 sourceModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+    const qint32 layerDataFormat = map.layerDataFormat();
+    const qint32 compressionLevel = map.compressionLevel();
+
+    // Only the map itself is converted on the calling thread. Writing the
+    // snapshot is done in the background, so it doesn't delay opening the map.
+    QtConcurrent::run([=] {
+        if (!QDir().mkpath(QFileInfo(cacheFile).path()))
+            return;
+
+        QSaveFile file(cacheFile);
+        if (!file.open(QIODevice::WriteOnly))
+            return;
+
+        QDataStream out(&file);
+        out.setVersion(StreamVersion);
+
+        out << CacheMagic << CacheVersion;
+        out << formatName;
+        out << sourceSize << sourceModified;
+        out << layerDataFormat << compressionLevel;
+        out << mapVariant;
+
+        if (out.status() != QDataStream::Ok || !file.commit())
+            return;
+
+        // Scanning the cache directory once per session is enough
+        static QAtomicInt pruned;
+        if (pruned.testAndSetRelaxed(0, 1))
+            prune();
+    });
+}
+
+QString MapCache::cacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + QLatin1String("/maps");
+}
+
+/**
+ * Returns the file name of the snapshot for the given source file, which is
+ * derived from a hash of its canonical path. Returns an empty string when the
+ * source file does not exist.
+ */
+QString MapCache::cacheFileName(const QString &fileName)
+{
+    const QString canonicalPath = QFileInfo(fileName).canonicalFilePath();
+    if (canonicalPath.isEmpty())
+        return QString();
+
+    const QByteArray hash = QCryptographicHash::hash(canonicalPath.toUtf8(),
+                                                     QCryptographicHash::Sha1);
+
+    return cacheDirectory() + QLatin1Char('/')
+            + QString::fromLatin1(hash.toHex())
+            + QLatin1String(".tmc");
+}
+
+/**
+ * Removes snapshots that weren't written for a while, as well as the oldest
+ * snapshots when they take up too much space.
+ */
+void MapCache::prune()
+{
+    const QDir cacheDir(cacheDirectory());
+    const QFileInfoList snapshots = cacheDir.entryInfoList(QStringList(QLatin1String("*.tmc")),
+                                                     QDir::Files,
+                                                     QDir::Time);
+
+    const QDateTime oldest = QDateTime::currentDateTime().addDays(-MaxCacheAgeDays);
+    qint64 totalSize = 0;
+
+    // Sorted by time, most recently written first
+    for (const QFileInfo &snapshot : snapshots) {
+        totalSize += snapshot.size();
+
+        if (totalSize > MaxCacheSize || snapshot.lastModified() < oldest)
+            QFile::remove(snapshot.filePath());
+    }
+}
@@ -0,0 +1,69 @@
+/*
+ * mapcache.h
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QString>
+
+namespace Tiled {
+
+class Map;
+class MapFormat;
+
+namespace Internal {
+
+/**
+ * Stores binary snapshots of maps in the cache directory, so that large maps
+ * can be reopened without parsing their source file again.
+ *
+ * A snapshot is keyed by the path of the source file and is only used while
+ * the size and modification time of the source file match those recorded
+ * in the snapshot, and when it is read with the same map format.
+ *
+ * Only maps read by formats that store everything about the map in the file
+ * itself are cached. Other formats, like GameMaker rooms, lose data when
+ * written and depend on settings and files that the snapshot can't track.
+ */
+class MapCache
+{
+public:
+    static bool canCache(const MapFormat *format);
+
+    /**
+     * Returns the map stored in the snapshot for the given source file, or
+     * null when there is no up-to-date snapshot made with \a format.
+     */
+    static Map *read(const QString &fileName, const MapFormat *format);
+
+    /**
+     * Writes a snapshot of \a map, as just read from the given source file
+     * by \a format. The snapshot is written in the background. Failure to
+     * write it is not considered an error.
+     */
+    static void write(const Map &map, const QString &fileName,
+                      const MapFormat *format);
+
+private:
+    static QString cacheDirectory();
+    static QString cacheFileName(const QString &fileName);
+    static void prune();
+};
+
+} // namespace Internal
+} // namespace Tiled
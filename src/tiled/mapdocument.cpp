@@ -38,6 +38,7 @@
 #include "isometricrenderer.h"
 #include "layermodel.h"
 #include "map.h"
+#include "mapcache.h"
 #include "mapobject.h"
 #include "mapobjectmodel.h"
 #include "movelayer.h"
@@ -153,12 +154,19 @@ MapDocumentPtr MapDocument::load(const QString &fileName,
                                  MapFormat *format,
                                  QString *error)
 {
-	Map *map = format->read(fileName, Preferences::instance()->settings());
+    // Reopening a map is much quicker from its cached snapshot
+    Map *map = MapCache::read(fileName, format);
 
     if (!map) {
-        if (error)
-            *error = format->errorString();
-        return MapDocumentPtr();
+        map = format->read(fileName, Preferences::instance()->settings());
+
+        if (!map) {
+            if (error)
+                *error = format->errorString();
+            return MapDocumentPtr();
+        }
+
+        MapCache::write(*map, fileName, format);
     }
 
     MapDocumentPtr document = MapDocumentPtr::create(map, fileName);
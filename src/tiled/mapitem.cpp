@@ -34,6 +34,7 @@
 #include "tilelayer.h"
 #include "tilelayeritem.h"
 #include "tileselectionitem.h"
+#include "tilesetmanager.h"
 #include "zoomable.h"
 
 #include <QCursor>
@@ -154,12 +155,17 @@ MapItem::MapItem(const MapDocumentPtr &mapDocument, DisplayMode displayMode,
     connect(mapDocument.data(), &MapDocument::selectedLayersChanged, this, &MapItem::updateCurrentLayerHighlight);
     connect(mapDocument.data(), &MapDocument::tilesetTileOffsetChanged, this, &MapItem::adaptToTilesetTileSizeChanges);
     connect(mapDocument.data(), &MapDocument::tileImageSourceChanged, this, &MapItem::adaptToTileSizeChanges);
+    connect(mapDocument.data(), &MapDocument::tileAnimationChanged, this, &MapItem::tileAnimationChanged);
     connect(mapDocument.data(), &MapDocument::tilesetReplaced, this, &MapItem::tilesetReplaced);
     connect(mapDocument.data(), &MapDocument::objectsInserted, this, &MapItem::objectsInserted);
     connect(mapDocument.data(), &MapDocument::objectsRemoved, this, &MapItem::objectsRemoved);
     connect(mapDocument.data(), &MapDocument::objectsChanged, this, &MapItem::objectsChanged);
     connect(mapDocument.data(), &MapDocument::objectsIndexChanged, this, &MapItem::objectsIndexChanged);
 
+    TilesetManager *tilesetManager = TilesetManager::instance();
+    connect(tilesetManager, &TilesetManager::tilesetImagesChanged, this, &MapItem::tilesetImagesChanged);
+    connect(tilesetManager, &TilesetManager::repaintTileset, this, &MapItem::tileAnimationsChanged);
+
     updateBoundingRect();
 
     mDarkRectangle->setPen(Qt::NoPen);
@@ -276,6 +282,7 @@ void MapItem::repaintRegion(const QRegion &region, TileLayer *tileLayer)
                             margins.right(),
                             margins.bottom());
 
+        tileLayerItem->invalidateCache(boundingRect);
         tileLayerItem->update(boundingRect);
     }
 }
@@ -286,8 +293,10 @@ void MapItem::repaintRegion(const QRegion &region, TileLayer *tileLayer)
 void MapItem::mapChanged()
 {
     for (QGraphicsItem *item : qAsConst(mLayerItems)) {
-        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item)) {
             tli->syncWithTileLayer();
+            tli->invalidateCache();     // render order may have changed
+        }
     }
 
     syncAllObjectItems();
@@ -428,9 +437,13 @@ void MapItem::imageLayerChanged(ImageLayer *imageLayer)
  */
 void MapItem::adaptToTilesetTileSizeChanges(Tileset *tileset)
 {
-    for (QGraphicsItem *item : qAsConst(mLayerItems))
-        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+    for (QGraphicsItem *item : qAsConst(mLayerItems)) {
+        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item)) {
             tli->syncWithTileLayer();
+            if (tli->tileLayer()->referencesTileset(tileset))
+                tli->invalidateCache();
+        }
+    }
 
     for (MapObjectItem *item : qAsConst(mObjectItems)) {
         const Cell &cell = item->mapObject()->cell();
@@ -441,9 +454,13 @@ void MapItem::adaptToTilesetTileSizeChanges(Tileset *tileset)
 
 void MapItem::adaptToTileSizeChanges(Tile *tile)
 {
-    for (QGraphicsItem *item : qAsConst(mLayerItems))
-        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+    for (QGraphicsItem *item : qAsConst(mLayerItems)) {
+        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item)) {
             tli->syncWithTileLayer();
+            if (tli->tileLayer()->referencesTileset(tile->tileset()))
+                tli->invalidateCache();
+        }
+    }
 
     for (MapObjectItem *item : qAsConst(mObjectItems)) {
         const Cell &cell = item->mapObject()->cell();
@@ -458,6 +475,38 @@ void MapItem::tilesetReplaced(int index, Tileset *tileset)
     adaptToTilesetTileSizeChanges(tileset);
 }
 
+void MapItem::tilesetImagesChanged(Tileset *tileset)
+{
+    for (QGraphicsItem *item : qAsConst(mLayerItems))
+        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+            if (tli->tileLayer()->referencesTileset(tileset))
+                tli->invalidateCache();
+}
+
+/**
+ * Only the chunks showing animated tiles need to be rendered again when the
+ * tile animations advance.
+ */
+void MapItem::tileAnimationsChanged(Tileset *tileset)
+{
+    for (QGraphicsItem *item : qAsConst(mLayerItems))
+        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+            tli->invalidateAnimatedTiles(tileset);
+}
+
+/**
+ * The cached chunks only know which of their tiles were animated when they
+ * were rendered, so a tile that became animated needs the chunks of all
+ * layers using its tileset to be rendered again.
+ */
+void MapItem::tileAnimationChanged(Tile *tile)
+{
+    for (QGraphicsItem *item : qAsConst(mLayerItems))
+        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+            if (tli->tileLayer()->referencesTileset(tile->tileset()))
+                tli->invalidateCache();
+}
+
 /**
  * Inserts map object items for the given objects.
  */
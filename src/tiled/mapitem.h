@@ -102,6 +102,9 @@ private:
     void adaptToTileSizeChanges(Tile *tile);
 
     void tilesetReplaced(int index, Tileset *tileset);
+    void tilesetImagesChanged(Tileset *tileset);
+    void tileAnimationsChanged(Tileset *tileset);
+    void tileAnimationChanged(Tile *tile);
 
     void objectsInserted(ObjectGroup *objectGroup, int first, int last);
     void objectsRemoved(const QList<MapObject*> &objects);
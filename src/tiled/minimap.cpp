@@ -22,18 +22,124 @@
 #include "minimap.h"
 
 #include "documentmanager.h"
+#include "grouplayer.h"
 #include "map.h"
 #include "mapdocument.h"
 #include "maprenderer.h"
 #include "mapscene.h"
 #include "mapview.h"
+#include "tile.h"
+#include "tilesetmanager.h"
 #include "utils.h"
 #include "zoomable.h"
 
 #include <QCursor>
+#include <QGuiApplication>
 #include <QResizeEvent>
 #include <QScrollBar>
 #include <QUndoStack>
+#include <QtConcurrentRun>
+
+#include "qtcompat_p.h"
+
+namespace Tiled {
+namespace Internal {
+
+/**
+ * A copy of a map that the minimap can be rendered from on another thread,
+ * while the map itself keeps being edited.
+ *
+ * The cells of tile layers are implicitly shared, but map objects have to be
+ * copied one by one, so object groups are only included when needed. The
+ * map is rendered with copies of its tilesets, because their tile images may
+ * change while rendering. These copies are kept by the MiniMap between
+ * renders.
+ */
+class MapSnapshot
+{
+public:
+    MapSnapshot(const Map &map, bool includeObjects,
+                const QVector<QPair<SharedTileset, SharedTileset>> &tilesetCopies)
+        : mTilesetCopies(tilesetCopies)
+    {
+        if (includeObjects) {
+            mMap.reset(new Map(map));
+        } else {
+            mMap.reset(new Map(map.orientation(), map.size(), map.tileSize(), map.infinite()));
+            mMap->setRenderOrder(map.renderOrder());
+            mMap->setHexSideLength(map.hexSideLength());
+            mMap->setStaggerAxis(map.staggerAxis());
+            mMap->setStaggerIndex(map.staggerIndex());
+            mMap->setBackgroundColor(map.backgroundColor());
+
+            for (const SharedTileset &tileset : map.tilesets())
+                mMap->addTileset(tileset);
+
+            for (const Layer *layer : map.layers())
+                if (Layer *copy = copyWithoutObjects(layer))
+                    mMap->addLayer(copy);
+        }
+    }
+
+    /**
+     * Returns the copied map. Pointing its cells at the copied tilesets is
+     * done here rather than in the constructor, so that it happens on the
+     * rendering thread.
+     */
+    Map *map()
+    {
+        for (const auto &copy : qAsConst(mTilesetCopies))
+            mMap->replaceTileset(copy.first, copy.second);
+
+        mTilesetCopies.clear();
+        return mMap.get();
+    }
+
+private:
+    static Layer *copyWithoutObjects(const Layer *layer)
+    {
+        switch (layer->layerType()) {
+        case Layer::ObjectGroupType:
+            return nullptr;
+        case Layer::GroupLayerType: {
+            const GroupLayer *groupLayer = static_cast<const GroupLayer*>(layer);
+            GroupLayer *copy = new GroupLayer(layer->name(), layer->x(), layer->y());
+            copy->setOpacity(layer->opacity());
+            copy->setVisible(layer->isVisible());
+            copy->setOffset(layer->offset());
+
+            for (const Layer *childLayer : groupLayer->layers())
+                if (Layer *childCopy = copyWithoutObjects(childLayer))
+                    copy->addLayer(childCopy);
+
+            return copy;
+        }
+        default:
+            return layer->clone();
+        }
+    }
+
+    std::unique_ptr<Map> mMap;
+    QVector<QPair<SharedTileset, SharedTileset>> mTilesetCopies;
+};
+
+/**
+ * Tile images are pixmaps, which may only be drawn from other threads when
+ * the platform supports it. The platform capabilities are only available
+ * through Qt's private API, so this checks for the platforms known to
+ * support it instead.
+ */
+static bool canRenderInThread()
+{
+    const QString platform = QGuiApplication::platformName();
+    return platform == QLatin1String("xcb") ||
+            platform == QLatin1String("windows") ||
+            platform == QLatin1String("cocoa") ||
+            platform.startsWith(QLatin1String("wayland"));
+}
+
+} // namespace Internal
+} // namespace Tiled
 
 using namespace Tiled;
 using namespace Tiled::Internal;
@@ -49,6 +155,9 @@ MiniMap::MiniMap(QWidget *parent)
                    | MiniMapRenderer::DrawImageLayers
                    | MiniMapRenderer::IgnoreInvisibleLayer
                    | MiniMapRenderer::SmoothPixmapTransform)
+    , mRenderedDocument(nullptr)
+    , mRenderingCoarse(false)
+    , mRenderPending(false)
 {
     setFrameStyle(QFrame::StyledPanel | QFrame::Sunken);
     setMinimumSize(50, 50);
@@ -59,6 +168,15 @@ MiniMap::MiniMap(QWidget *parent)
     mMapImageUpdateTimer.setSingleShot(true);
     connect(&mMapImageUpdateTimer, &QTimer::timeout,
             this, &MiniMap::redrawTimeout);
+    connect(&mRenderWatcher, &QFutureWatcherBase::finished,
+            this, &MiniMap::renderFinished);
+    connect(TilesetManager::instance(), &TilesetManager::tilesetImagesChanged,
+            this, &MiniMap::tilesetChanged);
+}
+
+MiniMap::~MiniMap()
+{
+    mRenderWatcher.waitForFinished();
 }
 
 void MiniMap::setMapDocument(MapDocument *map)
@@ -80,6 +198,10 @@ void MiniMap::setMapDocument(MapDocument *map)
     if (mMapDocument) {
         connect(mMapDocument->undoStack(), &QUndoStack::indexChanged,
                 this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::tilesetTileOffsetChanged,
+                this, &MiniMap::tilesetChanged);
+        connect(mMapDocument, &MapDocument::tileImageSourceChanged,
+                this, &MiniMap::tileImageSourceChanged);
 
         if (MapView *mapView = dm->viewForDocument(mMapDocument)) {
             connect(mapView->horizontalScrollBar(), &QAbstractSlider::valueChanged, this, [this] { update(); });
@@ -162,10 +284,26 @@ void MiniMap::updateImageRect()
     mImageRect = imageRect;
 }
 
+/**
+ * Starts rendering the minimap image on another thread. When the image size
+ * changed, a coarse image is rendered first to have something to show
+ * quickly, after which it is refined.
+ */
 void MiniMap::renderMapToImage()
 {
+    // Render again once the current pass has finished
+    if (mRenderWatcher.isRunning()) {
+        mRenderPending = true;
+        return;
+    }
+
+    mRenderPending = false;
+    mRenderedDocument = mMapDocument;
+
     if (!mMapDocument) {
         mMapImage = QImage();
+        mSnapshot.reset();
+        mTilesetCopies.clear();
         return;
     }
 
@@ -179,6 +317,7 @@ void MiniMap::renderMapToImage()
 
     if (mapSize.isEmpty()) {
         mMapImage = QImage();
+        mSnapshot.reset();
         return;
     }
 
@@ -186,18 +325,103 @@ void MiniMap::renderMapToImage()
     qreal scale = qMin((qreal) viewSize.width() / mapSize.width(),
                        (qreal) viewSize.height() / mapSize.height());
 
-    // Allocate a new image when the size changed
     const QSize imageSize = mapSize * scale;
-    if (mMapImage.size() != imageSize) {
-        mMapImage = QImage(imageSize, QImage::Format_ARGB32_Premultiplied);
-        updateImageRect();
-    }
-
     if (imageSize.isEmpty())
         return;
 
-    MiniMapRenderer miniMapRenderer(mMapDocument->map());
-    miniMapRenderer.renderToImage(mMapImage, mRenderFlags);
+    mRenderSize = imageSize;
+
+    if (!canRenderInThread()) {
+        MiniMapRenderer miniMapRenderer(mMapDocument->map());
+        setMapImage(miniMapRenderer.render(imageSize, mRenderFlags));
+        return;
+    }
+
+    mSnapshot = std::make_shared<MapSnapshot>(*mMapDocument->map(),
+                                              mRenderFlags.testFlag(MiniMapRenderer::DrawMapObjects),
+                                              updateTilesetCopies());
+
+    if (mMapImage.isNull() || mMapImageSize != imageSize) {
+        MiniMapRenderer::RenderFlags coarseFlags = mRenderFlags;
+        coarseFlags &= ~MiniMapRenderer::DrawMapObjects;
+        coarseFlags &= ~MiniMapRenderer::SmoothPixmapTransform;
+
+        mRenderingCoarse = true;
+        startRender((imageSize / 4).expandedTo(QSize(1, 1)), coarseFlags);
+    } else {
+        mRenderingCoarse = false;
+        startRender(imageSize, mRenderFlags);
+    }
+}
+
+/**
+ * Returns the tilesets of the current map paired with their copies. Copies
+ * made for earlier renders are reused, unless tiles were added or removed
+ * since. Copies of tilesets no longer used by the map are dropped.
+ */
+QVector<QPair<SharedTileset, SharedTileset>> MiniMap::updateTilesetCopies()
+{
+    QVector<QPair<SharedTileset, SharedTileset>> pairs;
+    QMap<SharedTileset, SharedTileset> copies;
+
+    for (const SharedTileset &tileset : mMapDocument->map()->tilesets()) {
+        SharedTileset copy = mTilesetCopies.value(tileset);
+        if (!copy || copy->tileCount() != tileset->tileCount() ||
+                copy->nextTileId() != tileset->nextTileId()) {
+            copy = tileset->clone();
+        }
+
+        copies.insert(tileset, copy);
+        pairs.append(qMakePair(tileset, copy));
+    }
+
+    mTilesetCopies = copies;
+    return pairs;
+}
+
+void MiniMap::tilesetChanged(Tileset *tileset)
+{
+    mTilesetCopies.remove(tileset->sharedPointer());
+    scheduleMapImageUpdate();
+}
+
+void MiniMap::tileImageSourceChanged(Tile *tile)
+{
+    tilesetChanged(tile->tileset());
+}
+
+void MiniMap::startRender(QSize size, MiniMapRenderer::RenderFlags renderFlags)
+{
+    const std::shared_ptr<MapSnapshot> snapshot = mSnapshot;
+
+    mRenderWatcher.setFuture(QtConcurrent::run([=] {
+        MiniMapRenderer miniMapRenderer(snapshot->map());
+        return miniMapRenderer.render(size, renderFlags);
+    }));
+}
+
+void MiniMap::renderFinished()
+{
+    // Don't show the map of a document that is no longer displayed
+    if (mRenderedDocument == mMapDocument)
+        setMapImage(mRenderWatcher.result());
+
+    if (mRenderPending) {
+        renderMapToImage();
+    } else if (mRenderingCoarse) {
+        mRenderingCoarse = false;
+        startRender(mRenderSize, mRenderFlags);
+    } else {
+        mSnapshot.reset();
+    }
+}
+
+void MiniMap::setMapImage(const QImage &image)
+{
+    mMapImage = image;
+    mMapImageSize = mRenderSize;
+    updateImageRect();
+    update();
 }
 
 void MiniMap::centerViewOnLocalPixel(QPoint centerPos, int delta)
@@ -22,15 +22,21 @@
 #pragma once
 
 #include "minimaprenderer.h"
+#include "tileset.h"
 
 #include <QFrame>
+#include <QFutureWatcher>
 #include <QImage>
+#include <QMap>
 #include <QTimer>
 
+#include <memory>
+
 namespace Tiled {
 namespace Internal {
 
 class MapDocument;
+class MapSnapshot;
 
 class MiniMap : public QFrame
 {
@@ -38,6 +44,7 @@ class MiniMap : public QFrame
 
 public:
     MiniMap(QWidget *parent);
+    ~MiniMap() override;
 
     void setMapDocument(MapDocument *);
 
@@ -60,6 +67,10 @@ protected:
 
 private slots:
     void redrawTimeout();
+    void renderFinished();
+
+    void tilesetChanged(Tileset *tileset);
+    void tileImageSourceChanged(Tile *tile);
 
 private:
     MapDocument *mMapDocument;
@@ -72,10 +83,22 @@ private:
     bool mRedrawMapImage;
     MiniMapRenderer::RenderFlags mRenderFlags;
 
+    QFutureWatcher<QImage> mRenderWatcher;
+    std::shared_ptr<MapSnapshot> mSnapshot;
+    QMap<SharedTileset, SharedTileset> mTilesetCopies;
+    MapDocument *mRenderedDocument;
+    QSize mRenderSize;
+    QSize mMapImageSize;
+    bool mRenderingCoarse;
+    bool mRenderPending;
+
     QRect viewportRect() const;
     QPointF mapToScene(QPoint p) const;
     void updateImageRect();
     void renderMapToImage();
+    QVector<QPair<SharedTileset, SharedTileset>> updateTilesetCopies();
+    void startRender(QSize size, MiniMapRenderer::RenderFlags renderFlags);
+    void setMapImage(const QImage &image);
     void centerViewOnLocalPixel(QPoint centerPos, int delta = 0);
 };
 
@@ -80,53 +80,35 @@ static bool objectLessThan(const MapObject *a, const MapObject *b)
     return a->y() < b->y();
 }
 
-static QRectF cellRect(const MapRenderer &renderer,
-                       const Cell &cell,
-                       const QPointF &tileCoords)
-{
-    const Tile *tile = cell.tile();
-    if (!tile)
-        return QRectF();
-
-    QPointF pixelCoords = renderer.tileToScreenCoords(tileCoords);
-    QPointF offset = tile->offset();
-    QSize size = tile->size();
-
-    if (cell.flippedAntiDiagonally())
-        std::swap(size.rwidth(), size.rheight());
-
-    // This is a correction needed because tileToScreenCoords does not return
-    // the bottom-left origin of the tile image, but rather the top-left
-    // corner of the cell.
-    pixelCoords.ry() += renderer.map()->tileHeight() - size.height();
-
-    return QRectF(pixelCoords, size).translated(offset);
-}
-
 static void extendMapRect(QRect &mapBoundingRect, const MapRenderer &renderer)
 {
     // Start with the basic map size
     QRectF rect(mapBoundingRect);
 
-    // Take into account large tiles extending beyond their cell
-    for (const Layer *layer : renderer.map()->layers()) {
+    const Map *map = renderer.map();
+
+    // Take into account large tiles extending beyond their cell. The bounds
+    // and used tilesets of a layer are kept up to date as its cells change,
+    // so there is no need to look at the individual cells.
+    for (const Layer *layer : map->layers()) {
         if (layer->layerType() != Layer::TileLayerType)
             continue;
 
         const TileLayer *tileLayer = static_cast<const TileLayer*>(layer);
-        const QPointF offset = tileLayer->totalOffset();
+        const QRect bounds = tileLayer->bounds();
+        if (bounds.isEmpty())
+            continue;
 
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
-                const Cell &cell = tileLayer->cellAt(x, y);
+        QMargins margins = tileLayer->drawMargins();
+        margins.setTop(margins.top() - map->tileHeight());
+        margins.setRight(margins.right() - map->tileWidth());
 
-                if (!cell.isEmpty()) {
-                    QRectF r = cellRect(renderer, cell, QPointF(x, y));
-                    r.translate(offset);
-                    rect |= r;
-                }
-            }
-        }
+        QRectF r = renderer.boundingRect(bounds).adjusted(-margins.left(),
+                                                          -margins.top(),
+                                                          margins.right(),
+                                                          margins.bottom());
+        r.translate(tileLayer->totalOffset());
+        rect |= r;
     }
 
     mapBoundingRect = rect.toAlignedRect();
@@ -49,6 +49,7 @@
 #include <QGraphicsView>
 #include <QKeyEvent>
 #include <QMenu>
+#include <QSet>
 #include <QTransform>
 #include <QUndoStack>
 
@@ -1092,8 +1093,9 @@ void ObjectSelectionTool::updateSelection(const QPointF &pos,
     }
 
     if (modifiers & (Qt::ControlModifier | Qt::ShiftModifier)) {
+        const QSet<MapObject*> rubberBandObjects = selectedObjects.toSet();
         for (MapObject *object : mapDocument()->selectedObjects())
-            if (!selectedObjects.contains(object))
+            if (!rubberBandObjects.contains(object))
                 selectedObjects.append(object);
     } else {
         setMode(Resize);    // new selection resets edit mode
@@ -59,9 +59,11 @@ PaintTileLayer::PaintTileLayer(MapDocument *mapDocument,
     auto &data = mLayerData[target];
 
     data.mSource = source->clone();
-    data.mErased = target->copy(x - target->x(),
-                                y - target->y(),
-                                source->width(), source->height());
+
+    // Only the chunks touched by the paint are kept, and they are shared with
+    // the target layer until it changes
+    data.mErased = target->copyChunks(paintRegion.translated(-target->position()));
+    data.mErased->setPosition(data.mErased->position() + target->position());
     data.mX = x;
     data.mY = y;
     data.mPaintedRegion = paintRegion;
@@ -83,7 +85,7 @@ void PaintTileLayer::undo()
     while (it.hasNext()) {
         const LayerData &data = it.next().value();
         TilePainter painter(mMapDocument, it.key());
-        painter.setCells(data.mX, data.mY, data.mErased, data.mPaintedRegion);
+        painter.setCells(data.mErased->x(), data.mErased->y(), data.mErased, data.mPaintedRegion);
     }
 
     QUndoCommand::undo(); // undo child commands
@@ -117,13 +119,23 @@ void PaintTileLayer::LayerData::mergeWith(const PaintTileLayer::LayerData &o)
     const QRect bounds = QRect(mX, mY, mSource->width(), mSource->height());
     const QRect combinedBounds = combinedRegion.boundingRect();
 
-    // Resize the erased tiles and source layers when necessary
+    // Resize the source layer when necessary
     if (bounds != combinedBounds) {
         const QPoint shift = bounds.topLeft() - combinedBounds.topLeft();
-        mErased->resize(combinedBounds.size(), shift);
         mSource->resize(combinedBounds.size(), shift);
     }
 
+    // Extend the erased chunks to also cover those of the other command.
+    // Both are aligned to the chunks of the target layer, so this moves
+    // whole chunks.
+    const QRect erasedRect = mErased->rect();
+    const QRect combinedErasedRect = erasedRect.united(o.mErased->rect());
+    if (erasedRect != combinedErasedRect) {
+        mErased->resize(combinedErasedRect.size(),
+                        erasedRect.topLeft() - combinedErasedRect.topLeft());
+        mErased->setPosition(combinedErasedRect.topLeft());
+    }
+
     mX = combinedBounds.left();
     mY = combinedBounds.top();
     mPaintedRegion = combinedRegion;
@@ -133,17 +145,12 @@ void PaintTileLayer::LayerData::mergeWith(const PaintTileLayer::LayerData &o)
     mSource->merge(pos, o.mSource);
 
     // Copy the newly erased tiles from the other command over
-#if QT_VERSION >= 0x050800
-    for (const QRect &rect : newRegion)
-#else
-    const auto rects = newRegion.rects();
-    for (const QRect &rect : rects)
-#endif
-        for (int y = rect.top(); y <= rect.bottom(); ++y)
-            for (int x = rect.left(); x <= rect.right(); ++x)
-                mErased->setCell(x - mX,
-                                 y - mY,
-                                 o.mErased->cellAt(x - o.mX, y - o.mY));
+    if (!newRegion.isEmpty()) {
+        mErased->setCells(o.mErased->x() - mErased->x(),
+                          o.mErased->y() - mErased->y(),
+                          o.mErased,
+                          newRegion.translated(-mErased->position()));
+    }
 }
 
 bool PaintTileLayer::mergeWith(const QUndoCommand *other)
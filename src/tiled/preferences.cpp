@@ -65,6 +65,7 @@ Preferences::Preferences()
             (intValue("MapRenderOrder", Map::RightDown));
     mDtdEnabled = boolValue("DtdEnabled");
     mSafeSavingEnabled = boolValue("SafeSavingEnabled", true);
+    mUndoLimit = intValue("UndoLimit", 0);
     mReloadTilesetsOnChange = boolValue("ReloadTilesets", true);
     mStampsDirectory = stringValue("StampsDirectory");
     mTemplatesDirectory = stringValue("TemplatesDirectory");
@@ -511,6 +512,17 @@ void Preferences::setSafeSavingEnabled(bool enabled)
     SaveFile::setSafeSavingEnabled(enabled);
 }
 
+/**
+ * Sets the maximum number of undo steps, where 0 means unlimited (the
+ * default). Since an undo limit can only be set on an empty undo stack, this
+ * applies to documents opened afterwards.
+ */
+void Preferences::setUndoLimit(int limit)
+{
+    mUndoLimit = limit;
+    mSettings->setValue(QLatin1String("Storage/UndoLimit"), limit);
+}
+
 QString Preferences::language() const
 {
     return mLanguage;
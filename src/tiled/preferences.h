@@ -108,6 +108,9 @@ public:
     bool safeSavingEnabled() const;
     void setSafeSavingEnabled(bool enabled);
 
+    int undoLimit() const;
+    void setUndoLimit(int limit);
+
     QString language() const;
     void setLanguage(const QString &language);
 
@@ -295,6 +298,7 @@ private:
     Map::RenderOrder mMapRenderOrder;
     bool mDtdEnabled;
     bool mSafeSavingEnabled;
+    int mUndoLimit;
     QString mLanguage;
     bool mReloadTilesetsOnChange;
     bool mUseOpenGL;
@@ -342,6 +346,15 @@ inline bool Preferences::safeSavingEnabled() const
     return mSafeSavingEnabled;
 }
 
+/**
+ * Returns the maximum number of steps kept in the undo history of a
+ * document, or 0 when it is unlimited.
+ */
+inline int Preferences::undoLimit() const
+{
+    return mUndoLimit;
+}
+
 inline bool Preferences::highlightHoveredObject() const
 {
     return mHighlightHoveredObject;
@@ -32,6 +32,7 @@
 #include "changetileprobability.h"
 #include "changewangsetdata.h"
 #include "changewangcolordata.h"
+#include "compression.h"
 #include "flipmapobjects.h"
 #include "imagelayer.h"
 #include "map.h"
@@ -595,6 +596,19 @@ void PropertyBrowser::addMapProperties()
 
     layerFormatProperty->setAttribute(QLatin1String("enumNames"), mLayerFormatNames);
 
+    // The compression level only applies to compressed layer formats
+    const Map::LayerDataFormat layerDataFormat = static_cast<const Map*>(mObject)->layerDataFormat();
+    if (isCompressed(layerDataFormat)) {
+        QtVariantProperty *compressionLevelProperty =
+                addProperty(CompressionLevelProperty, QVariant::Int, tr("Compression Level"), groupProperty);
+
+        compressionLevelProperty->setAttribute(QLatin1String("minimum"), -1);
+        compressionLevelProperty->setAttribute(QLatin1String("maximum"),
+                                               maximumCompressionLevel(compressionMethod(layerDataFormat)));
+        compressionLevelProperty->setToolTip(tr("The level used when compressing the tile layer data. "
+                                                "Use -1 for the default level."));
+    }
+
     QtVariantProperty *renderOrderProperty =
             addProperty(RenderOrderProperty,
                         QtVariantPropertyManager::enumTypeId(),
@@ -978,6 +992,11 @@ void PropertyBrowser::applyMapValue(PropertyId id, const QVariant &val)
         command = new ChangeMapProperty(mMapDocument, format);
         break;
     }
+    case CompressionLevelProperty: {
+        command = new ChangeMapProperty(mMapDocument, ChangeMapProperty::CompressionLevel,
+                                        val.toInt());
+        break;
+    }
     case RenderOrderProperty: {
         Map::RenderOrder renderOrder = static_cast<Map::RenderOrder>(val.toInt());
         command = new ChangeMapProperty(mMapDocument, renderOrder);
@@ -1543,6 +1562,19 @@ void PropertyBrowser::updateProperties()
     switch (mObject->typeId()) {
     case Object::MapType: {
         const Map *map = static_cast<const Map*>(mObject);
+
+        // Changing the layer format may add, remove or limit the compression level
+        QtVariantProperty *compressionLevelProperty = mIdToProperty.value(CompressionLevelProperty);
+        const Map::LayerDataFormat layerDataFormat = map->layerDataFormat();
+        const bool compressed = isCompressed(layerDataFormat);
+        if (compressed != (compressionLevelProperty != nullptr) ||
+                (compressed && compressionLevelProperty->attributeValue(QLatin1String("maximum")).toInt() !=
+                 maximumCompressionLevel(compressionMethod(layerDataFormat)))) {
+            removeProperties();
+            addProperties();
+            return;
+        }
+
         mIdToProperty[WidthProperty]->setValue(map->width());
         mIdToProperty[HeightProperty]->setValue(map->height());
         mIdToProperty[TileWidthProperty]->setValue(map->tileWidth());
@@ -1555,6 +1587,8 @@ void PropertyBrowser::updateProperties()
         mIdToProperty[StaggerAxisProperty]->setValue(map->staggerAxis());
         mIdToProperty[StaggerIndexProperty]->setValue(map->staggerIndex());
         mIdToProperty[LayerFormatProperty]->setValue(map->layerDataFormat());
+        if (compressionLevelProperty)
+            compressionLevelProperty->setValue(map->compressionLevel());
         mIdToProperty[RenderOrderProperty]->setValue(map->renderOrder());
         mIdToProperty[BackgroundColorProperty]->setValue(map->backgroundColor());
         break;
@@ -1881,6 +1915,8 @@ void PropertyBrowser::retranslateUi()
     mLayerFormatNames.append(QCoreApplication::translate("PreferencesDialog", "Base64 (gzip compressed)"));
     mLayerFormatNames.append(QCoreApplication::translate("PreferencesDialog", "Base64 (zlib compressed)"));
     mLayerFormatNames.append(QCoreApplication::translate("PreferencesDialog", "CSV"));
+    if (compressionSupported(Zstandard))
+        mLayerFormatNames.append(QCoreApplication::translate("PreferencesDialog", "Base64 (Zstandard compressed)"));
 
     mRenderOrderNames.append(QCoreApplication::translate("PreferencesDialog", "Right Down"));
     mRenderOrderNames.append(QCoreApplication::translate("PreferencesDialog", "Right Up"));
@@ -146,6 +146,7 @@ private:
         StaggerIndexProperty,
         RenderOrderProperty,
         LayerFormatProperty,
+        CompressionLevelProperty,
         ImageSourceProperty,
         TilesetImageParametersProperty,
         FlippingProperty,
@@ -15,6 +15,7 @@ win32 {
 
 QT += widgets
 QT += xml
+QT += concurrent
 
 contains(QT_CONFIG, opengl):!macx:!minQtVersion(5, 4, 0) {
     QT += opengl
@@ -156,6 +157,7 @@ SOURCES += aboutdialog.cpp \
     main.cpp \
     maintoolbar.cpp \
     mainwindow.cpp \
+    mapcache.cpp \
     mapdocumentactionhandler.cpp \
     mapdocument.cpp \
     mapeditor.cpp \
@@ -352,6 +354,7 @@ HEADERS += aboutdialog.h \
     magicwandtool.h \
     maintoolbar.h \
     mainwindow.h \
+    mapcache.h \
     mapdocumentactionhandler.h \
     mapdocument.h \
     mapeditor.h \
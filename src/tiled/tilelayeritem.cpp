@@ -28,18 +28,41 @@
 #include <QPainter>
 #include <QStyleOptionGraphicsItem>
 
+#include <QtMath>
+
 using namespace Tiled;
 using namespace Tiled::Internal;
 
+// Cost is in kilobytes, so this allows for 256 MB of pixmaps, shared by
+// all tile layers in all open maps
+static const int maxCacheCost = 256 * 1024;
+
+// Above this size, a chunk is drawn directly instead of being cached. At
+// such zoom levels only a few tiles are visible anyway.
+static const int maxChunkPixmapSize = 1024;
+
+static int chunkCoordinate(int tile)
+{
+    return tile < 0 ? (tile + 1) / CHUNK_SIZE - 1 : tile / CHUNK_SIZE;
+}
+
+QCache<TileLayerItem::ChunkKey, TileLayerItem::CachedChunk> TileLayerItem::sChunkCache(maxCacheCost);
+
 TileLayerItem::TileLayerItem(TileLayer *layer, MapDocument *mapDocument, QGraphicsItem *parent)
     : LayerItem(layer, parent)
     , mMapDocument(mapDocument)
+    , mCacheScale(0)
 {
     setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
 
     syncWithTileLayer();
 }
 
+TileLayerItem::~TileLayerItem()
+{
+    invalidateCache();
+}
+
 void TileLayerItem::syncWithTileLayer()
 {
     prepareGeometryChange();
@@ -48,15 +71,63 @@ void TileLayerItem::syncWithTileLayer()
     QRectF boundingRect = renderer->boundingRect(tileLayer()->bounds());
 
     QMargins margins = tileLayer()->drawMargins();
+    QSize tileSize;
     if (const Map *map = tileLayer()->map()) {
         margins.setTop(margins.top() - map->tileHeight());
         margins.setRight(margins.right() - map->tileWidth());
+        tileSize = map->tileSize();
     }
 
     mBoundingRect = boundingRect.adjusted(-margins.left(),
                                           -margins.top(),
                                           margins.right(),
                                           margins.bottom());
+
+    // A change of bounds alone doesn't affect the cached chunks
+    if (margins != mDrawMargins || tileSize != mTileSize) {
+        mDrawMargins = margins;
+        mTileSize = tileSize;
+        invalidateCache();
+    }
+}
+
+void TileLayerItem::invalidateCache()
+{
+    const auto keys = sChunkCache.keys();
+    for (const ChunkKey &key : keys)
+        if (key.item == this)
+            sChunkCache.remove(key);
+}
+
+void TileLayerItem::invalidateCache(const QRectF &rect)
+{
+    if (sChunkCache.isEmpty() || rect.isEmpty())
+        return;
+
+    const QRect chunks = chunksInRect(rect);
+    if (chunks.width() * chunks.height() > sChunkCache.size()) {
+        const auto keys = sChunkCache.keys();
+        for (const ChunkKey &key : keys)
+            if (key.item == this && chunks.contains(key.chunk))
+                sChunkCache.remove(key);
+    } else {
+        for (int y = chunks.top(); y <= chunks.bottom(); ++y)
+            for (int x = chunks.left(); x <= chunks.right(); ++x)
+                sChunkCache.remove(ChunkKey { this, QPoint(x, y) });
+    }
+}
+
+void TileLayerItem::invalidateAnimatedTiles(const Tileset *tileset)
+{
+    const auto keys = sChunkCache.keys();
+    for (const ChunkKey &key : keys) {
+        if (key.item != this)
+            continue;
+
+        const CachedChunk *cached = sChunkCache.object(key);
+        if (cached->animatedTilesets.contains(tileset))
+            sChunkCache.remove(key);
+    }
 }
 
 QRectF TileLayerItem::boundingRect() const
@@ -69,6 +140,181 @@ void TileLayerItem::paint(QPainter *painter,
                           QWidget *)
 {
     MapRenderer *renderer = mMapDocument->renderer();
-    // TODO: Display a border around the layer when selected
-    renderer->drawTileLayer(painter, tileLayer(), option->exposedRect);
+
+    // Chunks only map to rectangles on screen in orthogonal maps
+    if (!renderer->isOrthogonal() || mTileSize.isEmpty()) {
+        // TODO: Display a border around the layer when selected
+        renderer->drawTileLayer(painter, tileLayer(), option->exposedRect);
+        return;
+    }
+
+#if QT_VERSION >= 0x050600
+    const qreal devicePixelRatio = painter->device()->devicePixelRatioF();
+#else
+    const int devicePixelRatio = painter->device()->devicePixelRatio();
+#endif
+    const qreal scale = devicePixelRatio *
+            QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+
+    if (scale != mCacheScale) {
+        invalidateCache();
+        mCacheScale = scale;
+    }
+
+    const QRectF exposed = option->exposedRect & mBoundingRect;
+    if (exposed.isEmpty())
+        return;
+
+    const QRect chunks = chunksInRect(exposed);
+
+    for (int y = chunks.top(); y <= chunks.bottom(); ++y) {
+        for (int x = chunks.left(); x <= chunks.right(); ++x) {
+            const QPoint chunk(x, y);
+
+            const CachedChunk *cached = sChunkCache.object(ChunkKey { this, chunk });
+            if (!cached) {
+                if (chunkIsEmpty(chunk))
+                    continue;
+
+                cached = renderChunk(chunk, painter->renderHints());
+                if (!cached) {
+                    const QRect deviceRect = chunkDeviceRect(chunk);
+                    const QRectF rect(deviceRect.x() / scale,
+                                      deviceRect.y() / scale,
+                                      deviceRect.width() / scale,
+                                      deviceRect.height() / scale);
+
+                    painter->save();
+                    painter->setClipRect(rect, Qt::IntersectClip);
+                    renderer->drawTileLayer(painter, tileLayer(), rect);
+                    painter->restore();
+                    continue;
+                }
+            }
+
+            const QRect &deviceRect = cached->deviceRect;
+            painter->drawPixmap(QRectF(deviceRect.x() / scale,
+                                       deviceRect.y() / scale,
+                                       deviceRect.width() / scale,
+                                       deviceRect.height() / scale),
+                                cached->pixmap,
+                                QRectF(cached->pixmap.rect()));
+        }
+    }
+}
+
+/**
+ * Returns the range of chunks overlapping \a rect, which is in pixels.
+ */
+QRect TileLayerItem::chunksInRect(const QRectF &rect) const
+{
+    const QPoint position = tileLayer()->position();
+
+    const int left = qFloor(rect.left() / mTileSize.width()) - position.x();
+    const int top = qFloor(rect.top() / mTileSize.height()) - position.y();
+    const int right = qCeil(rect.right() / mTileSize.width()) - 1 - position.x();
+    const int bottom = qCeil(rect.bottom() / mTileSize.height()) - 1 - position.y();
+
+    return QRect(QPoint(chunkCoordinate(left), chunkCoordinate(top)),
+                 QPoint(chunkCoordinate(right), chunkCoordinate(bottom)));
+}
+
+/**
+ * Returns the area covered by \a chunk in device pixels at the current
+ * scale. The edges are rounded, so that neighbouring chunks line up exactly.
+ */
+QRect TileLayerItem::chunkDeviceRect(QPoint chunk) const
+{
+    const QPoint position = tileLayer()->position();
+    const QRect tiles((chunk * CHUNK_SIZE) + position, QSize(CHUNK_SIZE, CHUNK_SIZE));
+    const QRect pixels = mMapDocument->renderer()->boundingRect(tiles);
+
+    return QRect(QPoint(qRound(pixels.left() * mCacheScale),
+                        qRound(pixels.top() * mCacheScale)),
+                 QPoint(qRound((pixels.right() + 1) * mCacheScale) - 1,
+                        qRound((pixels.bottom() + 1) * mCacheScale) - 1));
+}
+
+/**
+ * Returns how many tiles beyond their own cell tiles may be drawn.
+ */
+QSize TileLayerItem::tileReach() const
+{
+    const int x = qMax(0, qMax(mDrawMargins.left(), mDrawMargins.right()));
+    const int y = qMax(0, qMax(mDrawMargins.top(), mDrawMargins.bottom()));
+
+    return QSize((x + mTileSize.width() - 1) / mTileSize.width(),
+                 (y + mTileSize.height() - 1) / mTileSize.height());
+}
+
+/**
+ * Returns whether nothing is drawn within \a chunk. Tiles larger than the
+ * grid may reach into it from neighbouring chunks.
+ */
+bool TileLayerItem::chunkIsEmpty(QPoint chunk) const
+{
+    const QSize reach = tileReach();
+
+    const int left = chunkCoordinate(chunk.x() * CHUNK_SIZE - reach.width());
+    const int top = chunkCoordinate(chunk.y() * CHUNK_SIZE - reach.height());
+    const int right = chunkCoordinate(chunk.x() * CHUNK_SIZE + CHUNK_MASK + reach.width());
+    const int bottom = chunkCoordinate(chunk.y() * CHUNK_SIZE + CHUNK_MASK + reach.height());
+
+    const TileLayer *layer = tileLayer();
+    for (int y = top; y <= bottom; ++y)
+        for (int x = left; x <= right; ++x)
+            if (const Chunk *c = layer->findChunk(x * CHUNK_SIZE, y * CHUNK_SIZE))
+                if (!c->isEmpty())
+                    return false;
+
+    return true;
+}
+
+/**
+ * Renders \a chunk into a new cache entry. Returns null when the chunk is
+ * too large to be cached at the current scale.
+ */
+TileLayerItem::CachedChunk *TileLayerItem::renderChunk(QPoint chunk, QPainter::RenderHints hints)
+{
+    const QRect deviceRect = chunkDeviceRect(chunk);
+    if (deviceRect.width() > maxChunkPixmapSize || deviceRect.height() > maxChunkPixmapSize)
+        return nullptr;
+
+    CachedChunk *cached = new CachedChunk;
+    cached->deviceRect = deviceRect;
+    cached->pixmap = QPixmap(deviceRect.size());
+    cached->pixmap.fill(Qt::transparent);
+
+    const QRectF rect(deviceRect.x() / mCacheScale,
+                      deviceRect.y() / mCacheScale,
+                      deviceRect.width() / mCacheScale,
+                      deviceRect.height() / mCacheScale);
+
+    QPainter painter(&cached->pixmap);
+    painter.setRenderHints(hints);
+    painter.scale(mCacheScale, mCacheScale);
+    painter.translate(-rect.topLeft());
+    mMapDocument->renderer()->drawTileLayer(&painter, tileLayer(), rect);
+    painter.end();
+
+    // Remember which animated tiles are visible in this chunk, including
+    // those reaching into it from neighbouring chunks
+    const TileLayer *layer = tileLayer();
+    const QPoint position = layer->position();
+    const QSize reach = tileReach();
+    const QRect tiles = QRect(chunk * CHUNK_SIZE, QSize(CHUNK_SIZE, CHUNK_SIZE))
+            .adjusted(-reach.width(), -reach.height(), reach.width(), reach.height())
+            .intersected(layer->bounds().translated(-position));
+
+    for (int y = tiles.top(); y <= tiles.bottom(); ++y) {
+        for (int x = tiles.left(); x <= tiles.right(); ++x) {
+            const Tile *tile = layer->cellAt(x, y).tile();
+            if (tile && tile->isAnimated() && !cached->animatedTilesets.contains(tile->tileset()))
+                cached->animatedTilesets.append(tile->tileset());
+        }
+    }
+
+    const int cost = qMax(1, deviceRect.width() * deviceRect.height() * 4 / 1024);
+    sChunkCache.insert(ChunkKey { this, chunk }, cached, cost);
+    return cached;
 }
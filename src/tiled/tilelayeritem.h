@@ -24,13 +24,25 @@
 
 #include "tilelayer.h"
 
+#include <QCache>
+#include <QPainter>
+#include <QPixmap>
+#include <QVector>
+
 namespace Tiled {
+
+class Tileset;
+
 namespace Internal {
 
 class MapDocument;
 
 /**
  * A graphics item displaying a tile layer in a QGraphicsView.
+ *
+ * For orthogonal maps, the layer is rendered one chunk at a time into
+ * pixmaps at the current zoom level, which are reused until the chunk is
+ * invalidated. The cached chunks of all layers share a single budget.
  */
 class TileLayerItem : public LayerItem
 {
@@ -42,6 +54,7 @@ public:
      * @param mapDocument the map document owning the map of this layer
      */
     TileLayerItem(TileLayer *layer, MapDocument *mapDocument, QGraphicsItem *parent = nullptr);
+    ~TileLayerItem() override;
 
     TileLayer *tileLayer() const;
 
@@ -55,6 +68,22 @@ public:
      */
     void syncWithTileLayer();
 
+    /**
+     * Drops all cached chunks, for when anything affecting the look of the
+     * whole layer changed.
+     */
+    void invalidateCache();
+
+    /**
+     * Drops the cached chunks overlapping \a rect, which is in pixels.
+     */
+    void invalidateCache(const QRectF &rect);
+
+    /**
+     * Drops the cached chunks showing animated tiles from \a tileset.
+     */
+    void invalidateAnimatedTiles(const Tileset *tileset);
+
     // QGraphicsItem
     QRectF boundingRect() const override;
     void paint(QPainter *painter,
@@ -62,8 +91,38 @@ public:
                QWidget *widget = nullptr) override;
 
 private:
+    struct CachedChunk
+    {
+        QPixmap pixmap;
+        QRect deviceRect;
+        QVector<const Tileset*> animatedTilesets;
+    };
+
+    struct ChunkKey
+    {
+        const TileLayerItem *item;
+        QPoint chunk;
+
+        bool operator==(const ChunkKey &other) const
+        { return item == other.item && chunk == other.chunk; }
+
+        friend uint qHash(const ChunkKey &key, uint seed = 0) Q_DECL_NOTHROW
+        { return Tiled::qHash(key.chunk, seed) ^ ::qHash(key.item, seed); }
+    };
+
+    QRect chunksInRect(const QRectF &rect) const;
+    QRect chunkDeviceRect(QPoint chunk) const;
+    QSize tileReach() const;
+    bool chunkIsEmpty(QPoint chunk) const;
+    CachedChunk *renderChunk(QPoint chunk, QPainter::RenderHints hints);
+
     MapDocument *mMapDocument;
     QRectF mBoundingRect;
+    QMargins mDrawMargins;
+    QSize mTileSize;
+    qreal mCacheScale;
+
+    static QCache<ChunkKey, CachedChunk> sChunkCache;
 };
 
 inline TileLayer *TileLayerItem::tileLayer() const
@@ -24,7 +24,9 @@
 #include "mapdocument.h"
 #include "map.h"
 
-#include <QQueue>
+#include <QBitArray>
+
+#include <algorithm>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
@@ -65,6 +67,38 @@ private:
     const QRect mBounds;
 };
 
+/**
+ * A packed bitset with one bit for each cell in a rectangle.
+ */
+class FillMask
+{
+public:
+    explicit FillMask(const QRect &bounds)
+        : mBounds(bounds)
+        , mBits(bounds.width() * bounds.height())
+    {
+    }
+
+    bool isSet(int x, int y) const
+    {
+        return mBits.testBit(indexOf(x, y));
+    }
+
+    void setRow(int left, int right, int y)
+    {
+        mBits.fill(true, indexOf(left, y), indexOf(right, y) + 1);
+    }
+
+private:
+    int indexOf(int x, int y) const
+    {
+        return (y - mBounds.top()) * mBounds.width() + (x - mBounds.left());
+    }
+
+    const QRect mBounds;
+    QBitArray mBits;
+};
+
 } // anonymous namespace
 
 
@@ -214,48 +248,64 @@ static QRegion fillRegion(const TileLayer *layer,
     if (!region.contains(fillOrigin))
         return QRegion();
 
+    CellLookup cells(*layer);
+
     // Cache cell that we will match other cells against
-    const Cell matchCell = layer->cellAt(fillOrigin);
+    const Cell matchCell = cells.cellAt(fillOrigin);
 
     const QRect bounds = region.boundingRect();
-    const int width = bounds.width();
-    const int height = bounds.height();
-    const int indexOffset = -(bounds.left() + bounds.top() * width);
-
     const bool isStaggered = orientation == Map::Hexagonal || orientation == Map::Staggered;
 
-    // Create a queue to hold cells that need filling
-    QQueue<QPoint> fillPositions;
-    fillPositions.enqueue(fillOrigin);
+    // Keeps track of the cells that have been filled, so that each cell ends
+    // up in exactly one span
+    FillMask filled(bounds);
 
-    // Create an array that will store which cells have been processed
-    // This is faster than checking if a given cell is in the region/list
-    QVector<bool> processedCellsVec(width * height);
-    bool *processedCells = processedCellsVec.data();
-    QRegion fillRegion;
+    auto matches = [&](int x, int y) {
+        return !filled.isSet(x, y) && cells.cellAt(x, y) == matchCell;
+    };
 
-    // Loop through queued positions and fill them, while at the same time
-    // checking adjacent positions to see if they should be added
-    while (!fillPositions.isEmpty()) {
-        const QPoint currentPoint = fillPositions.dequeue();
-        const int startOfLine = currentPoint.y() * width;
+    // Stack of positions from which to fill the span they are part of
+    QVector<QPoint> seeds;
+    seeds.append(fillOrigin);
 
-        // Seek as far left as we can
-        int left = currentPoint.x();
-        while (left > bounds.left() && layer->cellAt(left - 1, currentPoint.y()) == matchCell) {
-            --left;
-            processedCells[indexOffset + startOfLine + left] = true;
+    // Filled row spans, turned into a region at the end
+    QVector<QRect> spans;
+
+    // Pushes a seed for each run of fillable cells between left and right
+    auto pushSeeds = [&](int left, int right, int y) {
+        bool inRun = false;
+
+        for (int x = left; x <= right; ++x) {
+            if (matches(x, y)) {
+                if (!inRun) {
+                    seeds.append(QPoint(x, y));
+                    inRun = true;
+                }
+            } else {
+                inRun = false;
+            }
         }
+    };
+
+    while (!seeds.isEmpty()) {
+        const QPoint seed = seeds.takeLast();
+        const int y = seed.y();
 
-        // Seek as far right as we can
-        int right = currentPoint.x();
-        while (right < bounds.right() && layer->cellAt(right + 1, currentPoint.y()) == matchCell) {
+        // The same span may have been seeded more than once
+        if (filled.isSet(seed.x(), y))
+            continue;
+
+        // Seek as far left and right as we can
+        int left = seed.x();
+        while (left > bounds.left() && matches(left - 1, y))
+            --left;
+
+        int right = seed.x();
+        while (right < bounds.right() && matches(right + 1, y))
             ++right;
-            processedCells[indexOffset + startOfLine + right] = true;
-        }
 
-        // Add cells between left and right to the region
-        fillRegion += QRegion(left, currentPoint.y(), right - left + 1, 1);
+        filled.setRow(left, right, y);
+        spans.append(QRect(left, y, right - left + 1, 1));
 
         bool leftColumnIsStaggered = false;
         bool rightColumnIsStaggered = false;
@@ -263,7 +313,7 @@ static QRegion fillRegion(const TileLayer *layer,
         // For hexagonal maps with a staggered Y-axis, we may need to extend the search range
         if (isStaggered) {
             if (staggerAxis == Map::StaggerY) {
-                bool rowIsStaggered = ((layer->y() + currentPoint.y()) & 1) ^ staggerIndex;
+                bool rowIsStaggered = ((layer->y() + y) & 1) ^ staggerIndex;
                 if (rowIsStaggered)
                     right = qMin(right + 1, bounds.right());
                 else
@@ -274,29 +324,7 @@ static QRegion fillRegion(const TileLayer *layer,
             }
         }
 
-        // Loop between left and right and check if cells above or below need
-        // to be added to the queue.
-        auto findFillPositions = [=,&fillPositions](int left, int right, int y) {
-            bool adjacentCellAdded = false;
-
-            for (int x = left; x <= right; ++x) {
-                const int index = y * width + x;
-
-                if (!processedCells[indexOffset + index] && layer->cellAt(x, y) == matchCell) {
-                    // Do not add the cell to the queue if an adjacent cell was added.
-                    if (!adjacentCellAdded) {
-                        fillPositions.enqueue(QPoint(x, y));
-                        adjacentCellAdded = true;
-                    }
-                } else {
-                    adjacentCellAdded = false;
-                }
-
-                processedCells[indexOffset + index] = true;
-            }
-        };
-
-        if (currentPoint.y() > bounds.top()) {
+        if (y > bounds.top()) {
             int _left = left;
             int _right = right;
 
@@ -307,10 +335,10 @@ static QRegion fillRegion(const TileLayer *layer,
                     _right = qMin(right + 1, bounds.right());
             }
 
-            findFillPositions(_left, _right, currentPoint.y() - 1);
+            pushSeeds(_left, _right, y - 1);
         }
 
-        if (currentPoint.y() < bounds.bottom()) {
+        if (y < bounds.bottom()) {
             int _left = left;
             int _right = right;
 
@@ -321,10 +349,18 @@ static QRegion fillRegion(const TileLayer *layer,
                     _right = qMin(right + 1, bounds.right());
             }
 
-            findFillPositions(_left, _right, currentPoint.y() + 1);
+            pushSeeds(_left, _right, y + 1);
         }
     }
 
+    // The spans don't overlap and never touch horizontally, so once sorted
+    // they can be handed to QRegion directly rather than united one by one.
+    std::sort(spans.begin(), spans.end(), [] (const QRect &a, const QRect &b) {
+        return a.y() < b.y() || (a.y() == b.y() && a.x() < b.x());
+    });
+
+    QRegion fillRegion;
+    fillRegion.setRects(spans.constData(), spans.size());
     return fillRegion;
 }
 
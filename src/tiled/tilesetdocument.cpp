@@ -83,6 +83,9 @@ TilesetDocument::TilesetDocument(const SharedTileset &tileset, const QString &fi
     connect(this, &TilesetDocument::propertiesChanged,
             this, &TilesetDocument::onPropertiesChanged);
 
+    connect(this, &TilesetDocument::tileAnimationChanged,
+            this, &TilesetDocument::onTileAnimationChanged);
+
     connect(mTerrainModel, &TilesetTerrainModel::terrainRemoved,
             this, &TilesetDocument::onTerrainRemoved);
 
@@ -368,6 +371,12 @@ void TilesetDocument::onPropertiesChanged(Object *object)
         emit mapDocument->propertiesChanged(object);
 }
 
+void TilesetDocument::onTileAnimationChanged(Tile *tile)
+{
+    for (MapDocument *mapDocument : mapDocuments())
+        emit mapDocument->tileAnimationChanged(tile);
+}
+
 void TilesetDocument::onTerrainRemoved(Terrain *terrain)
 {
     if (terrain == mCurrentObject)
@@ -157,6 +157,8 @@ private slots:
     void onPropertyChanged(Object *object, const QString &name);
     void onPropertiesChanged(Object *object);
 
+    void onTileAnimationChanged(Tile *tile);
+
     void onTerrainRemoved(Terrain *terrain);
     void onWangSetRemoved(WangSet *wangSet);
 
@@ -81,10 +81,10 @@ private:
      * \a fillRegion. \a point, \a front, and \a fillRegion are relative to
      * \a back.
      */
-    const Cell &getCell(const TileLayer &back,
-                        const TileLayer &front,
-                        const QRegion &fillRegion,
-                        QPoint point) const;
+    Cell getCell(const TileLayer &back,
+                 const TileLayer &front,
+                 const QRegion &fillRegion,
+                 QPoint point) const;
 
     /**
      * Returns a wangId based on \a front and \a back. Adjacent cells are
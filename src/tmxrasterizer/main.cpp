@@ -31,6 +31,7 @@
 #include <QCommandLineParser>
 #include <QDebug>
 #include <QGuiApplication>
+#include <QSize>
 #include <QStringList>
 #include <QUrl>
 
@@ -40,6 +41,24 @@ static QString localFile(const QString &fileNameOrUrl)
     return url.isLocalFile() ? url.toLocalFile() : fileNameOrUrl;
 }
 
+/**
+ * Parses either "SIZE" or "WIDTHxHEIGHT".
+ */
+static QSize parseSize(const QString &text)
+{
+    const QStringList parts = text.split(QLatin1Char('x'));
+    if (parts.size() > 2)
+        return QSize();
+
+    bool widthOk, heightOk;
+    const int width = parts.first().toInt(&widthOk);
+    const int height = parts.last().toInt(&heightOk);
+    if (!widthOk || !heightOk)
+        return QSize();
+
+    return QSize(width, height);
+}
+
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
@@ -71,6 +90,14 @@ int main(int argc, char *argv[])
                           { "hide-layer",
                             QCoreApplication::translate("main", "Specifies a layer to omit from the output image. Can be repeated to hide multiple layers."),
                             QCoreApplication::translate("main", "name") },
+                          { "tiles",
+                            QCoreApplication::translate("main", "Splits the output into images of SIZE x SIZE or WIDTHxHEIGHT pixels, which are written to the output directory as x_y.png."),
+                            QCoreApplication::translate("main", "size") },
+                          { "pyramid",
+                            QCoreApplication::translate("main", "Together with --tiles, writes each zoom level down to a single image into a numbered subdirectory, the highest being the full size.") },
+                          { "threads",
+                            QCoreApplication::translate("main", "The number of threads to render with (default: one per processor core)."),
+                            QCoreApplication::translate("main", "count") },
                       });
     parser.addPositionalArgument("map", QCoreApplication::translate("main", "Map file to render."));
     parser.addPositionalArgument("image", QCoreApplication::translate("main", "Image file to output."));
@@ -119,5 +146,28 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (parser.isSet(QLatin1String("tiles"))) {
+        w.setOutputTileSize(parseSize(parser.value(QLatin1String("tiles"))));
+        if (w.outputTileSize().isEmpty()) {
+            qWarning().noquote() << QCoreApplication::translate("main", "Invalid tile size specified: \"%1\"").arg(parser.value(QLatin1String("tiles")));
+            exit(1);
+        }
+    }
+
+    w.setWritePyramid(parser.isSet(QLatin1String("pyramid")));
+    if (w.writePyramid() && w.outputTileSize().isEmpty()) {
+        qWarning().noquote() << QCoreApplication::translate("main", "The --pyramid option requires --tiles");
+        exit(1);
+    }
+
+    if (parser.isSet(QLatin1String("threads"))) {
+        bool ok;
+        w.setThreadCount(parser.value(QLatin1String("threads")).toInt(&ok));
+        if (!ok || w.threadCount() <= 0) {
+            qWarning().noquote() << QCoreApplication::translate("main", "Invalid thread count specified: \"%1\"").arg(parser.value(QLatin1String("threads")));
+            exit(1);
+        }
+    }
+
     return w.render(fileToOpen, fileToSave);
 }
@@ -38,20 +38,55 @@
 #include "staggeredrenderer.h"
 #include "tilelayer.h"
 
+#include <QAtomicInt>
 #include <QDebug>
+#include <QDir>
 #include <QImageWriter>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+#include <QtMath>
+
+#include <private/qguiapplication_p.h>
+#include <qpa/qplatformintegration.h>
 
 #include <memory>
 
 using namespace Tiled;
 
+/**
+ * Tileset images are pixmaps, which may only be drawn from other threads
+ * when the platform supports it.
+ */
+static bool canDrawPixmapsInThreads()
+{
+    const QPlatformIntegration *integration = QGuiApplicationPrivate::platformIntegration();
+    return integration && integration->hasCapability(QPlatformIntegration::ThreadedPixmaps);
+}
+
+/**
+ * Calls \a function for each item in \a sequence, in parallel when the map
+ * can be drawn from other threads.
+ */
+template<typename Sequence, typename Function>
+static void drawEach(Sequence &sequence, Function function)
+{
+    if (canDrawPixmapsInThreads()) {
+        QtConcurrent::blockingMap(sequence, function);
+    } else {
+        for (auto &item : sequence)
+            function(item);
+    }
+}
+
 TmxRasterizer::TmxRasterizer():
     mScale(1.0),
     mTileSize(0),
     mSize(0),
     mUseAntiAliasing(false),
     mSmoothImages(true),
-    mIgnoreVisibility(false)
+    mIgnoreVisibility(false),
+    mWritePyramid(false),
+    mThreadCount(0)
 {
 }
 
@@ -122,19 +157,47 @@ int TmxRasterizer::render(const QString &mapFileName,
     mapSize.rwidth() *= xScale;
     mapSize.rheight() *= yScale;
 
-    QImage image(mapSize, QImage::Format_ARGB32);
-    image.fill(Qt::transparent);
+    QTransform transform = QTransform::fromScale(xScale, yScale);
+    transform.translate(margins.left(), margins.top());
+    transform.translate(-mapOffset.x(), -mapOffset.y());
+
+    if (mThreadCount > 0)
+        QThreadPool::globalInstance()->setMaxThreadCount(mThreadCount);
+
+    // Computing the draw margins updates caches in the map and its layers,
+    // so make sure they are up to date before drawing from several threads
+    map->drawMargins();
+    LayerIterator iterator(map.get());
+    while (const Layer *layer = iterator.next()) {
+        if (layer->isTileLayer())
+            static_cast<const TileLayer*>(layer)->usedTilesets();
+    }
+
+    if (mOutputTileSize.isEmpty())
+        return writeImage(map.get(), renderer.get(), mapSize, transform, imageFileName);
+    else
+        return writeTiles(map.get(), renderer.get(), mapSize, transform, imageFileName);
+}
+
+/**
+ * Draws the map to \a image, where \a transform maps from map pixels to
+ * image pixels. Only the part of the map that falls within the image is
+ * drawn, so this can be called for each part of a larger image in parallel.
+ * The map and its tileset images are only read while drawing.
+ */
+void TmxRasterizer::drawMap(const Map *map, MapRenderer *renderer,
+                            QImage &image, const QTransform &transform) const
+{
     QPainter painter(&image);
 
     painter.setRenderHint(QPainter::Antialiasing, mUseAntiAliasing);
     painter.setRenderHint(QPainter::SmoothPixmapTransform, mSmoothImages);
-    painter.setTransform(QTransform::fromScale(xScale, yScale));
+    painter.setTransform(transform);
 
-    painter.translate(margins.left(), margins.top());
-    painter.translate(-mapOffset);
+    const QRectF exposed = transform.inverted().mapRect(QRectF(image.rect()));
 
     // Perform a similar rendering than found in exportasimagedialog.cpp
-    LayerIterator iterator(map.get());
+    LayerIterator iterator(map);
     while (const Layer *layer = iterator.next()) {
         if (!shouldDrawLayer(layer))
             continue;
@@ -148,15 +211,44 @@ int TmxRasterizer::render(const QString &mapFileName,
         const ImageLayer *imageLayer = dynamic_cast<const ImageLayer*>(layer);
 
         if (tileLayer) {
-            renderer->drawTileLayer(&painter, tileLayer);
+            renderer->drawTileLayer(&painter, tileLayer, exposed.translated(-offset));
         } else if (imageLayer) {
             renderer->drawImageLayer(&painter, imageLayer);
         }
 
         painter.translate(-offset);
     }
+}
+
+/**
+ * Renders the map into a single image. The image is split into strips of
+ * rows which are drawn in parallel.
+ */
+int TmxRasterizer::writeImage(const Map *map, MapRenderer *renderer,
+                              QSize imageSize, const QTransform &transform,
+                              const QString &imageFileName) const
+{
+    QImage image(imageSize, QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+
+    const int stripHeight = 256;
+    QVector<int> strips;
+    for (int y = 0; y < imageSize.height(); y += stripHeight)
+        strips.append(y);
 
-    map.reset();
+    uchar *bits = image.bits();
+    const int bytesPerLine = image.bytesPerLine();
+
+    drawEach(strips, [&] (int y) {
+        // Refers to the rows of the strip, without copying them
+        QImage strip(bits + y * bytesPerLine,
+                     imageSize.width(),
+                     qMin(stripHeight, imageSize.height() - y),
+                     bytesPerLine,
+                     QImage::Format_ARGB32);
+
+        drawMap(map, renderer, strip, transform * QTransform::fromTranslate(0, -y));
+    });
 
     // Save image
     QImageWriter imageWriter(imageFileName);
@@ -173,3 +265,89 @@ int TmxRasterizer::render(const QString &mapFileName,
 
     return 0;
 }
+
+namespace {
+
+struct OutputTile
+{
+    QRect rect;             // in pixels of its level
+    QTransform transform;   // from map pixels to pixels of the tile
+    QString fileName;
+};
+
+} // anonymous namespace
+
+/**
+ * Renders the map into separate images of the output tile size, which are
+ * written to \a directory as "x_y.png". Each image is drawn and written on
+ * its own, so memory use depends on the tile size rather than the map size.
+ *
+ * When writing a pyramid, the images of each zoom level are written to a
+ * numbered subdirectory. The highest level is the full size map and each
+ * level below is half the size, down to a level that fits in a single tile.
+ */
+int TmxRasterizer::writeTiles(const Map *map, MapRenderer *renderer,
+                              QSize imageSize, const QTransform &transform,
+                              const QString &directory) const
+{
+    const int tileWidth = mOutputTileSize.width();
+    const int tileHeight = mOutputTileSize.height();
+
+    int topLevel = 0;
+    if (mWritePyramid) {
+        while ((imageSize.width() >> topLevel) > tileWidth ||
+               (imageSize.height() >> topLevel) > tileHeight)
+            ++topLevel;
+    }
+
+    QVector<OutputTile> tiles;
+
+    for (int level = topLevel; level >= 0; --level) {
+        const int shift = topLevel - level;
+        const qreal levelScale = 1.0 / (1 << shift);
+        const QSize levelSize(qMax(1, qCeil(imageSize.width() * levelScale)),
+                              qMax(1, qCeil(imageSize.height() * levelScale)));
+
+        QDir levelDir(directory);
+        if (mWritePyramid)
+            levelDir.setPath(levelDir.filePath(QString::number(level)));
+
+        if (!levelDir.mkpath(QLatin1String("."))) {
+            qWarning("Error while creating directory \"%s\"",
+                     qUtf8Printable(levelDir.path()));
+            return 1;
+        }
+
+        const QTransform levelTransform = transform * QTransform::fromScale(levelScale, levelScale);
+
+        for (int y = 0; y * tileHeight < levelSize.height(); ++y) {
+            for (int x = 0; x * tileWidth < levelSize.width(); ++x) {
+                OutputTile tile;
+                tile.rect = QRect(x * tileWidth, y * tileHeight, tileWidth, tileHeight)
+                        .intersected(QRect(QPoint(), levelSize));
+                tile.transform = levelTransform * QTransform::fromTranslate(-tile.rect.x(), -tile.rect.y());
+                tile.fileName = levelDir.filePath(QStringLiteral("%1_%2.png").arg(x).arg(y));
+                tiles.append(tile);
+            }
+        }
+    }
+
+    QAtomicInt failures;
+
+    drawEach(tiles, [&] (const OutputTile &tile) {
+        QImage image(tile.rect.size(), QImage::Format_ARGB32);
+        image.fill(Qt::transparent);
+
+        drawMap(map, renderer, image, tile.transform);
+
+        QImageWriter imageWriter(tile.fileName, "png");
+        if (!imageWriter.write(image)) {
+            qWarning("Error while writing \"%s\": %s",
+                     qUtf8Printable(tile.fileName),
+                     qUtf8Printable(imageWriter.errorString()));
+            failures.ref();
+        }
+    });
+
+    return failures.load() == 0 ? 0 : 1;
+}
@@ -30,8 +30,16 @@
 
 #include "layer.h"
 
+#include <QSize>
 #include <QString>
 #include <QStringList>
+#include <QTransform>
+
+class QImage;
+
+namespace Tiled {
+class MapRenderer;
+}
 
 using namespace Tiled;
 
@@ -47,6 +55,9 @@ public:
     bool useAntiAliasing() const { return mUseAntiAliasing; }
     bool smoothImages() const { return mSmoothImages; }
     bool IgnoreVisibility() const { return mIgnoreVisibility; }
+    QSize outputTileSize() const { return mOutputTileSize; }
+    bool writePyramid() const { return mWritePyramid; }
+    int threadCount() const { return mThreadCount; }
 
     void setScale(qreal scale) { mScale = scale; }
     void setTileSize(int tileSize) { mTileSize = tileSize; }
@@ -54,6 +65,9 @@ public:
     void setAntiAliasing(bool useAntiAliasing) { mUseAntiAliasing = useAntiAliasing; }
     void setSmoothImages(bool smoothImages) { mSmoothImages = smoothImages; }
     void setIgnoreVisibility(bool IgnoreVisibility) { mIgnoreVisibility = IgnoreVisibility; }
+    void setOutputTileSize(QSize size) { mOutputTileSize = size; }
+    void setWritePyramid(bool writePyramid) { mWritePyramid = writePyramid; }
+    void setThreadCount(int threadCount) { mThreadCount = threadCount; }
 
     void setLayersToHide(QStringList layersToHide) { mLayersToHide = layersToHide; }
 
@@ -66,7 +80,20 @@ private:
     bool mUseAntiAliasing;
     bool mSmoothImages;
     bool mIgnoreVisibility;
+    QSize mOutputTileSize;
+    bool mWritePyramid;
+    int mThreadCount;
     QStringList mLayersToHide;
 
     bool shouldDrawLayer(const Layer *layer) const;
+
+    void drawMap(const Map *map, MapRenderer *renderer,
+                 QImage &image, const QTransform &transform) const;
+
+    int writeImage(const Map *map, MapRenderer *renderer,
+                   QSize imageSize, const QTransform &transform,
+                   const QString &imageFileName) const;
+    int writeTiles(const Map *map, MapRenderer *renderer,
+                   QSize imageSize, const QTransform &transform,
+                   const QString &directory) const;
 };
@@ -6,6 +6,7 @@ TARGET = tmxrasterizer
 target.path = $${PREFIX}/bin
 INSTALLS += target
 CONFIG += console
+QT += concurrent gui-private
 
 win32 {
     DESTDIR = ../..
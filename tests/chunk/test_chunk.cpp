@@ -0,0 +1,279 @@
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+
+#include <memory>
+
+using namespace Tiled;
+
+class test_Chunk : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void roundTripsFlags();
+    void highTileIds();
+    void manyTilesets();
+    void removeReferences();
+    void replaceReferences();
+    void compactsPalette();
+    void packedMatchesFallback();
+
+private:
+    QVector<SharedTileset> mTilesets;
+};
+
+// Tile IDs from this one on don't fit in a packed cell
+static const int FirstUnpackedTileId = 1 << 22;
+
+// The palette of a packed chunk holds this many tilesets
+static const int PaletteSize = 31;
+
+static Cell makeCell(const SharedTileset &tileset, int tileId, int flags = 0)
+{
+    Cell cell;
+    cell.setTile(tileset.data(), tileId);
+    cell.setFlippedHorizontally(flags & 0x01);
+    cell.setFlippedVertically(flags & 0x02);
+    cell.setFlippedAntiDiagonally(flags & 0x04);
+    cell.setRotatedHexagonal120(flags & 0x08);
+    cell.setChecked(flags & 0x10);
+    return cell;
+}
+
+/**
+ * Compares two cells including their checked flag, which is ignored by
+ * Cell::operator==.
+ */
+static bool sameCell(const Cell &a, const Cell &b)
+{
+    return a == b && a.checked() == b.checked();
+}
+
+/**
+ * Returns a cell that varies with its position, using the first few
+ * tilesets and all flags.
+ */
+static Cell patternCell(const QVector<SharedTileset> &tilesets, int x, int y)
+{
+    const int n = qAbs(x * 7 + y * 13);
+    if (n % 5 == 0)
+        return Cell();
+    return makeCell(tilesets.at(n % 3), n % 64, n % 32);
+}
+
+void test_Chunk::initTestCase()
+{
+    for (int i = 0; i < PaletteSize + 2; ++i)
+        mTilesets.append(Tileset::create(QString::number(i), 16, 16));
+}
+
+void test_Chunk::roundTripsFlags()
+{
+    Chunk chunk;
+
+    for (int flags = 0; flags < 32; ++flags)
+        chunk.setCell(flags % CHUNK_SIZE, flags / CHUNK_SIZE, makeCell(mTilesets.at(0), flags, flags));
+
+    QVERIFY(chunk.isPacked());
+
+    for (int flags = 0; flags < 32; ++flags) {
+        const Cell cell = chunk.cellAt(flags % CHUNK_SIZE, flags / CHUNK_SIZE);
+        QVERIFY(sameCell(cell, makeCell(mTilesets.at(0), flags, flags)));
+        QCOMPARE(cell.flippedHorizontally(), bool(flags & 0x01));
+        QCOMPARE(cell.flippedVertically(), bool(flags & 0x02));
+        QCOMPARE(cell.flippedAntiDiagonally(), bool(flags & 0x04));
+        QCOMPARE(cell.rotatedHexagonal120(), bool(flags & 0x08));
+        QCOMPARE(cell.checked(), bool(flags & 0x10));
+    }
+
+    // Empty cells keep their flags as well
+    Cell empty;
+    empty.setChecked(true);
+    chunk.setCell(0, 0, empty);
+    QVERIFY(chunk.isPacked());
+    QVERIFY(chunk.cellAt(0, 0).isEmpty());
+    QVERIFY(chunk.cellAt(0, 0).checked());
+}
+
+void test_Chunk::highTileIds()
+{
+    Chunk chunk;
+
+    const Cell highest = makeCell(mTilesets.at(0), FirstUnpackedTileId - 1, 0x1f);
+    chunk.setCell(0, 0, highest);
+    QVERIFY(chunk.isPacked());
+    QVERIFY(sameCell(chunk.cellAt(0, 0), highest));
+
+    const Cell tooHigh = makeCell(mTilesets.at(1), FirstUnpackedTileId, 0x15);
+    chunk.setCell(1, 0, tooHigh);
+    QVERIFY(!chunk.isPacked());
+    QVERIFY(sameCell(chunk.cellAt(0, 0), highest));
+    QVERIFY(sameCell(chunk.cellAt(1, 0), tooHigh));
+    QVERIFY(chunk.cellAt(2, 0).isEmpty());
+}
+
+void test_Chunk::manyTilesets()
+{
+    Chunk chunk;
+
+    for (int i = 0; i < PaletteSize; ++i)
+        chunk.setCell(i % CHUNK_SIZE, i / CHUNK_SIZE, makeCell(mTilesets.at(i), i, i % 32));
+
+    QVERIFY(chunk.isPacked());
+
+    chunk.setCell(PaletteSize % CHUNK_SIZE, PaletteSize / CHUNK_SIZE,
+                  makeCell(mTilesets.at(PaletteSize), 1, 0x10));
+    QVERIFY(!chunk.isPacked());
+
+    for (int i = 0; i < PaletteSize; ++i)
+        QVERIFY(sameCell(chunk.cellAt(i % CHUNK_SIZE, i / CHUNK_SIZE),
+                         makeCell(mTilesets.at(i), i, i % 32)));
+    QVERIFY(sameCell(chunk.cellAt(PaletteSize % CHUNK_SIZE, PaletteSize / CHUNK_SIZE),
+                     makeCell(mTilesets.at(PaletteSize), 1, 0x10)));
+}
+
+void test_Chunk::removeReferences()
+{
+    Chunk chunk;
+    chunk.setCell(0, 0, makeCell(mTilesets.at(0), 1, 0x03));
+    chunk.setCell(1, 0, makeCell(mTilesets.at(1), 2, 0x1c));
+    chunk.setCell(2, 0, makeCell(mTilesets.at(0), 3));
+
+    chunk.removeReferencesToTileset(mTilesets.at(0).data());
+
+    QVERIFY(chunk.isPacked());
+    QVERIFY(chunk.cellAt(0, 0).isEmpty());
+    QVERIFY(chunk.cellAt(2, 0).isEmpty());
+    QVERIFY(sameCell(chunk.cellAt(1, 0), makeCell(mTilesets.at(1), 2, 0x1c)));
+    QVERIFY(!chunk.hasCell([&] (const Cell &cell) { return cell.tileset() == mTilesets.at(0).data(); }));
+
+    // Removing a tileset that isn't used changes nothing
+    chunk.removeReferencesToTileset(mTilesets.at(2).data());
+    QVERIFY(sameCell(chunk.cellAt(1, 0), makeCell(mTilesets.at(1), 2, 0x1c)));
+
+    chunk.removeReferencesToTileset(mTilesets.at(1).data());
+    QVERIFY(chunk.isEmpty());
+}
+
+void test_Chunk::replaceReferences()
+{
+    Chunk chunk;
+    chunk.setCell(0, 0, makeCell(mTilesets.at(0), 1, 0x05));
+    chunk.setCell(1, 0, makeCell(mTilesets.at(1), 2, 0x12));
+
+    // A tileset not in the palette yet takes over the palette entry
+    chunk.replaceReferencesToTileset(mTilesets.at(0).data(), mTilesets.at(2).data());
+    QVERIFY(chunk.isPacked());
+    QVERIFY(sameCell(chunk.cellAt(0, 0), makeCell(mTilesets.at(2), 1, 0x05)));
+    QVERIFY(sameCell(chunk.cellAt(1, 0), makeCell(mTilesets.at(1), 2, 0x12)));
+
+    // With both tilesets in the palette, the cells point at the existing entry
+    chunk.replaceReferencesToTileset(mTilesets.at(2).data(), mTilesets.at(1).data());
+    QVERIFY(chunk.isPacked());
+    QVERIFY(sameCell(chunk.cellAt(0, 0), makeCell(mTilesets.at(1), 1, 0x05)));
+    QVERIFY(sameCell(chunk.cellAt(1, 0), makeCell(mTilesets.at(1), 2, 0x12)));
+
+    // More tilesets can still be added
+    chunk.setCell(2, 0, makeCell(mTilesets.at(3), 3));
+    QVERIFY(sameCell(chunk.cellAt(2, 0), makeCell(mTilesets.at(3), 3)));
+    QVERIFY(sameCell(chunk.cellAt(0, 0), makeCell(mTilesets.at(1), 1, 0x05)));
+}
+
+void test_Chunk::compactsPalette()
+{
+    Chunk chunk;
+
+    for (int i = 0; i < PaletteSize; ++i)
+        chunk.setCell(i % CHUNK_SIZE, i / CHUNK_SIZE, makeCell(mTilesets.at(i), i, i % 32));
+
+    // Free one entry by removing its tileset, and one by overwriting its cell
+    chunk.removeReferencesToTileset(mTilesets.at(3).data());
+    chunk.setCell(7, 0, Cell());
+
+    chunk.setCell(3, 0, makeCell(mTilesets.at(PaletteSize), 100, 0x1f));
+    chunk.setCell(7, 0, makeCell(mTilesets.at(PaletteSize + 1), 200, 0x0a));
+    QVERIFY(chunk.isPacked());
+
+    for (int i = 0; i < PaletteSize; ++i) {
+        const Cell cell = chunk.cellAt(i % CHUNK_SIZE, i / CHUNK_SIZE);
+        if (i == 3)
+            QVERIFY(sameCell(cell, makeCell(mTilesets.at(PaletteSize), 100, 0x1f)));
+        else if (i == 7)
+            QVERIFY(sameCell(cell, makeCell(mTilesets.at(PaletteSize + 1), 200, 0x0a)));
+        else
+            QVERIFY(sameCell(cell, makeCell(mTilesets.at(i), i, i % 32)));
+    }
+}
+
+/**
+ * Fills \a layer with the test pattern. When \a fallback is set, each chunk
+ * is made to store full cells by briefly setting a cell it can't pack.
+ */
+static void fillLayer(TileLayer &layer, const QVector<SharedTileset> &tilesets, bool fallback)
+{
+    for (int y = 0; y < layer.height(); ++y)
+        for (int x = 0; x < layer.width(); ++x)
+            layer.setCell(x, y, patternCell(tilesets, x, y));
+
+    if (!fallback)
+        return;
+
+    for (int y = 0; y < layer.height(); y += CHUNK_SIZE) {
+        for (int x = 0; x < layer.width(); x += CHUNK_SIZE) {
+            layer.setCell(x, y, makeCell(tilesets.at(0), FirstUnpackedTileId));
+            layer.setCell(x, y, patternCell(tilesets, x, y));
+        }
+    }
+}
+
+static void compareLayers(const TileLayer &a, const TileLayer &b)
+{
+    QCOMPARE(a.bounds(), b.bounds());
+
+    for (int y = a.y(); y < a.y() + a.height(); ++y)
+        for (int x = a.x(); x < a.x() + a.width(); ++x)
+            QVERIFY2(sameCell(a.cellAt(x - a.x(), y - a.y()), b.cellAt(x - b.x(), y - b.y())),
+                     qPrintable(QStringLiteral("%1,%2").arg(x).arg(y)));
+}
+
+void test_Chunk::packedMatchesFallback()
+{
+    const int size = CHUNK_SIZE * 3;
+
+    TileLayer packed(QString(), 0, 0, size, size);
+    TileLayer fallback(QString(), 0, 0, size, size);
+    fillLayer(packed, mTilesets, false);
+    fillLayer(fallback, mTilesets, true);
+
+    QVERIFY(packed.findChunk(0, 0)->isPacked());
+    QVERIFY(!fallback.findChunk(0, 0)->isPacked());
+    compareLayers(packed, fallback);
+
+    // region
+    QCOMPARE(packed.region(), fallback.region());
+    const auto usesSecondTileset = [&] (const Cell &cell) { return cell.tileset() == mTilesets.at(1).data(); };
+    QCOMPARE(packed.region(usesSecondTileset), fallback.region(usesSecondTileset));
+
+    // copy, crossing chunk boundaries
+    const QRegion area = QRegion(5, 3, 30, 20) + QRegion(20, 30, 10, 10);
+    std::unique_ptr<TileLayer> packedCopy(packed.copy(area));
+    std::unique_ptr<TileLayer> fallbackCopy(fallback.copy(area));
+    compareLayers(*packedCopy, *fallbackCopy);
+
+    // merge, into both packed and fallback layers
+    TileLayer packedTarget(QString(), 0, 0, size, size);
+    TileLayer fallbackTarget(QString(), 0, 0, size, size);
+    fillLayer(fallbackTarget, mTilesets, true);
+    fillLayer(packedTarget, mTilesets, false);
+
+    packedTarget.merge(QPoint(7, 9), packedCopy.get());
+    fallbackTarget.merge(QPoint(7, 9), fallbackCopy.get());
+    compareLayers(packedTarget, fallbackTarget);
+}
+
+QTEST_MAIN(test_Chunk)
+#include "test_chunk.moc"
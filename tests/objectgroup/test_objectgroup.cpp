@@ -0,0 +1,145 @@
+#include "mapobject.h"
+#include "objectgroup.h"
+
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+class test_ObjectGroup : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void objectsAt();
+    void rotatedObject();
+    void followsGeometryChanges();
+    void keepsStackingOrder();
+    void matchesLinearSearch();
+};
+
+static MapObject *createObject(qreal x, qreal y, qreal width, qreal height)
+{
+    return new MapObject(QString(), QString(), QPointF(x, y), QSizeF(width, height));
+}
+
+/**
+ * Returns the objects touching \a rect by checking all of them, to compare
+ * with the results of the spatial index.
+ */
+static QList<MapObject*> touchingObjects(const ObjectGroup &group, const QRectF &rect)
+{
+    QList<MapObject*> objects;
+    for (MapObject *object : group.objects()) {
+        const QRectF bounds = object->bounds();
+        if (bounds.left() <= rect.right() && rect.left() <= bounds.right() &&
+                bounds.top() <= rect.bottom() && rect.top() <= bounds.bottom())
+            objects.append(object);
+    }
+    return objects;
+}
+
+void test_ObjectGroup::objectsAt()
+{
+    ObjectGroup group;
+    MapObject *small = createObject(10, 10, 20, 20);
+    MapObject *large = createObject(0, 0, 1000, 1000);
+    MapObject *point = createObject(600, 600, 0, 0);
+    group.addObject(small);
+    group.addObject(large);
+    group.addObject(point);
+
+    QCOMPARE(group.objectsAt(QPointF(15, 15)), QList<MapObject*>() << small << large);
+    QCOMPARE(group.objectsAt(QPointF(500, 500)), QList<MapObject*>() << large);
+    QCOMPARE(group.objectsAt(QPointF(600, 600)), QList<MapObject*>() << large << point);
+    QVERIFY(group.objectsAt(QPointF(2000, 15)).isEmpty());
+}
+
+void test_ObjectGroup::rotatedObject()
+{
+    ObjectGroup group;
+    MapObject *object = createObject(100, 100, 200, 10);
+    object->setRotation(90);
+    group.addObject(object);
+
+    // Rotated clockwise around its position, the object extends downwards
+    QCOMPARE(group.objectsAt(QPointF(95, 250)), QList<MapObject*>() << object);
+}
+
+void test_ObjectGroup::followsGeometryChanges()
+{
+    ObjectGroup group;
+    MapObject *object = createObject(10, 10, 20, 20);
+    group.addObject(object);
+
+    QCOMPARE(group.objectsAt(QPointF(15, 15)).size(), 1);
+
+    object->setPosition(QPointF(1000, 1000));
+    QVERIFY(group.objectsAt(QPointF(15, 15)).isEmpty());
+    QCOMPARE(group.objectsAt(QPointF(1015, 1015)).size(), 1);
+
+    object->setSize(QSizeF(400, 400));
+    QCOMPARE(group.objectsAt(QPointF(1350, 1350)).size(), 1);
+
+    group.removeObject(object);
+    QVERIFY(group.objectsAt(QPointF(1015, 1015)).isEmpty());
+    delete object;
+}
+
+void test_ObjectGroup::keepsStackingOrder()
+{
+    ObjectGroup group;
+    MapObject *a = createObject(0, 0, 10, 10);
+    MapObject *b = createObject(0, 0, 10, 10);
+    MapObject *c = createObject(0, 0, 10, 10);
+    group.addObject(a);
+    group.addObject(b);
+
+    QCOMPARE(group.objectsAt(QPointF(5, 5)), QList<MapObject*>() << a << b);
+
+    group.insertObject(0, c);
+    QCOMPARE(group.objectsAt(QPointF(5, 5)), QList<MapObject*>() << c << a << b);
+
+    group.moveObjects(0, 3, 1);
+    QCOMPARE(group.objectsAt(QPointF(5, 5)), QList<MapObject*>() << a << b << c);
+}
+
+void test_ObjectGroup::matchesLinearSearch()
+{
+    ObjectGroup group;
+    qsrand(42);
+
+    for (int i = 0; i < 2000; ++i) {
+        group.addObject(createObject(qrand() % 4000, qrand() % 4000,
+                                     qrand() % 100, qrand() % 100));
+    }
+
+    // Build the index before moving some of the objects around
+    QCOMPARE(group.objectsAt(QPointF(-1, -1)), QList<MapObject*>());
+
+    for (int i = 0; i < 200; ++i) {
+        MapObject *object = group.objectAt(qrand() % group.objectCount());
+        object->setPosition(QPointF(qrand() % 4000, qrand() % 4000));
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        const QRectF rect(qrand() % 4000, qrand() % 4000,
+                          qrand() % 600, qrand() % 600);
+        QCOMPARE(group.objectsIntersecting(rect), touchingObjects(group, rect));
+    }
+
+    const QRect first(100, 100, 300, 50);
+    const QRect second(2000, 3000, 50, 500);
+    const QSet<MapObject*> touchingRegion =
+            touchingObjects(group, first).toSet() +
+            touchingObjects(group, second).toSet();
+
+    QList<MapObject*> expected;
+    for (MapObject *object : group.objects())
+        if (touchingRegion.contains(object))
+            expected.append(object);
+
+    QCOMPARE(group.objectsIntersecting(QRegion(first) + QRegion(second)), expected);
+}
+
+QTEST_MAIN(test_ObjectGroup)
+#include "test_objectgroup.moc"
@@ -1,4 +1,7 @@
 TEMPLATE=subdirs
 SUBDIRS = \
+    chunk \
     mapreader \
-    staggeredrenderer
+    objectgroup \
+    staggeredrenderer \
+    tilecombiner
@@ -0,0 +1,199 @@
+#include "tilecombiner.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+using namespace Gmx;
+
+Q_DECLARE_METATYPE(Gmx::TileCombiner::Mode)
+
+static const int TileSize = 8;
+static const int TilesetColumns = 16;
+
+class test_TileCombiner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void combineTilesetRegion();
+    void flippedCellsStayApart();
+    void otherSizesStayApart();
+
+    void coversEveryCell_data();
+    void coversEveryCell();
+
+    void benchmark_data();
+    void benchmark();
+
+private:
+    void paintRegion(TileLayer *layer, int x, int y, int width, int height,
+                     int tileX, int tileY);
+    TileLayer *createRandomLayer(int size);
+
+    SharedTileset mTileset;
+};
+
+void test_TileCombiner::initTestCase()
+{
+    QImage image(TileSize * TilesetColumns, TileSize * TilesetColumns, QImage::Format_ARGB32);
+    image.fill(Qt::white);
+
+    mTileset = Tileset::create(QLatin1String("tiles"), TileSize, TileSize);
+    QVERIFY(mTileset->loadFromImage(image, QLatin1String("tiles.png")));
+    QCOMPARE(mTileset->columnCount(), TilesetColumns);
+}
+
+void test_TileCombiner::cleanupTestCase()
+{
+    mTileset.clear();
+}
+
+/**
+ * Paints the region of the tileset starting at (tileX, tileY) to the layer,
+ * laid out the same as in the tileset.
+ */
+void test_TileCombiner::paintRegion(TileLayer *layer, int x, int y, int width, int height,
+                                    int tileX, int tileY)
+{
+    for (int dy = 0; dy < height; ++dy) {
+        for (int dx = 0; dx < width; ++dx) {
+            const int id = (tileX + dx) + (tileY + dy) * TilesetColumns;
+            layer->setCell(x + dx, y + dy, Cell(mTileset->findTile(id)));
+        }
+    }
+}
+
+TileLayer *test_TileCombiner::createRandomLayer(int size)
+{
+    TileLayer *layer = new TileLayer(QString(), 0, 0, size, size);
+
+    // Fixed seed, so each run measures the same layer
+    quint32 seed = 12345;
+    auto next = [&seed](int bound) {
+        seed = seed * 1103515245u + 12345u;
+        return int((seed >> 16) % quint32(bound));
+    };
+
+    const int patches = size * size / 8;
+    for (int i = 0; i < patches; ++i) {
+        const int width = 1 + next(6);
+        const int height = 1 + next(6);
+        const int x = next(size - width + 1);
+        const int y = next(size - height + 1);
+        paintRegion(layer, x, y, width, height,
+                    next(TilesetColumns - width + 1),
+                    next(TilesetColumns - height + 1));
+    }
+
+    return layer;
+}
+
+void test_TileCombiner::combineTilesetRegion()
+{
+    TileLayer layer(QString(), 0, 0, 20, 20);
+    paintRegion(&layer, 2, 3, 4, 5, 1, 2);
+
+    const QVector<QRect> rects = TileCombiner().combine(layer, QSize(TileSize, TileSize));
+
+    QCOMPARE(rects.size(), 1);
+    QCOMPARE(rects.first(), QRect(2, 3, 4, 5));
+}
+
+void test_TileCombiner::flippedCellsStayApart()
+{
+    TileLayer layer(QString(), 0, 0, 4, 1);
+    paintRegion(&layer, 0, 0, 4, 1, 0, 0);
+
+    Cell cell = layer.cellAt(2, 0);
+    cell.setFlippedHorizontally(true);
+    layer.setCell(2, 0, cell);
+
+    const QVector<QRect> rects = TileCombiner().combine(layer, QSize(TileSize, TileSize));
+
+    QCOMPARE(rects.size(), 3);
+    QCOMPARE(rects.at(0), QRect(0, 0, 2, 1));
+    QCOMPARE(rects.at(1), QRect(2, 0, 1, 1));
+    QCOMPARE(rects.at(2), QRect(3, 0, 1, 1));
+}
+
+void test_TileCombiner::otherSizesStayApart()
+{
+    TileLayer layer(QString(), 0, 0, 2, 2);
+    paintRegion(&layer, 0, 0, 2, 2, 0, 0);
+
+    const QVector<QRect> rects = TileCombiner().combine(layer, QSize(TileSize * 2, TileSize * 2));
+
+    QCOMPARE(rects.size(), 4);
+}
+
+void test_TileCombiner::coversEveryCell_data()
+{
+    QTest::addColumn<TileCombiner::Mode>("mode");
+
+    QTest::newRow("fast") << TileCombiner::Fast;
+    QTest::newRow("optimal") << TileCombiner::Optimal;
+}
+
+void test_TileCombiner::coversEveryCell()
+{
+    QFETCH(TileCombiner::Mode, mode);
+
+    QScopedPointer<TileLayer> layer(createRandomLayer(64));
+    const QVector<QRect> rects = TileCombiner(mode).combine(*layer, QSize(TileSize, TileSize));
+
+    QVector<int> covered(layer->width() * layer->height());
+    for (const QRect &rect : rects) {
+        const Cell &topLeft = layer->cellAt(rect.topLeft());
+        QVERIFY(!topLeft.isEmpty());
+
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                ++covered[x + y * layer->width()];
+
+                // Merged cells continue the tileset region of the top-left cell
+                const int expected = topLeft.tileId()
+                        + (x - rect.x()) + (y - rect.y()) * TilesetColumns;
+                QCOMPARE(layer->cellAt(x, y).tileId(), expected);
+            }
+        }
+    }
+
+    for (int y = 0; y < layer->height(); ++y)
+        for (int x = 0; x < layer->width(); ++x)
+            QCOMPARE(covered.at(x + y * layer->width()), layer->cellAt(x, y).isEmpty() ? 0 : 1);
+}
+
+void test_TileCombiner::benchmark_data()
+{
+    coversEveryCell_data();
+}
+
+void test_TileCombiner::benchmark()
+{
+    QFETCH(TileCombiner::Mode, mode);
+
+    QScopedPointer<TileLayer> layer(createRandomLayer(512));
+    const TileCombiner combiner(mode);
+
+    QVector<QRect> rects;
+    QBENCHMARK {
+        rects = combiner.combine(*layer, QSize(TileSize, TileSize));
+    }
+
+    int cells = 0;
+    for (int y = 0; y < layer->height(); ++y)
+        for (int x = 0; x < layer->width(); ++x)
+            if (!layer->cellAt(x, y).isEmpty())
+                ++cells;
+
+    qDebug().nospace() << cells << " cells combined into " << rects.size() << " tiles ("
+                       << qRound(100.0 - 100.0 * rects.size() / qMax(cells, 1)) << "% fewer)";
+}
+
+QTEST_MAIN(test_TileCombiner)
+#include "test_tilecombiner.moc"